@@ -0,0 +1,103 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*  Minimal set of portable atomic operations used by the threading
+    code.  All of them are full barriers except the plain loads and
+    stores, which have acquire and release semantics respectively.
+    BLOSC_CPU_RELAX() is a hint for the processor in spin-wait loops. */
+
+#ifndef BLOSC_ATOMIC_H
+#define BLOSC_ATOMIC_H
+
+#if defined(_MSC_VER)
+  #include <intrin.h>
+
+  /* Return the value previous to the addition */
+  #define BLOSC_ATOMIC_ADD32(ptr, val) \
+    _InterlockedExchangeAdd((volatile long*)(ptr), (long)(val))
+  #define BLOSC_ATOMIC_ADD64(ptr, val) \
+    _InterlockedExchangeAdd64((volatile __int64*)(ptr), (__int64)(val))
+  #define BLOSC_ATOMIC_LOAD32(ptr) \
+    _InterlockedOr((volatile long*)(ptr), 0)
+  #define BLOSC_ATOMIC_STORE32(ptr, val) \
+    _InterlockedExchange((volatile long*)(ptr), (long)(val))
+  #define BLOSC_ATOMIC_LOAD64(ptr) \
+    _InterlockedOr64((volatile __int64*)(ptr), 0)
+  #define BLOSC_ATOMIC_STORE64(ptr, val) \
+    _InterlockedExchange64((volatile __int64*)(ptr), (__int64)(val))
+  #define BLOSC_ATOMIC_LOADPTR(ptr) \
+    _InterlockedCompareExchangePointer((void* volatile*)(ptr), NULL, NULL)
+  #define BLOSC_ATOMIC_STOREPTR(ptr, val) \
+    _InterlockedExchangePointer((void* volatile*)(ptr), (void*)(val))
+  /* Return the value previous to the exchange */
+  #define BLOSC_ATOMIC_XCHGPTR(ptr, val) \
+    _InterlockedExchangePointer((void* volatile*)(ptr), (void*)(val))
+  #if defined(_M_IX86) || defined(_M_X64)
+    #define BLOSC_CPU_RELAX() _mm_pause()
+  #else
+    #define BLOSC_CPU_RELAX() _ReadWriteBarrier()
+  #endif
+
+#elif defined(__clang__) || \
+      (defined(__GNUC__) && ((__GNUC__ > 4) || (__GNUC__ == 4 && __GNUC_MINOR__ >= 7)))
+
+  #define BLOSC_ATOMIC_ADD32(ptr, val) \
+    __atomic_fetch_add((ptr), (val), __ATOMIC_SEQ_CST)
+  #define BLOSC_ATOMIC_ADD64(ptr, val) \
+    __atomic_fetch_add((ptr), (int64_t)(val), __ATOMIC_SEQ_CST)
+  #define BLOSC_ATOMIC_LOAD32(ptr) \
+    __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+  #define BLOSC_ATOMIC_STORE32(ptr, val) \
+    __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+  #define BLOSC_ATOMIC_LOAD64(ptr) \
+    __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+  #define BLOSC_ATOMIC_STORE64(ptr, val) \
+    __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+  #define BLOSC_ATOMIC_LOADPTR(ptr) \
+    __atomic_load_n((ptr), __ATOMIC_ACQUIRE)
+  #define BLOSC_ATOMIC_STOREPTR(ptr, val) \
+    __atomic_store_n((ptr), (val), __ATOMIC_RELEASE)
+  #define BLOSC_ATOMIC_XCHGPTR(ptr, val) \
+    __atomic_exchange_n((ptr), (val), __ATOMIC_ACQ_REL)
+
+#elif defined(__GNUC__)
+  /* Older GCC (and compatibles like ICC) only have the __sync builtins */
+
+  #define BLOSC_ATOMIC_ADD32(ptr, val) \
+    __sync_fetch_and_add((ptr), (val))
+  #define BLOSC_ATOMIC_ADD64(ptr, val) \
+    __sync_fetch_and_add((ptr), (int64_t)(val))
+  #define BLOSC_ATOMIC_LOAD32(ptr) \
+    __sync_fetch_and_add((ptr), 0)
+  #define BLOSC_ATOMIC_STORE32(ptr, val) \
+    do { __sync_synchronize(); *(ptr) = (val); __sync_synchronize(); } while (0)
+  #define BLOSC_ATOMIC_LOAD64(ptr) \
+    __sync_fetch_and_add((ptr), 0)
+  #define BLOSC_ATOMIC_STORE64(ptr, val) \
+    do { __sync_synchronize(); *(ptr) = (val); __sync_synchronize(); } while (0)
+  #define BLOSC_ATOMIC_LOADPTR(ptr) \
+    __sync_fetch_and_add((ptr), 0)
+  #define BLOSC_ATOMIC_STOREPTR(ptr, val) \
+    do { __sync_synchronize(); *(ptr) = (val); __sync_synchronize(); } while (0)
+  /* This is an acquire barrier only, hence the explicit full one */
+  #define BLOSC_ATOMIC_XCHGPTR(ptr, val) \
+    (__sync_synchronize(), __sync_lock_test_and_set((ptr), (val)))
+
+#else
+  #error Cannot determine how to do atomic operations for this compiler.
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+  #if defined(__i386__) || defined(__x86_64__)
+    #define BLOSC_CPU_RELAX() __builtin_ia32_pause()
+  #else
+    #define BLOSC_CPU_RELAX() __asm__ __volatile__("" ::: "memory")
+  #endif
+#endif
+
+#endif  /* BLOSC_ATOMIC_H */
@@ -0,0 +1,52 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+/*  Internal functions that are not part of the public API. */
+
+#ifndef BLOSC_PRIVATE_H
+#define BLOSC_PRIVATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "blosc.h"
+
+/* A copy of the global allocator (see blosc2_set_allocator()) */
+BLOSC_NO_EXPORT void blosc_get_allocator(blosc2_allocator* allocator);
+
+/* Memory management for super-chunks, going through `allocator` (the
+   global one if NULL) */
+BLOSC_NO_EXPORT void* blosc_malloc(const blosc2_allocator* allocator,
+                                   size_t size);
+BLOSC_NO_EXPORT void* blosc_realloc(const blosc2_allocator* allocator,
+                                    void* ptr, size_t size);
+BLOSC_NO_EXPORT void blosc_free(const blosc2_allocator* allocator, void* ptr);
+
+/* Take a reference to the pool of `nthreads` threads shared by the
+   super-chunks, starting it if nobody has it.  NULL is returned if
+   `nthreads` is not between 2 and 255, or if the pool cannot be started. */
+BLOSC_NO_EXPORT blosc2_threadpool* blosc_acquire_shared_pool(int nthreads);
+
+/* Drop a reference taken with blosc_acquire_shared_pool().  The threads
+   are stopped when the last one is dropped. */
+BLOSC_NO_EXPORT void blosc_release_shared_pool(blosc2_threadpool* pool);
+
+#if defined(BLOSC_TESTING)
+/* Number of memory blocks allocated internally so far.  Only available in
+   testing builds, where it is used for checking that the (de-)compression
+   hot path does not allocate. */
+BLOSC_NO_EXPORT int32_t blosc_get_nallocs(void);
+
+/* Use extended (64-bit) headers for buffers of any size (when `force` is
+   not 0), so that they can be tested without huge buffers. */
+BLOSC_NO_EXPORT void blosc_set_force_extended(int force);
+
+/* Number of pools of threads shared by super-chunks that are running */
+BLOSC_NO_EXPORT int32_t blosc_get_nshared_pools(void);
+#endif  /* defined(BLOSC_TESTING) */
+
+#endif  /* BLOSC_PRIVATE_H */
@@ -7,6 +7,9 @@
   See LICENSES/BLOSC.txt for details about copyright and rights to use.
 **********************************************************************/
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+  #define _GNU_SOURCE       /* for the CPU affinity API */
+#endif
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -23,6 +26,8 @@
 #include "schunk.h"
 #include "delta.h"
 #include "blosclz.h"
+#include "blosc-atomic.h"
+#include "blosc-private.h"
 #if defined(HAVE_LZ4)
   #include "lz4.h"
   #include "lz4hc.h"
@@ -52,6 +57,7 @@
   #endif
 
   #include <process.h>
+  #include <io.h>
   #define getpid _getpid
 #else
   #include <stdint.h>
@@ -66,6 +72,14 @@
   #include <pthread.h>
 #endif
 
+#if defined(__linux__)
+  #include <sched.h>
+#endif
+
+#if !defined(_WIN32)
+  #include <time.h>
+#endif
+
 /* Some useful units */
 #define KB 1024
 #define MB (1024*KB)
@@ -76,16 +90,152 @@
 /* The maximum number of splits in a block for compression */
 #define MAX_SPLITS 16            /* Cannot be larger than 128 */
 
-/* The size of L1 cache.  32 KB is quite common nowadays. */
+/* The size of L1 cache when it cannot be detected.  32 KB is quite
+   common nowadays. */
 #define L1 (32*KB)
 
-/* Have problems using posix barriers when symbol value is 200112L */
-/* This requires more investigation, but will work for the moment */
-#if defined(_POSIX_BARRIERS) && ((_POSIX_BARRIERS - 20012L) >= 0 && _POSIX_BARRIERS != 200112L)
-#define _POSIX_BARRIERS_MINE
-#endif
-/* Synchronization variables */
+/* Number of iterations that threads spin waiting for new jobs, or for a
+   job to be finished, before parking on a condition variable */
+#define SPIN_COUNT 4096
+
+/* The autotuner trial-compresses a sample made of TUNE_NSLICES slices of
+   the buffer, each of TUNE_SLICESIZE bytes at most */
+#define TUNE_NSLICES 4
+#define TUNE_SLICESIZE (128*KB)
+
+/* Relative change in the compression ratio that makes the autotuner
+   discard its params */
+#define TUNE_DRIFT 1.25
+
+/* State of the autotuner of a compression context (see BLOSC_AUTO) */
+struct blosc_tune {
+  double ratio_weight;
+  /* weight of the compression ratio vs the speed in the score */
+  int valid;
+  /* whether the params below can be used */
+  uint8_t compcode;
+  uint8_t filtercode;
+  int8_t clevel;
+  int32_t blocksize;
+  /* the tuned params (the blocksize is only tuned if the context does
+     not force one) */
+  int64_t nbytes;
+  /* the size of the buffer used for tuning */
+  double cratio;
+  /* compression ratio of the first buffer compressed with the params */
+  uint8_t* sample;
+  uint8_t* cdest;
+  /* buffers for the sample and its compressed version */
+  blosc_context* trial_ctx;
+  /* serial context for the trial compressions */
+};
+
+
+/* The part of an item range requested to blosc2_getitems_ctx() that lies
+   in a single block */
+struct blosc_gather_piece {
+  int32_t nblock;
+  /* The block holding the piece */
+  int32_t start;
+  int32_t nbytes;
+  /* Position of the piece in the block and its length */
+  int64_t doffset;
+  /* Position of the piece in the destination */
+};
+
+/* A decompressed block kept in the cache of a context */
+struct blosc_cached_block {
+  const uint8_t* chunk;
+  uint64_t tag;
+  int32_t nblock;
+  /* The key: the compressed buffer (its address and a hash of its
+     contents, see block_cache_key()) and the block */
+  uint8_t* data;
+  int32_t size;
+  int32_t capacity;
+  /* The decompressed block and the room allocated for it */
+  int32_t hnext;
+  /* Next entry in the same hash bucket (-1 for none) */
+  int32_t prev;
+  int32_t next;
+  /* Neighbours in the LRU list (-1 for none) */
+};
+
+/* A bounded LRU cache of decompressed blocks (see block_cache_nblocks in
+   blosc2_context_dparams) */
+struct blosc_block_cache {
+  struct blosc_cached_block* entries;
+  int32_t nentries;
+  int32_t maxentries;
+  /* entries in use and allocated */
+  int32_t* buckets;
+  int32_t nbuckets;
+  /* the hash table (nbuckets is a power of 2) */
+  int32_t head;
+  int32_t tail;
+  /* the most and the least recently used entries (-1 for none) */
+  int64_t hits;
+  int64_t misses;
+  pthread_mutex_t mutex;
+  /* protects everything above, as blocks are looked up from threads */
+  blosc2_allocator allocator;
+};
+
+/* A block in a chunk being decompressed from a stream */
+struct blosc_dstream_block {
+  int64_t start;
+  int64_t stop;
+  /* the compressed bytes of the block in the chunk */
+  int32_t nblock;
+};
+
+/* The state of a streaming decompression (see blosc2_decompress_stream()) */
+struct blosc_dstream {
+  blosc_context* context;
+  blosc2_dstream_read read;
+  void* read_data;
+  blosc2_dstream_output output;
+  void* output_data;
+  uint8_t* buf;
+  int64_t capacity;
+  /* the window of compressed input and the room allocated for it */
+  int64_t start;
+  int64_t len;
+  /* the position of the window in the input and the bytes in it */
+  struct blosc_dstream_block* blocks;
+  int32_t maxblocks;
+  /* the blocks of the current chunk, sorted by their position */
+  int64_t* minstarts;
+  /* the first compressed byte of the blocks from every block on */
+  uint8_t* filters_chunk;
+  /* the delta reference of a packed super-chunk (NULL if none) */
+  int64_t ntbytes;
+  /* the bytes passed to the output so far */
+};
 
+/* A stream compressing its input block by block into chunks (see
+   blosc2_create_cstream()) */
+struct blosc2_cstream_s {
+  blosc_context* context;
+  /* the compression context; its header fields describe a full chunk */
+  int32_t chunksize;
+  int32_t maxblocks;
+  /* the size of a full chunk and its number of blocks */
+  blosc2_cstream_output output;
+  void* user_data;
+  /* where the finished chunks go (the super-chunk of the context if
+     output is NULL) */
+  uint8_t* block;
+  int32_t block_nbytes;
+  /* the block being filled and the bytes of input in it */
+  uint8_t* chunk;
+  int64_t chunk_capacity;
+  /* the chunk being built and the room allocated for it */
+  int32_t nbytes;
+  int32_t nblocks;
+  int64_t cbytes;
+  /* the bytes of input, the blocks and the bytes of output in the chunk */
+};
 
 struct blosc_context_s {
   const uint8_t* src;
@@ -94,7 +244,11 @@ struct blosc_context_s {
   /* The destination buffer */
   uint8_t* header_flags;
   /* Flags for header */
-  int32_t sourcesize;
+  int32_t header_len;
+  /* Length of the header (before the starts of the blocks) */
+  uint8_t extended;
+  /* 1 if the buffer has an extended (64-bit) header */
+  int64_t sourcesize;
   /* Number of bytes in source buffer */
   int32_t nblocks;
   /* Number of total blocks in buffer */
@@ -102,9 +256,18 @@ struct blosc_context_s {
   /* Extra bytes at end of buffer */
   int32_t blocksize;
   /* Length of the block in bytes */
-  int32_t num_output_bytes;
+  int32_t forced_blocksize;
+  /* The blocksize requested by the user (0 for automatic) */
+  int64_t range_start;
+  int64_t range_stop;
+  /* Byte range of the buffer to be decompressed (all of it except for
+     getitem) */
+  int32_t block_start;
+  int32_t block_stop;
+  /* The blocks overlapping that range */
+  int64_t num_output_bytes;
   /* Counter for the number of output bytes */
-  int32_t destsize;
+  int64_t destsize;
   /* Maximum size for destination buffer */
   uint8_t* bstarts;
   /* Start of the buffer past header info */
@@ -126,23 +289,47 @@ struct blosc_context_s {
   /* Threading */
   int32_t nthreads;
   int32_t threads_started;
-  int32_t end_threads;
-  pthread_t *threads;
-  pthread_mutex_t count_mutex;
-#ifdef _POSIX_BARRIERS_MINE
-  pthread_barrier_t barr_init;
-  pthread_barrier_t barr_finish;
-#else
-  int32_t count_threads;
-  pthread_mutex_t count_threads_mutex;
-  pthread_cond_t count_threads_cv;
-#endif
-#if !defined(_WIN32)
-  pthread_attr_t ct_attr;            /* creation time attrs for threads */
-#endif
+  blosc2_threadpool* private_threadpool;
+  /* pool with the threads owned by this context */
   int32_t thread_giveup_code;
   /* error code when give up */
-  int32_t thread_nblock;                    /* block counter */
+  int32_t thread_nblock;
+  /* next block to be handed out to a thread (atomic) */
+  blosc2_threadpool* threadpool;
+  /* shared pool of threads to be used instead of private ones (if any) */
+  blosc2_allocator allocator;
+  /* the allocator for the memory of this context */
+
+  /* Batches */
+  blosc_context** batch_contexts;
+  /* contexts for the buffers in batch calls */
+  blosc_context** batch_job;
+  /* contexts of the buffers that have blocks to be processed */
+  int32_t batch_ncontexts;
+  /* number of contexts allocated in batch_contexts */
+
+  struct blosc_tune* tune;
+  /* the autotuner (only when compcode is BLOSC_AUTO) */
+
+  /* Gathers (see blosc2_getitems_ctx()) */
+  struct blosc_gather_piece* gather_pieces;
+  /* the pieces of the ranges being gathered, sorted by block */
+  int32_t* gather_groups;
+  /* the first piece of every block to be decompressed, plus a sentinel.
+     The threads hand out these groups instead of blocks when gathering. */
+  int32_t gather_npieces;
+  /* number of pieces being gathered (0 when not gathering) */
+  int32_t gather_maxpieces;
+  /* number of pieces allocated in gather_pieces and gather_groups */
+
+  struct blosc_block_cache* block_cache;
+  /* the cache of decompressed blocks (NULL if disabled) */
+  int block_cache_borrowed;
+  /* whether block_cache belongs to another context */
+  uint64_t block_cache_tag;
+  int64_t block_cache_cbytes;
+  /* a hash of the header and the block starts of src, and the compressed
+     size of src (set only when there is a cache) */
 };
 
 struct thread_context {
@@ -152,6 +339,10 @@ struct thread_context {
   uint8_t* tmp2;
   uint8_t* tmp3;
   int32_t tmpblocksize; /* keep track of how big the temporary buffers are */
+  int32_t tmpebsize;
+  blosc2_threadpool* threadpool;  /* the pool owning this thread (if any) */
+  blosc_context* delta_dctx;  /* for fetching delta references (lazily created) */
+  blosc2_allocator allocator;  /* the allocator for the temporaries */
 #if defined(HAVE_ZSTD)
   /* The contexts for ZSTD */
   ZSTD_CCtx* zstd_cctx;
@@ -159,6 +350,70 @@ struct thread_context {
 #endif /* HAVE_ZSTD */
 };
 
+/* A job queued in a shared pool of threads */
+struct blosc_job {
+  blosc_context* context;
+  /* The context running the job */
+  blosc_context** contexts;
+  int32_t ncontexts;
+  /* The contexts holding the blocks to be processed (one per buffer) */
+  int32_t ncontext;
+  /* First context that may have blocks to be handed out still (atomic) */
+  blosc2_async* async;
+  /* The whole call to be run asynchronously (NULL for jobs of blocks) */
+  int32_t nworkers;
+  /* Number of pool workers attached to the job */
+  int32_t maxworkers;
+  /* Maximum number of pool workers that can be attached to the job */
+  struct blosc_job* next;
+  /* Next job in queue */
+};
+
+struct blosc2_threadpool_s {
+  int32_t nthreads;
+  pthread_t* threads;
+  blosc2_allocator allocator;
+  /* the allocator for the pool and its threads */
+  int* cpus;
+  int32_t ncpus;
+  /* the CPUs where the threads are pinned (NULL and 0 if not pinned) */
+  pthread_mutex_t mutex;
+  pthread_cond_t work_cv;
+  /* signaled when new jobs are queued */
+  pthread_cond_t done_cv;
+  /* signaled when the last worker detaches from a job */
+  struct blosc_job* first_job;
+  struct blosc_job* last_job;
+  /* the queue of pending jobs */
+  int32_t generation;
+  /* bumped every time a job is queued (read while spinning) */
+  int32_t nsleeping;
+  /* number of workers parked on work_cv */
+  int32_t end_threads;
+};
+
+struct blosc2_async_s {
+  struct blosc_job job;
+  /* The job running the call in a pool */
+  blosc_context* context;
+  int compress;
+  size_t nbytes;
+  const void* src;
+  void* dest;
+  size_t destsize;
+  /* The parameters of the call */
+  int result;
+  /* The return value of the call */
+  blosc2_async_cb callback;
+  void* callback_data;
+  /* Function to be called when finished, and its user data */
+  int32_t done;
+  /* Whether the call has finished (atomic) */
+  pthread_mutex_t mutex;
+  pthread_cond_t done_cv;
+  /* signaled when the call finishes */
+};
+
 /* Global context for non-contextual API */
 static blosc_context* g_global_context;
 static pthread_mutex_t global_comp_mutex;
@@ -176,66 +431,72 @@ int blosc_set_nthreads_(blosc_context*);
 /* Releases the global threadpool */
 int blosc_release_threadpool(blosc_context* context);
 
-/* Macros for synchronization */
+/* Run the job in context using a pool of threads */
+static int64_t pool_blosc(blosc_context* context);
+static void run_job(blosc_context* context, blosc_context** contexts,
+                    int32_t ncontexts);
 
-/* Wait until all threads are initialized */
-#ifdef _POSIX_BARRIERS_MINE
-#define WAIT_INIT(RET_VAL, CONTEXT_PTR)  \
-  rc = pthread_barrier_wait(&CONTEXT_PTR->barr_init); \
-  if (rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD) { \
-    printf("Could not wait on barrier (init): %d\n", rc); \
-    return((RET_VAL));                            \
-  }
-#else
-#define WAIT_INIT(RET_VAL, CONTEXT_PTR)   \
-  pthread_mutex_lock(&CONTEXT_PTR->count_threads_mutex); \
-  if (CONTEXT_PTR->count_threads < CONTEXT_PTR->nthreads) { \
-    CONTEXT_PTR->count_threads++;  \
-    pthread_cond_wait(&CONTEXT_PTR->count_threads_cv, &CONTEXT_PTR->count_threads_mutex); \
-  } \
-  else { \
-    pthread_cond_broadcast(&CONTEXT_PTR->count_threads_cv); \
-  } \
-  pthread_mutex_unlock(&CONTEXT_PTR->count_threads_mutex);
-#endif
+#if defined(BLOSC_TESTING)
+/* Number of blocks allocated by my_malloc() */
+static int32_t g_nallocs = 0;
 
-/* Wait for all threads to finish */
-#ifdef _POSIX_BARRIERS_MINE
-#define WAIT_FINISH(RET_VAL, CONTEXT_PTR)   \
-  rc = pthread_barrier_wait(&CONTEXT_PTR->barr_finish); \
-  if (rc != 0 && rc != PTHREAD_BARRIER_SERIAL_THREAD) { \
-    printf("Could not wait on barrier (finish)\n"); \
-    return((RET_VAL));                              \
-  }
-#else
-#define WAIT_FINISH(RET_VAL, CONTEXT_PTR)                           \
-  pthread_mutex_lock(&CONTEXT_PTR->count_threads_mutex); \
-  if (CONTEXT_PTR->count_threads > 0) { \
-    CONTEXT_PTR->count_threads--; \
-    pthread_cond_wait(&CONTEXT_PTR->count_threads_cv, &CONTEXT_PTR->count_threads_mutex); \
-  } \
-  else { \
-    pthread_cond_broadcast(&CONTEXT_PTR->count_threads_cv); \
-  } \
-  pthread_mutex_unlock(&CONTEXT_PTR->count_threads_mutex);
-#endif
+int32_t blosc_get_nallocs(void) {
+  return BLOSC_ATOMIC_LOAD32(&g_nallocs);
+}
 
+/* Whether extended headers are used for buffers of any size */
+static int g_force_extended = 0;
+
+void blosc_set_force_extended(int force) {
+  g_force_extended = force;
+}
+#endif  /* defined(BLOSC_TESTING) */
+
+/* The allocator set by the user (all NULL means the built-in one) */
+static blosc2_allocator g_allocator = {NULL, NULL, NULL, NULL};
+
+/* The sizes of the L1 (data), L2 and L3 caches, detected at runtime.  0
+   means unknown. */
+static int32_t g_cache_sizes[3] = {0, 0, 0};
+/* Whether a thread has started detecting them, and whether they are
+   set (both accessed atomically) */
+static int32_t g_cache_claimed = 0;
+static int32_t g_cache_detected = 0;
+
+/* The pools of threads shared by super-chunks, indexed by their number of
+   threads, and the number of references to each.  The mutex protecting
+   them is initialized by the first thread that claims it. */
+#define MAX_SHARED_POOLS 256
+static blosc2_threadpool* g_shared_pools[MAX_SHARED_POOLS];
+static int32_t g_shared_pool_refs[MAX_SHARED_POOLS];
+static pthread_mutex_t g_shared_pools_mutex;
+static int32_t g_shared_pools_claimed = 0;
+static int32_t g_shared_pools_ready = 0;
 
 /* A function for aligned malloc that is portable */
-static uint8_t* my_malloc(size_t size) {
+static uint8_t* my_malloc(const blosc2_allocator* allocator, size_t size) {
   void* block = NULL;
   int res = 0;
 
+#if defined(BLOSC_TESTING)
+  BLOSC_ATOMIC_ADD32(&g_nallocs, 1);
+#endif  /* defined(BLOSC_TESTING) */
+
 /* Do an alignment to 32 bytes because AVX2 is supported */
+  if (allocator->malloc_fn != NULL) {
+    block = allocator->malloc_fn(size, 32, allocator->user_data);
+  }
+  else {
 #if defined(_WIN32)
-  /* A (void *) cast needed for avoiding a warning with MINGW :-/ */
-  block = (void *)_aligned_malloc(size, 32);
+    /* A (void *) cast needed for avoiding a warning with MINGW :-/ */
+    block = (void *)_aligned_malloc(size, 32);
 #elif _POSIX_C_SOURCE >= 200112L || _XOPEN_SOURCE >= 600
-  /* Platform does have an implementation of posix_memalign */
-  res = posix_memalign(&block, 32, size);
+    /* Platform does have an implementation of posix_memalign */
+    res = posix_memalign(&block, 32, size);
 #else
-  block = malloc(size);
+    block = malloc(size);
 #endif  /* _WIN32 */
+  }
 
   if (block == NULL || res != 0) {
     printf("Error allocating memory!");
@@ -247,7 +508,13 @@ static uint8_t* my_malloc(size_t size) {
 
 
 /* Release memory booked by my_malloc */
-static void my_free(void* block) {
+static void my_free(const blosc2_allocator* allocator, void* block) {
+  if (allocator->free_fn != NULL) {
+    if (block != NULL) {
+      allocator->free_fn(block, allocator->user_data);
+    }
+    return;
+  }
 #if defined(_WIN32)
   _aligned_free(block);
 #else
@@ -256,6 +523,60 @@ static void my_free(void* block) {
 }
 
 
+/* Allocators for the storage of super-chunks (no special alignment).  A
+   NULL `allocator` means the global one. */
+void blosc_get_allocator(blosc2_allocator* allocator) {
+  *allocator = g_allocator;
+}
+
+void* blosc_malloc(const blosc2_allocator* allocator, size_t size) {
+  if (allocator == NULL) {
+    allocator = &g_allocator;
+  }
+  if (allocator->malloc_fn != NULL) {
+    return allocator->malloc_fn(size, 0, allocator->user_data);
+  }
+  return malloc(size);
+}
+
+void* blosc_realloc(const blosc2_allocator* allocator, void* ptr, size_t size) {
+  if (allocator == NULL) {
+    allocator = &g_allocator;
+  }
+  if (allocator->realloc_fn != NULL) {
+    return allocator->realloc_fn(ptr, size, 0, allocator->user_data);
+  }
+  return realloc(ptr, size);
+}
+
+void blosc_free(const blosc2_allocator* allocator, void* ptr) {
+  if (allocator == NULL) {
+    allocator = &g_allocator;
+  }
+  if (allocator->free_fn != NULL) {
+    if (ptr != NULL) {
+      allocator->free_fn(ptr, allocator->user_data);
+    }
+    return;
+  }
+  free(ptr);
+}
+
+int blosc2_set_allocator(const blosc2_allocator* allocator) {
+  if (allocator == NULL) {
+    memset(&g_allocator, 0, sizeof(g_allocator));
+    return 0;
+  }
+  if (allocator->malloc_fn == NULL || allocator->realloc_fn == NULL ||
+      allocator->free_fn == NULL) {
+    fprintf(stderr, "All the functions of an allocator must be set\n");
+    return -1;
+  }
+  g_allocator = *allocator;
+  return 0;
+}
+
+
 /* Copy 4 bytes from `*pa` to int32_t, changing endianness if necessary. */
 static int32_t sw32_(const uint8_t* pa) {
   int32_t idest;
@@ -304,6 +625,305 @@ static void _sw32(uint8_t* dest, int32_t a) {
 }
 
 
+/* Copy 8 bytes from `*pa` to int64_t, changing endianness if necessary. */
+static int64_t sw64_(const uint8_t* pa) {
+  int64_t idest;
+  uint8_t* dest = (uint8_t*)&idest;
+  int i = 1;                    /* for big/little endian detection */
+  char* p = (char*)&i;
+  int j;
+
+  for (j = 0; j < 8; j++) {
+    /* big endian reverses the bytes */
+    dest[j] = (p[0] != 1) ? pa[7 - j] : pa[j];
+  }
+  return idest;
+}
+
+
+/* Copy 8 bytes from `*pa` to `*dest`, changing endianness if necessary. */
+static void _sw64(uint8_t* dest, int64_t a) {
+  uint8_t* pa = (uint8_t*)&a;
+  int i = 1;                    /* for big/little endian detection */
+  char* p = (char*)&i;
+  int j;
+
+  for (j = 0; j < 8; j++) {
+    /* big endian reverses the bytes */
+    dest[j] = (p[0] != 1) ? pa[7 - j] : pa[j];
+  }
+}
+
+
+/* Read the sizes in the header of a compressed buffer (either regular or
+   extended) and return the length of the header. */
+static int32_t read_header_sizes(const uint8_t* src, int64_t* nbytes,
+                                 int32_t* blocksize, int64_t* cbytes) {
+  if (src[0] == BLOSC_VERSION_FORMAT_64) {
+    *nbytes = sw64_(src + 8);
+    *blocksize = (int32_t)sw64_(src + 16);
+    *cbytes = sw64_(src + 24);
+    return BLOSC_EXTENDED_HEADER_LENGTH;
+  }
+  *nbytes = sw32_(src + 4);
+  *blocksize = sw32_(src + 8);
+  *cbytes = sw32_(src + 12);
+  return BLOSC_MIN_HEADER_LENGTH;
+}
+
+
+/* Get the start of block `j` (bstarts are 64-bit in extended headers) */
+static int64_t get_bstart(const uint8_t* bstarts, int extended, int32_t j) {
+  return extended ? sw64_(bstarts + (int64_t)j * 8) : sw32_(bstarts + j * 4);
+}
+
+/* Set the start of block `j` */
+static void set_bstart(uint8_t* bstarts, int extended, int32_t j,
+                       int64_t value) {
+  if (extended) {
+    _sw64(bstarts + (int64_t)j * 8, value);
+  }
+  else {
+    _sw32(bstarts + j * 4, (int32_t)value);
+  }
+}
+
+
+/*
+ * The cache of decompressed blocks
+ */
+
+static struct blosc_block_cache* create_block_cache(
+    const blosc2_allocator* allocator, int32_t nblocks) {
+  struct blosc_block_cache* cache;
+  int32_t i;
+
+  cache = (struct blosc_block_cache*)my_malloc(allocator,
+                                               sizeof(struct blosc_block_cache));
+  if (cache == NULL) {
+    return NULL;
+  }
+  memset(cache, 0, sizeof(struct blosc_block_cache));
+  cache->allocator = *allocator;
+  cache->maxentries = nblocks;
+  for (cache->nbuckets = 1; cache->nbuckets < 2 * nblocks; cache->nbuckets *= 2);
+  cache->entries = (struct blosc_cached_block*)my_malloc(
+      allocator, nblocks * sizeof(struct blosc_cached_block));
+  cache->buckets = (int32_t*)my_malloc(allocator,
+                                       cache->nbuckets * sizeof(int32_t));
+  if (cache->entries == NULL || cache->buckets == NULL) {
+    my_free(allocator, cache->entries);
+    my_free(allocator, cache->buckets);
+    my_free(allocator, cache);
+    return NULL;
+  }
+  memset(cache->entries, 0, nblocks * sizeof(struct blosc_cached_block));
+  for (i = 0; i < cache->nbuckets; i++) {
+    cache->buckets[i] = -1;
+  }
+  cache->head = -1;
+  cache->tail = -1;
+  pthread_mutex_init(&cache->mutex, NULL);
+
+  return cache;
+}
+
+static void free_block_cache(struct blosc_block_cache* cache) {
+  blosc2_allocator allocator = cache->allocator;
+  int32_t i;
+
+  for (i = 0; i < cache->maxentries; i++) {
+    my_free(&allocator, cache->entries[i].data);
+  }
+  pthread_mutex_destroy(&cache->mutex);
+  my_free(&allocator, cache->entries);
+  my_free(&allocator, cache->buckets);
+  my_free(&allocator, cache);
+}
+
+/* Drop all the blocks in the cache (their memory is kept for reuse) */
+static void clear_block_cache(struct blosc_block_cache* cache) {
+  int32_t i;
+
+  pthread_mutex_lock(&cache->mutex);
+  for (i = 0; i < cache->nbuckets; i++) {
+    cache->buckets[i] = -1;
+  }
+  cache->nentries = 0;
+  cache->head = -1;
+  cache->tail = -1;
+  pthread_mutex_unlock(&cache->mutex);
+}
+
+/* FNV-1a hash of `nbytes` bytes, starting from the hash `h` */
+static uint64_t hash_bytes(uint64_t h, const uint8_t* bytes, int64_t nbytes) {
+  int64_t i;
+
+  for (i = 0; i < nbytes; i++) {
+    h = (h ^ bytes[i]) * 0x100000001B3ULL;
+  }
+  return h;
+}
+
+/* Hash the header and the block starts of the compressed buffer in
+   `context`, so that a buffer reused for another chunk does not hit the
+   blocks of the previous one */
+static void set_block_cache_tag(blosc_context* context, int64_t cbytes) {
+  int64_t nbytes = context->header_len;
+
+  if (!(*(context->header_flags) & BLOSC_MEMCPYED)) {
+    nbytes += (int64_t)context->nblocks * (context->extended ? 8 : 4);
+  }
+  if (nbytes > cbytes) {
+    nbytes = cbytes;
+  }
+  context->block_cache_tag = hash_bytes(0xCBF29CE484222325ULL, context->src,
+                                        nbytes);
+  context->block_cache_cbytes = cbytes;
+}
+
+/* The hash identifying the block `nblock` of the buffer in `context` in
+   the cache: the one of the buffer mixed with the first compressed bytes
+   of the block */
+static uint64_t block_cache_key(const blosc_context* context, int32_t nblock) {
+  int64_t bstart = get_bstart(context->bstarts, context->extended, nblock);
+  int64_t nbytes = context->block_cache_cbytes - bstart;
+
+  if (bstart < 0 || nbytes < 0) {
+    return context->block_cache_tag;
+  }
+  return hash_bytes(context->block_cache_tag, context->src + bstart,
+                    (nbytes < 32) ? nbytes : 32);
+}
+
+static int32_t block_cache_bucket(const struct blosc_block_cache* cache,
+                                  const uint8_t* chunk, int32_t nblock) {
+  uint64_t h = ((uint64_t)(uintptr_t)chunk >> 4) ^
+               ((uint64_t)nblock * 0x9E3779B97F4A7C15ULL);
+
+  h ^= h >> 29;
+  return (int32_t)(h & (uint64_t)(cache->nbuckets - 1));
+}
+
+/* Find the entry of a block.  Must be called with the mutex held. */
+static int32_t block_cache_find(const struct blosc_block_cache* cache,
+                                const uint8_t* chunk, uint64_t tag,
+                                int32_t nblock) {
+  int32_t i = cache->buckets[block_cache_bucket(cache, chunk, nblock)];
+
+  while (i >= 0 && (cache->entries[i].chunk != chunk ||
+                    cache->entries[i].tag != tag ||
+                    cache->entries[i].nblock != nblock)) {
+    i = cache->entries[i].hnext;
+  }
+  return i;
+}
+
+static void lru_unlink(struct blosc_block_cache* cache, int32_t i) {
+  struct blosc_cached_block* entry = &cache->entries[i];
+
+  if (entry->prev >= 0) {
+    cache->entries[entry->prev].next = entry->next;
+  }
+  else {
+    cache->head = entry->next;
+  }
+  if (entry->next >= 0) {
+    cache->entries[entry->next].prev = entry->prev;
+  }
+  else {
+    cache->tail = entry->prev;
+  }
+}
+
+static void lru_push_front(struct blosc_block_cache* cache, int32_t i) {
+  cache->entries[i].prev = -1;
+  cache->entries[i].next = cache->head;
+  if (cache->head >= 0) {
+    cache->entries[cache->head].prev = i;
+  }
+  cache->head = i;
+  if (cache->tail < 0) {
+    cache->tail = i;
+  }
+}
+
+/* Copy `nbytes` bytes, starting at `start`, of the block `nblock` of
+   `chunk` (with the key `tag`) into `dest` if the block is in the cache.
+   Returns 1 on hits and 0 on misses. */
+static int block_cache_get(struct blosc_block_cache* cache,
+                           const uint8_t* chunk, uint64_t tag, int32_t nblock,
+                           int64_t start, int64_t nbytes, uint8_t* dest) {
+  int32_t i;
+
+  pthread_mutex_lock(&cache->mutex);
+  i = block_cache_find(cache, chunk, tag, nblock);
+  if (i < 0) {
+    cache->misses++;
+    pthread_mutex_unlock(&cache->mutex);
+    return 0;
+  }
+  cache->hits++;
+  lru_unlink(cache, i);
+  lru_push_front(cache, i);
+  memcpy(dest, cache->entries[i].data + start, (size_t)nbytes);
+  pthread_mutex_unlock(&cache->mutex);
+  return 1;
+}
+
+/* Put the decompressed block `nblock` of `chunk` (with the key `tag`) in
+   the cache, evicting the least recently used one if the cache is full */
+static void block_cache_put(struct blosc_block_cache* cache,
+                            const uint8_t* chunk, uint64_t tag, int32_t nblock,
+                            const uint8_t* data, int32_t size) {
+  struct blosc_cached_block* entry;
+  int32_t i, *link;
+  uint8_t* data_;
+
+  pthread_mutex_lock(&cache->mutex);
+  if (block_cache_find(cache, chunk, tag, nblock) >= 0) {
+    /* Another thread got here first */
+    pthread_mutex_unlock(&cache->mutex);
+    return;
+  }
+  /* Take a free entry, or the least recently used one */
+  i = (cache->nentries < cache->maxentries) ? cache->nentries : cache->tail;
+  entry = &cache->entries[i];
+  if (entry->capacity < size) {
+    data_ = my_malloc(&cache->allocator, (size_t)size);
+    if (data_ == NULL) {
+      pthread_mutex_unlock(&cache->mutex);
+      return;
+    }
+    my_free(&cache->allocator, entry->data);
+    entry->data = data_;
+    entry->capacity = size;
+  }
+  if (i == cache->nentries) {
+    cache->nentries++;
+  }
+  else {
+    /* Evict the block */
+    lru_unlink(cache, i);
+    link = &cache->buckets[block_cache_bucket(cache, entry->chunk, entry->nblock)];
+    while (*link != i) {
+      link = &cache->entries[*link].hnext;
+    }
+    *link = entry->hnext;
+  }
+  entry->chunk = chunk;
+  entry->tag = tag;
+  entry->nblock = nblock;
+  entry->size = size;
+  memcpy(entry->data, data, (size_t)size);
+  link = &cache->buckets[block_cache_bucket(cache, chunk, nblock)];
+  entry->hnext = *link;
+  *link = i;
+  lru_push_front(cache, i);
+  pthread_mutex_unlock(&cache->mutex);
+}
+
+
 /*
  * Conversion routines between compressor and compression libraries
  */
@@ -565,10 +1185,30 @@ static int get_accel(const blosc_context* context) {
   return 1;
 }
 
-/* Shuffle & compress a single block */
+/* Get the decompression context of a thread for fetching the delta
+   reference.  It is kept in the thread, so that its temporaries are
+   reused for every block.  The reference goes through the cache of
+   blocks of the context being run (if any). */
+static blosc_context* get_delta_dctx(struct thread_context* thread_context) {
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+
+  if (thread_context->delta_dctx == NULL) {
+    /* We don't want to interfere with existing threads */
+    dparams.nthreads = 1;
+    dparams.allocator = &thread_context->allocator;
+    thread_context->delta_dctx = blosc2_create_dctx(&dparams);
+    thread_context->delta_dctx->block_cache_borrowed = 1;
+  }
+  thread_context->delta_dctx->block_cache =
+      thread_context->parent_context->block_cache;
+  return thread_context->delta_dctx;
+}
+
+/* Shuffle & compress the single block in `src`.  `offset` is the
+   position of the block in the uncompressed buffer. */
 static int blosc_c(struct thread_context* thread_context, int32_t blocksize,
-                   int32_t leftoverblock, int32_t ntbytes, int32_t maxbytes,
-                   const uint8_t* src, int offset, uint8_t* dest,
+                   int32_t leftoverblock, int64_t ntbytes, int64_t maxbytes,
+                   const uint8_t* src, int64_t offset, uint8_t* dest,
                    uint8_t* tmp, uint8_t* tmp2) {
   blosc_context* context = thread_context->parent_context;
   int32_t compformat = (*(context->header_flags) & 0xe0) >> 5;
@@ -579,21 +1219,21 @@ static int blosc_c(struct thread_context* thread_context, int32_t blocksize,
   int32_t ctbytes = 0;              /* number of compressed bytes in block */
   int32_t maxout;
   int32_t typesize = context->typesize;
-  const uint8_t* _src = src + offset;
+  const uint8_t* _src = src;
+  uint8_t filters[BLOSC_MAX_FILTERS];
   char* compname;
   int accel;
   int bscount;
 
   /* Check if we have a delta in a super-chunk context */
   if (context->schunk != NULL) {
-    uint8_t* filters;
-    filters = decode_filters(context->schunk->filters);
+    decode_filters(context->schunk->filters, filters);
     if (filters[0] == BLOSC_DELTA) {
-      delta_encoder8(context->schunk->filters_chunk, offset, blocksize,
+      delta_encoder8(get_delta_dctx(thread_context),
+                     context->schunk->filters_chunk, offset, blocksize,
                      (unsigned char*)_src, tmp2);
       _src = tmp2;
     }
-    free(filters);
   }
 
   /* Shuffle filters */
@@ -631,7 +1271,7 @@ static int blosc_c(struct thread_context* thread_context, int32_t blocksize,
     }
   #endif /*  HAVE_SNAPPY */
     if (ntbytes + maxout > maxbytes) {
-      maxout = maxbytes - ntbytes;   /* avoid buffer overrun */
+      maxout = (int32_t)(maxbytes - ntbytes);   /* avoid buffer overrun */
       if (maxout <= 0) {
         return 0;                  /* non-compressible block */
       }
@@ -704,10 +1344,72 @@ static int blosc_c(struct thread_context* thread_context, int32_t blocksize,
   return ctbytes;
 }
 
-/* Decompress & unshuffle a single block */
+/* Decompress a split of `cbytes` bytes in `src` into the `neblock` bytes
+   of `dest`.  Returns the number of bytes decompressed or a negative
+   value if some error happens. */
+static int32_t decompress_split(struct thread_context* thread_context,
+                                int32_t compformat, const uint8_t* src,
+                                int32_t cbytes, uint8_t* dest, int32_t neblock) {
+  int32_t nbytes;
+  char* compname;
+
+#if !defined(HAVE_ZSTD)
+  (void)thread_context;   /* only the ZSTD contexts are needed */
+#endif
+  if (cbytes == neblock) {
+    memcpy(dest, src, neblock);
+    return neblock;
+  }
+  if (compformat == BLOSC_BLOSCLZ_FORMAT) {
+    nbytes = blosclz_decompress(src, cbytes, dest, neblock);
+  }
+  #if defined(HAVE_LZ4)
+  else if (compformat == BLOSC_LZ4_FORMAT) {
+    nbytes = lz4_wrap_decompress((char*)src, (size_t)cbytes,
+                                 (char*)dest, (size_t)neblock);
+  }
+  #endif /*  HAVE_LZ4 */
+  #if defined(HAVE_SNAPPY)
+  else if (compformat == BLOSC_SNAPPY_FORMAT) {
+    nbytes = snappy_wrap_decompress((char*)src, (size_t)cbytes,
+                                    (char*)dest, (size_t)neblock);
+  }
+  #endif /*  HAVE_SNAPPY */
+  #if defined(HAVE_ZLIB)
+  else if (compformat == BLOSC_ZLIB_FORMAT) {
+    nbytes = zlib_wrap_decompress((char*)src, (size_t)cbytes,
+                                  (char*)dest, (size_t)neblock);
+  }
+  #endif /*  HAVE_ZLIB */
+  #if defined(HAVE_ZSTD)
+  else if (compformat == BLOSC_ZSTD_FORMAT) {
+    nbytes = zstd_wrap_decompress(thread_context,
+                                  (char*)src, (size_t)cbytes,
+                                  (char*)dest, (size_t)neblock);
+  }
+  #endif /*  HAVE_ZSTD */
+  else {
+    compname = clibcode_to_clibname(compformat);
+    fprintf(stderr,
+            "Blosc has not been compiled with decompression "
+                "support for '%s' format. ", compname);
+    fprintf(stderr, "Please recompile for adding this support.\n");
+    return -5;    /* signals no decompression support */
+  }
+
+  /* Check that decompressed bytes number is correct */
+  if (nbytes != neblock) {
+    return -2;
+  }
+  return nbytes;
+}
+
+/* Decompress & unshuffle a single block into `dest`.  `offset` is the
+   position of the block in the uncompressed buffer. */
 static int blosc_d(
     struct thread_context* thread_context, int32_t blocksize, int32_t leftoverblock,
-    const uint8_t* src, uint8_t* dest, int offset, uint8_t* tmp, uint8_t* tmp2) {
+    const uint8_t* src, uint8_t* dest, int64_t offset, uint8_t* tmp,
+    uint8_t* tmp2) {
   blosc_context* context = thread_context->parent_context;
   int32_t compformat = (*(context->header_flags) & 0xe0) >> 5;
   int dont_split = (*(context->header_flags) & 0x10) >> 4;
@@ -717,9 +1419,9 @@ static int blosc_d(
   int32_t cbytes;                /* number of compressed bytes in split */
   int32_t ctbytes = 0;           /* number of compressed bytes in block */
   int32_t ntbytes = 0;           /* number of uncompressed bytes in block */
-  uint8_t* _dest = dest + offset;
+  uint8_t* _dest = dest;
   int32_t typesize = context->typesize;
-  char* compname;
+  uint8_t filters[BLOSC_MAX_FILTERS];
   int bscount;
 
   if ((context->filtercode == BLOSC_SHUFFLE) || \
@@ -740,54 +1442,10 @@ static int blosc_d(
     cbytes = sw32_(src);      /* amount of compressed bytes */
     src += sizeof(int32_t);
     ctbytes += (int32_t)sizeof(int32_t);
-    /* Uncompress */
-    if (cbytes == neblock) {
-      memcpy(_dest, src, neblock);
-      nbytes = neblock;
-    }
-    else {
-      if (compformat == BLOSC_BLOSCLZ_FORMAT) {
-        nbytes = blosclz_decompress(src, cbytes, _dest, neblock);
-      }
-  #if defined(HAVE_LZ4)
-      else if (compformat == BLOSC_LZ4_FORMAT) {
-        nbytes = lz4_wrap_decompress((char*)src, (size_t)cbytes,
-                                     (char*)_dest, (size_t)neblock);
-      }
-  #endif /*  HAVE_LZ4 */
-  #if defined(HAVE_SNAPPY)
-      else if (compformat == BLOSC_SNAPPY_FORMAT) {
-        nbytes = snappy_wrap_decompress((char*)src, (size_t)cbytes,
-                                        (char*)_dest, (size_t)neblock);
-      }
-  #endif /*  HAVE_SNAPPY */
-  #if defined(HAVE_ZLIB)
-      else if (compformat == BLOSC_ZLIB_FORMAT) {
-        nbytes = zlib_wrap_decompress((char*)src, (size_t)cbytes,
-                                      (char*)_dest, (size_t)neblock);
-      }
-  #endif /*  HAVE_ZLIB */
-  #if defined(HAVE_ZSTD)
-      else if (compformat == BLOSC_ZSTD_FORMAT) {
-        nbytes = zstd_wrap_decompress(thread_context,
-                                      (char*)src, (size_t)cbytes,
-                                      (char*)_dest, (size_t)neblock);
-      }
-  #endif /*  HAVE_ZSTD */
-      else {
-        compname = clibcode_to_clibname(compformat);
-        fprintf(stderr,
-                "Blosc has not been compiled with decompression "
-                    "support for '%s' format. ", compname);
-        fprintf(stderr, "Please recompile for adding this support.\n");
-        return -5;    /* signals no decompression support */
-      }
-
-      /* Check that decompressed bytes number is correct */
-      if (nbytes != neblock) {
-        return -2;
-      }
-
+    nbytes = decompress_split(thread_context, compformat, src, cbytes, _dest,
+                              neblock);
+    if (nbytes < 0) {
+      return nbytes;
     }
     src += cbytes;
     ctbytes += cbytes;
@@ -796,21 +1454,22 @@ static int blosc_d(
   } /* Closes j < nsplits */
 
   if (context->filtercode == BLOSC_SHUFFLE) {
-    unshuffle(typesize, blocksize, tmp, dest + offset);
+    unshuffle(typesize, blocksize, tmp, dest);
   }
   else if (context->filtercode == BLOSC_BITSHUFFLE) {
-    bscount = bitunshuffle(typesize, blocksize, tmp, dest + offset, tmp2);
+    bscount = bitunshuffle(typesize, blocksize, tmp, dest, tmp2);
     if (bscount < 0)
       return bscount;
   }
 
   if (context->schunk != NULL) {
-    uint8_t* filters;
-    filters = decode_filters(context->schunk->filters);
+    decode_filters(context->schunk->filters, filters);
     if (filters[0] == BLOSC_DELTA) {
-      delta_decoder8(context->schunk->filters_chunk, offset, blocksize, dest + offset);
+      /* tmp is not needed anymore, so use it for the reference */
+      delta_decoder8(get_delta_dctx(thread_context),
+                     context->schunk->filters_chunk, offset, blocksize,
+                     dest, tmp);
     }
-    free(filters);
   }
 
   /* Return the number of uncompressed bytes */
@@ -818,40 +1477,239 @@ static int blosc_d(
 }
 
 
-/* Serial version for compression/decompression */
-static int serial_blosc(struct thread_context* thread_context) {
-  blosc_context* context = thread_context->parent_context;
-  int32_t j, bsize, leftoverblock;
-  int32_t cbytes;
+/* Whether the bytes of a block can be decompressed split by split.  This
+   is the case for split blocks of buffers that are not shuffled, where
+   every split holds a contiguous part of the block. */
+static int splits_are_contiguous(blosc_context* context, int32_t leftoverblock) {
+  int dont_split = (*(context->header_flags) & 0x10) >> 4;
+  uint8_t filters[BLOSC_MAX_FILTERS];
 
-  int32_t ebsize = context->blocksize + context->typesize * (int32_t)sizeof(int32_t);
-  int32_t ntbytes = context->num_output_bytes;
+  if (dont_split || leftoverblock || context->typesize <= 1 ||
+      context->filtercode != BLOSC_NOSHUFFLE) {
+    return 0;
+  }
+  if (context->schunk != NULL) {
+    decode_filters(context->schunk->filters, filters);
+    if (filters[0] == BLOSC_DELTA) {
+      return 0;
+    }
+  }
+  return 1;
+}
 
-  uint8_t* tmp = thread_context->tmp;
-  uint8_t* tmp2 = thread_context->tmp2;
+/* Decompress only the splits of the (unshuffled) block in `src` that
+   overlap the bytes [`startb`, `stopb`) of the block into the same
+   positions of `dest`.  The splits before them are skipped by their
+   compressed sizes.  Returns 0 or a negative value if some error
+   happens. */
+static int blosc_d_splits(struct thread_context* thread_context,
+                          int32_t blocksize, const uint8_t* src, uint8_t* dest,
+                          int64_t startb, int64_t stopb) {
+  blosc_context* context = thread_context->parent_context;
+  int32_t compformat = (*(context->header_flags) & 0xe0) >> 5;
+  int32_t neblock = blocksize / context->typesize;
+  int32_t jstart = (int32_t)(startb / neblock);
+  int32_t jstop = (int32_t)((stopb + neblock - 1) / neblock);
+  int32_t j, cbytes, nbytes;
 
-  for (j = 0; j < context->nblocks; j++) {
-    if (context->compress && !(*(context->header_flags) & BLOSC_MEMCPYED)) {
-      _sw32(context->bstarts + j * 4, ntbytes);
-    }
-    bsize = context->blocksize;
-    leftoverblock = 0;
-    if ((j == context->nblocks - 1) && (context->leftover > 0)) {
-      bsize = context->leftover;
-      leftoverblock = 1;
+  for (j = 0; j < jstop; j++) {
+    cbytes = sw32_(src);      /* amount of compressed bytes */
+    src += sizeof(int32_t);
+    if (j >= jstart) {
+      nbytes = decompress_split(thread_context, compformat, src, cbytes,
+                                dest + (int64_t)j * neblock, neblock);
+      if (nbytes < 0) {
+        return nbytes;
+      }
     }
-    if (context->compress) {
-      if (*(context->header_flags) & BLOSC_MEMCPYED) {
-        /* We want to memcpy only */
-        memcpy(context->dest + BLOSC_MAX_OVERHEAD + j * context->blocksize,
-               context->src + j * context->blocksize,
-               bsize);
+    src += cbytes;
+  }
+  return 0;
+}
+
+
+/* Decompress the part of block `nblock` that overlaps the byte range
+   wanted from the buffer in the parent context.  Blocks that are wholly
+   in the range go straight to their place in `dest`; only the ones at
+   the edges of the range (or all of them, when the context has a cache
+   of blocks) are decompressed into a temporary first.  For the blocks
+   at the edges of unshuffled buffers only the splits covering the range
+   are decompressed.
+
+   Returns the number of bytes put in `dest` or a negative value if some
+   error happens. */
+static int32_t decompress_block(struct thread_context* thread_context,
+                                int32_t nblock) {
+  blosc_context* context = thread_context->parent_context;
+  struct blosc_block_cache* cache = context->block_cache;
+  int32_t bsize = context->blocksize;
+  int32_t leftoverblock = 0;
+  int64_t offset = (int64_t)nblock * context->blocksize;
+  int64_t startb, stopb;
+  const uint8_t* src;
+  uint8_t* dest;
+  uint64_t tag = 0;
+  int32_t cbytes;
+
+  if ((nblock == context->nblocks - 1) && (context->leftover > 0)) {
+    bsize = context->leftover;
+    leftoverblock = 1;
+  }
+  startb = (context->range_start > offset) ? context->range_start - offset : 0;
+  stopb = (context->range_stop < offset + bsize) ?
+          context->range_stop - offset : bsize;
+  dest = context->dest + (offset + startb - context->range_start);
+
+  if (*(context->header_flags) & BLOSC_MEMCPYED) {
+    /* We want to memcpy only */
+    memcpy(dest, context->src + context->header_len + offset + startb,
+           (size_t)(stopb - startb));
+    return (int32_t)(stopb - startb);
+  }
+
+  if (cache != NULL) {
+    tag = block_cache_key(context, nblock);
+    if (block_cache_get(cache, context->src, tag, nblock, startb,
+                        stopb - startb, dest)) {
+      return (int32_t)(stopb - startb);
+    }
+  }
+  else if (startb == 0 && stopb == bsize) {
+    return blosc_d(thread_context, bsize, leftoverblock,
+                   context->src + get_bstart(context->bstarts,
+                                             context->extended, nblock),
+                   dest, offset, thread_context->tmp, thread_context->tmp2);
+  }
+  src = context->src + get_bstart(context->bstarts, context->extended, nblock);
+  if (cache == NULL && splits_are_contiguous(context, leftoverblock)) {
+    /* Only the splits covering the range are needed */
+    cbytes = blosc_d_splits(thread_context, bsize, src, thread_context->tmp3,
+                            startb, stopb);
+    if (cbytes < 0) {
+      return cbytes;
+    }
+    memcpy(dest, thread_context->tmp3 + startb, (size_t)(stopb - startb));
+    return (int32_t)(stopb - startb);
+  }
+  cbytes = blosc_d(thread_context, bsize, leftoverblock, src,
+                   thread_context->tmp3, offset, thread_context->tmp,
+                   thread_context->tmp2);
+  if (cbytes < 0) {
+    return cbytes;
+  }
+  if (cache != NULL) {
+    block_cache_put(cache, context->src, tag, nblock, thread_context->tmp3,
+                    bsize);
+  }
+  memcpy(dest, thread_context->tmp3 + startb, (size_t)(stopb - startb));
+  return (int32_t)(stopb - startb);
+}
+
+
+/* Decompress the block of group `ngroup` in a gather once and scatter
+   its pieces into `dest`.  A block holding a single piece that covers it
+   all goes straight to its place in `dest`.
+
+   Returns the number of bytes put in `dest` or a negative value if some
+   error happens. */
+static int32_t gather_block(struct thread_context* thread_context,
+                            int32_t ngroup) {
+  blosc_context* context = thread_context->parent_context;
+  struct blosc_block_cache* cache = context->block_cache;
+  struct blosc_gather_piece* pieces = context->gather_pieces;
+  int32_t first = context->gather_groups[ngroup];
+  int32_t last = context->gather_groups[ngroup + 1];
+  int32_t nblock = pieces[first].nblock;
+  int32_t bsize = context->blocksize;
+  int32_t leftoverblock = 0;
+  int64_t offset = (int64_t)nblock * context->blocksize;
+  const uint8_t* src;
+  uint64_t tag = 0;
+  int32_t ntbytes = 0;
+  int32_t cbytes;
+  int32_t i;
+
+  if ((nblock == context->nblocks - 1) && (context->leftover > 0)) {
+    bsize = context->leftover;
+    leftoverblock = 1;
+  }
+
+  if (cache != NULL) {
+    tag = block_cache_key(context, nblock);
+  }
+  if (*(context->header_flags) & BLOSC_MEMCPYED) {
+    /* We want to memcpy only */
+    src = context->src + context->header_len + offset;
+  }
+  else if (cache != NULL &&
+           block_cache_get(cache, context->src, tag, nblock, 0, bsize,
+                           thread_context->tmp3)) {
+    src = thread_context->tmp3;
+  }
+  else {
+    src = context->src + get_bstart(context->bstarts, context->extended, nblock);
+    if (cache == NULL && last - first == 1 && pieces[first].nbytes == bsize) {
+      return blosc_d(thread_context, bsize, leftoverblock, src,
+                     context->dest + pieces[first].doffset, offset,
+                     thread_context->tmp, thread_context->tmp2);
+    }
+    cbytes = blosc_d(thread_context, bsize, leftoverblock, src,
+                     thread_context->tmp3, offset, thread_context->tmp,
+                     thread_context->tmp2);
+    if (cbytes < 0) {
+      return cbytes;
+    }
+    if (cache != NULL) {
+      block_cache_put(cache, context->src, tag, nblock, thread_context->tmp3,
+                      bsize);
+    }
+    src = thread_context->tmp3;
+  }
+
+  for (i = first; i < last; i++) {
+    memcpy(context->dest + pieces[i].doffset, src + pieces[i].start,
+           (size_t)pieces[i].nbytes);
+    ntbytes += pieces[i].nbytes;
+  }
+  return ntbytes;
+}
+
+
+/* Serial version for compression/decompression */
+static int64_t serial_blosc(struct thread_context* thread_context) {
+  blosc_context* context = thread_context->parent_context;
+  int32_t j, bsize, leftoverblock;
+  int32_t cbytes;
+  int64_t offset;
+
+  int32_t ebsize = context->blocksize + context->typesize * (int32_t)sizeof(int32_t);
+  int64_t ntbytes = context->num_output_bytes;
+
+  uint8_t* tmp = thread_context->tmp;
+  uint8_t* tmp2 = thread_context->tmp2;
+
+  for (j = 0; j < context->nblocks; j++) {
+    if (context->compress && !(*(context->header_flags) & BLOSC_MEMCPYED)) {
+      set_bstart(context->bstarts, context->extended, j, ntbytes);
+    }
+    offset = (int64_t)j * context->blocksize;
+    bsize = context->blocksize;
+    leftoverblock = 0;
+    if ((j == context->nblocks - 1) && (context->leftover > 0)) {
+      bsize = context->leftover;
+      leftoverblock = 1;
+    }
+    if (context->compress) {
+      if (*(context->header_flags) & BLOSC_MEMCPYED) {
+        /* We want to memcpy only */
+        memcpy(context->dest + context->header_len + offset,
+               context->src + offset, bsize);
         cbytes = bsize;
       }
       else {
         /* Regular compression */
         cbytes = blosc_c(thread_context, bsize, leftoverblock, ntbytes,
-                         context->destsize, context->src, j * context->blocksize,
+                         context->destsize, context->src + offset, offset,
                          context->dest + ntbytes, tmp, tmp2);
         if (cbytes == 0) {
           ntbytes = 0;              /* uncompressible data */
@@ -860,19 +1718,7 @@ static int serial_blosc(struct thread_context* thread_context) {
       }
     }
     else {
-      if (*(context->header_flags) & BLOSC_MEMCPYED) {
-        /* We want to memcpy only */
-        memcpy(context->dest + j * context->blocksize,
-               context->src + BLOSC_MAX_OVERHEAD + j * context->blocksize,
-               bsize);
-        cbytes = bsize;
-      }
-      else {
-        /* Regular decompression */
-        cbytes = blosc_d(thread_context, bsize, leftoverblock,
-                         context->src + sw32_(context->bstarts + j * 4),
-                         context->dest, j * context->blocksize, tmp, tmp2);
-      }
+      cbytes = decompress_block(thread_context, j);
     }
     if (cbytes < 0) {
       ntbytes = cbytes;         /* error in blosc_c or blosc_d */
@@ -885,45 +1731,32 @@ static int serial_blosc(struct thread_context* thread_context) {
 }
 
 
-/* Threaded version for compression/decompression */
-static int parallel_blosc(blosc_context* context) {
-  int rc;
-
-  /* Set sentinels */
-  context->thread_giveup_code = 1;
-  context->thread_nblock = -1;
-
-  /* Synchronization point for all threads (wait for initialization) */
-  WAIT_INIT(-1, context);
-
-  /* Synchronization point for all threads (wait for finalization) */
-  WAIT_FINISH(-1, context);
-
-  if (context->thread_giveup_code > 0) {
-    /* Return the total bytes (de-)compressed in threads */
-    return context->num_output_bytes;
-  }
-  else {
-    /* Compression/decompression gave up.  Return error code. */
-    return context->thread_giveup_code;
-  }
-}
-
-
 static struct thread_context* create_thread_context(
-                                blosc_context* context, int32_t tid) {
+    blosc_context* context, const blosc2_allocator* allocator, int32_t tid) {
   struct thread_context* thread_context;
   int32_t ebsize;
 
-  thread_context = (struct thread_context*)my_malloc(sizeof(struct thread_context));
+  thread_context = (struct thread_context*)my_malloc(allocator, sizeof(struct thread_context));
+  thread_context->allocator = *allocator;
   thread_context->parent_context = context;
   thread_context->tid = tid;
-
-  ebsize = context->blocksize + context->typesize * (int32_t)sizeof(int32_t);
-  thread_context->tmp = my_malloc(context->blocksize + ebsize + context->blocksize);
-  thread_context->tmp2 = thread_context->tmp + context->blocksize;
-  thread_context->tmp3 = thread_context->tmp + context->blocksize + ebsize;
-  thread_context->tmpblocksize = context->blocksize;
+  thread_context->threadpool = NULL;
+  thread_context->delta_dctx = NULL;
+
+  if (context == NULL) {
+    /* Pool workers get their temporaries when attaching to a job */
+    thread_context->tmp = NULL;
+    thread_context->tmpblocksize = 0;
+    thread_context->tmpebsize = 0;
+  }
+  else {
+    ebsize = context->blocksize + context->typesize * (int32_t)sizeof(int32_t);
+    thread_context->tmp = my_malloc(allocator, context->blocksize + ebsize + context->blocksize);
+    thread_context->tmp2 = thread_context->tmp + context->blocksize;
+    thread_context->tmp3 = thread_context->tmp + context->blocksize + ebsize;
+    thread_context->tmpblocksize = context->blocksize;
+    thread_context->tmpebsize = ebsize;
+  }
   #if defined(HAVE_ZSTD)
   thread_context->zstd_cctx = NULL;
   thread_context->zstd_dctx = NULL;
@@ -933,7 +1766,12 @@ static struct thread_context* create_thread_context(
 }
 
 void free_thread_context(struct thread_context* thread_context) {
-  my_free(thread_context->tmp);
+  blosc2_allocator allocator = thread_context->allocator;
+
+  my_free(&allocator, thread_context->tmp);
+  if (thread_context->delta_dctx != NULL) {
+    blosc2_free_ctx(thread_context->delta_dctx);
+  }
   #if defined(HAVE_ZSTD)
   if (thread_context->zstd_cctx != NULL) {
     ZSTD_freeCCtx(thread_context->zstd_cctx);
@@ -942,38 +1780,185 @@ void free_thread_context(struct thread_context* thread_context) {
     ZSTD_freeDCtx(thread_context->zstd_dctx);
   }
   #endif
-  my_free(thread_context);
+  my_free(&allocator, thread_context);
+}
+
+/* Grow the temporaries of a thread context if they are too small for
+   the blocksize and typesize of the current job.  They are never shrunk,
+   so that jobs with different blocksizes do not keep reallocating them. */
+static void resize_temporaries(struct thread_context* thread_context,
+                               int32_t blocksize, int32_t typesize) {
+  int32_t ebsize = blocksize + typesize * (int32_t)sizeof(int32_t);
+
+  if (blocksize <= thread_context->tmpblocksize &&
+      ebsize <= thread_context->tmpebsize) {
+    return;
+  }
+  if (blocksize < thread_context->tmpblocksize) {
+    blocksize = thread_context->tmpblocksize;
+  }
+  if (ebsize < thread_context->tmpebsize) {
+    ebsize = thread_context->tmpebsize;
+  }
+  my_free(&thread_context->allocator, thread_context->tmp);
+  thread_context->tmp = my_malloc(&thread_context->allocator,
+                                  blocksize + ebsize + blocksize);
+  thread_context->tmp2 = thread_context->tmp + blocksize;
+  thread_context->tmp3 = thread_context->tmp + blocksize + ebsize;
+  thread_context->tmpblocksize = blocksize;
+  thread_context->tmpebsize = ebsize;
+  if (thread_context->threadpool != NULL &&
+      thread_context->threadpool->ncpus > 0) {
+    /* Touch the pages from the pinned worker so that they are placed
+       in its NUMA node */
+    memset(thread_context->tmp, 0, (size_t)(blocksize + ebsize + blocksize));
+  }
 }
 
 /* Do the compression or decompression of the buffer depending on the
    global params. */
-static int do_job(blosc_context* context) {
-  int32_t ntbytes;
+static int64_t do_job(blosc_context* context) {
+  int64_t ntbytes;
 
-  /* Run the serial version when nthreads is 1 or when the buffers are
-     not larger than blocksize */
-  if (context->nthreads == 1 || (context->sourcesize / context->blocksize) <= 1) {
+  /* Run the serial version when nthreads is 1 or when there is only one
+     block (handing out jobs is cheap enough that a leftover block is
+     worth sending to another thread) */
+  if (context->nthreads == 1 || context->nblocks <= 1) {
     /* The context for this 'thread' has no been initialized yet */
     if (context->serial_context == NULL) {
-      context->serial_context = create_thread_context(context, 0);
+      context->serial_context = create_thread_context(context, &context->allocator, 0);
     }
-    else if (context->blocksize != context->serial_context->tmpblocksize) {
-      free_thread_context(context->serial_context);
-      context->serial_context = create_thread_context(context, 0);
+    else {
+      /* The threads of a batch may have left another parent here */
+      context->serial_context->parent_context = context;
+      resize_temporaries(context->serial_context, context->blocksize,
+                         context->typesize);
     }
     ntbytes = serial_blosc(context->serial_context);
   }
   else {
-    /* Check whether we need to restart threads */
-    blosc_set_nthreads_(context);
+    if (context->threadpool == NULL) {
+      /* Check whether we need to restart the private threads */
+      blosc_set_nthreads_(context);
+    }
     /* and run the job */
-    ntbytes = parallel_blosc(context);
+    ntbytes = pool_blosc(context);
   }
 
   return ntbytes;
 }
 
 
+#if defined(__linux__)
+/* Parse a cache size from sysfs, like "48K" or "32M" */
+static int64_t read_sysfs_size(const char* path) {
+  FILE* f = fopen(path, "r");
+  char buf[32];
+  char* end;
+  int64_t size = 0;
+
+  if (f == NULL) {
+    return 0;
+  }
+  if (fgets(buf, sizeof(buf), f) != NULL) {
+    size = strtol(buf, &end, 10);
+    if (*end == 'K') {
+      size *= KB;
+    }
+    else if (*end == 'M') {
+      size *= MB;
+    }
+  }
+  fclose(f);
+  return size;
+}
+#endif  /* __linux__ */
+
+/* Detect the sizes of the caches of the first CPU */
+static void detect_cache_sizes(void) {
+  int64_t sizes[3] = {0, 0, 0};
+  int i;
+#if defined(__linux__)
+  char path[128];
+  char type[32];
+  int64_t level;
+  FILE* f;
+
+  for (i = 0; i < 8; i++) {
+    sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/level", i);
+    level = read_sysfs_size(path);
+    if (level < 1 || level > 3) {
+      continue;
+    }
+    sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/type", i);
+    f = fopen(path, "r");
+    if (f == NULL) {
+      continue;
+    }
+    if (fgets(type, sizeof(type), f) != NULL && strncmp(type, "Instruction", 11) != 0) {
+      sprintf(path, "/sys/devices/system/cpu/cpu0/cache/index%d/size", i);
+      sizes[level - 1] = read_sysfs_size(path);
+    }
+    fclose(f);
+  }
+#endif  /* __linux__ */
+#if defined(_SC_LEVEL1_DCACHE_SIZE)
+  /* glibc gets these from cpuid */
+  if (sizes[0] <= 0) {
+    sizes[0] = sysconf(_SC_LEVEL1_DCACHE_SIZE);
+  }
+  if (sizes[1] <= 0) {
+    sizes[1] = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  }
+  if (sizes[2] <= 0) {
+    sizes[2] = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  }
+#elif defined(_WIN32)
+  {
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION* info;
+    DWORD len = 0;
+    DWORD j;
+
+    GetLogicalProcessorInformation(NULL, &len);
+    info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION*)malloc(len);
+    if (info != NULL && GetLogicalProcessorInformation(info, &len)) {
+      for (j = 0; j < len / sizeof(*info); j++) {
+        if (info[j].Relationship == RelationCache &&
+            info[j].Cache.Level >= 1 && info[j].Cache.Level <= 3 &&
+            info[j].Cache.Type != CacheInstruction &&
+            sizes[info[j].Cache.Level - 1] == 0) {
+          sizes[info[j].Cache.Level - 1] = info[j].Cache.Size;
+        }
+      }
+    }
+    free(info);
+  }
+#endif
+
+  for (i = 0; i < 3; i++) {
+    /* Discard nonsense values */
+    g_cache_sizes[i] = (sizes[i] >= KB && sizes[i] <= INT32_MAX / 2) ?
+                       (int32_t)sizes[i] : 0;
+  }
+}
+
+/* Detect the sizes of the caches, only once.  Contexts can be used without
+   blosc_init(), so the first thread that gets here does it, and the
+   others wait for it, so that all of them compute the same blocksizes. */
+static void init_cache_sizes(void) {
+  if (BLOSC_ATOMIC_LOAD32(&g_cache_detected)) {
+    return;
+  }
+  if (BLOSC_ATOMIC_ADD32(&g_cache_claimed, 1) == 0) {
+    detect_cache_sizes();
+    BLOSC_ATOMIC_STORE32(&g_cache_detected, 1);
+    return;
+  }
+  while (!BLOSC_ATOMIC_LOAD32(&g_cache_detected)) {
+    BLOSC_CPU_RELAX();
+  }
+}
+
 /* Whether a codec is meant for High Compression Ratios */
 /* Include LZ4 + BITSHUFFLE here, but not BloscLZ + BITSHUFFLE because,
    for some reason, the latter couple does not work too well */
@@ -984,10 +1969,34 @@ static int do_job(blosc_context* context) {
              ((codec) == BLOSC_ZLIB) ||  \
              ((codec) == BLOSC_ZSTD) ? 1 : 0 )
 
+/* The number of blocks that every thread keeps in use during the
+   (de-)compression of a block: the source and the destination, plus the
+   shuffled copy and the scratch of bitshuffle */
+static int32_t working_set_nblocks(int filtercode) {
+  switch (filtercode) {
+    case BLOSC_SHUFFLE:
+      return 3;
+    case BLOSC_BITSHUFFLE:
+      return 4;
+    default:
+      return 2;
+  }
+}
+
+/* The size of the L1 data cache, or a sensible default */
+static int32_t get_l1_size(void) {
+  init_cache_sizes();
+  return g_cache_sizes[0] ? g_cache_sizes[0] : L1;
+}
+
 static int32_t compute_blocksize(
-    blosc_context* context, int32_t clevel, int32_t typesize, int32_t nbytes,
+    blosc_context* context, int32_t clevel, int32_t typesize, int64_t nbytes,
     int32_t forced_blocksize) {
-  int32_t blocksize = nbytes;
+  int32_t blocksize = (nbytes > BLOSC_MAX_BUFFERSIZE) ?
+                      BLOSC_MAX_BUFFERSIZE : (int32_t)nbytes;
+  int32_t l1 = get_l1_size();
+  int32_t l2 = g_cache_sizes[1];
+  int32_t maxsize;
 
   /* Protection against very small buffers */
   if (nbytes < (int32_t)typesize) {
@@ -1001,8 +2010,8 @@ static int32_t compute_blocksize(
       blocksize = MIN_BUFFERSIZE;
     }
   }
-  else if (nbytes >= L1) {
-    blocksize = L1;
+  else if (nbytes >= l1) {
+    blocksize = l1;
 
     /* For HCR codecs, increase the block sizes by a factor of 2 because they
        are meant for compressing large blocks (i.e. they show a big overhead
@@ -1034,18 +2043,29 @@ static int32_t compute_blocksize(
       blocksize *= 8;
       break;
     case 9:
-      /* Do not exceed 256 KB for non HCR codecs */
+      /* Do not exceed 8 times L1 for non HCR codecs */
       blocksize *= 8;
       if (HCR(context->compcode, context->filtercode)) {
         blocksize *= 2;
       }
       break;
     }
+
+    /* The blocks in use by every thread should fit in L2 */
+    if (l2 > 0) {
+      maxsize = l2 / working_set_nblocks(context->filtercode);
+      if (maxsize < l1) {
+        maxsize = l1;
+      }
+      if (blocksize > maxsize) {
+        blocksize = maxsize;
+      }
+    }
   }
 
   /* Check that blocksize is not too large */
-  if (blocksize > (int32_t)nbytes) {
-    blocksize = nbytes;
+  if (blocksize > nbytes) {
+    blocksize = (int32_t)nbytes;
   }
 
   /* blocksize *must absolutely* be a multiple of the typesize */
@@ -1067,23 +2087,22 @@ static int initialize_context_compression(
   context->src = (const uint8_t*)src;
   context->dest = (uint8_t*)(dest);
   context->num_output_bytes = 0;
-  context->destsize = (int32_t)destsize;
-  context->sourcesize = sourcesize;
+  context->destsize = (destsize > INT64_MAX) ? INT64_MAX : (int64_t)destsize;
+  context->sourcesize = (int64_t)sourcesize;
   context->typesize = typesize;
   context->filtercode = filtercode;
   context->compcode = compressor;
   context->nthreads = nthreads;
-  context->end_threads = 0;
   context->clevel = clevel;
   context->schunk = schunk;
 
-  /* Check buffer size limits */
-  if (sourcesize > BLOSC_MAX_BUFFERSIZE) {
-    /* If buffer is too large, give up. */
-    fprintf(stderr, "Input buffer size cannot exceed %d bytes\n",
-            BLOSC_MAX_BUFFERSIZE);
-    return -1;
-  }
+  /* Buffers that are too large for the regular header get an extended one */
+  context->extended = (sourcesize > BLOSC_MAX_BUFFERSIZE);
+#if defined(BLOSC_TESTING)
+  context->extended |= g_force_extended;
+#endif  /* defined(BLOSC_TESTING) */
+  context->header_len = context->extended ?
+                        BLOSC_EXTENDED_HEADER_LENGTH : BLOSC_MIN_HEADER_LENGTH;
 
   /* Compression level */
   if (clevel < 0 || clevel > 9) {
@@ -1111,10 +2130,19 @@ static int initialize_context_compression(
     context, clevel, (int32_t)context->typesize, context->sourcesize, blocksize);
 
   /* Compute number of blocks in buffer */
-  context->nblocks = context->sourcesize / context->blocksize;
-  context->leftover = context->sourcesize % context->blocksize;
+  if (context->sourcesize / context->blocksize >= INT32_MAX) {
+    fprintf(stderr, "Input buffer has too many blocks; "
+                    "use a larger blocksize\n");
+    return -1;
+  }
+  context->nblocks = (int32_t)(context->sourcesize / context->blocksize);
+  context->leftover = (int32_t)(context->sourcesize % context->blocksize);
   context->nblocks = (context->leftover > 0) ? \
    (context->nblocks + 1) : context->nblocks;
+  context->range_start = 0;
+  context->range_stop = context->sourcesize;
+  context->block_start = 0;
+  context->block_stop = context->nblocks;
 
   return 1;
 }
@@ -1134,32 +2162,39 @@ static uint8_t get_filtercode(const uint8_t header_flags, const int32_t typesize
 static int initialize_context_decompression(
     blosc_context* context, const void* src, void* dest, size_t destsize) {
 
-  int i;
+  int64_t cbytes;
 
   context->compress = 0;
   context->src = (const uint8_t*)src;
   context->dest = (uint8_t*)dest;
-  context->destsize = destsize;
+  context->destsize = (destsize > INT64_MAX) ? INT64_MAX : (int64_t)destsize;
   context->num_output_bytes = 0;
-  context->end_threads = 0;
 
   context->header_flags = (uint8_t*)(context->src + 2); /* flags */
   context->typesize = (int32_t)context->src[3];      /* typesize */
-  context->sourcesize = sw32_(context->src + 4);     /* buffer size */
-  context->blocksize = sw32_(context->src + 8);      /* block size */
+  context->header_len = read_header_sizes(context->src, &context->sourcesize,
+                                          &context->blocksize, &cbytes);
+  context->extended = (context->header_len == BLOSC_EXTENDED_HEADER_LENGTH);
   context->filtercode = get_filtercode(*(context->header_flags), context->typesize);
 
   /* Check that we have enough space to decompress */
-  if (context->sourcesize > (int32_t)destsize) {
+  if (context->sourcesize > context->destsize) {
     return -1;
   }
 
-  context->bstarts = (uint8_t*)(context->src + 16);
+  context->bstarts = (uint8_t*)(context->src + context->header_len);
   /* Compute some params */
   /* Total blocks */
-  context->nblocks = context->sourcesize / context->blocksize;
-  context->leftover = context->sourcesize % context->blocksize;
+  context->nblocks = (int32_t)(context->sourcesize / context->blocksize);
+  context->leftover = (int32_t)(context->sourcesize % context->blocksize);
   context->nblocks = (context->leftover > 0) ? context->nblocks + 1 : context->nblocks;
+  context->range_start = 0;
+  context->range_stop = context->sourcesize;
+  context->block_start = 0;
+  context->block_stop = context->nblocks;
+  if (context->block_cache != NULL) {
+    set_block_cache_tag(context, cbytes);
+  }
 
   return 0;
 }
@@ -1181,7 +2216,8 @@ static int write_compression_header(blosc_context* context) {
   int dont_split;
 
   /* Write version header for this block */
-  context->dest[0] = BLOSC_VERSION_FORMAT;          /* blosc format version */
+  context->dest[0] = context->extended ?
+                     BLOSC_VERSION_FORMAT_64 : BLOSC_VERSION_FORMAT;
 
   /* Write compressor format */
   compformat = -1;
@@ -1236,10 +2272,20 @@ static int write_compression_header(blosc_context* context) {
   context->header_flags = context->dest + 2;                       /* flags */
   context->dest[2] = 0;                                          /* zeroes flags */
   context->dest[3] = (uint8_t)context->typesize;                 /* type size */
-  _sw32(context->dest + 4, context->sourcesize);                 /* size of the buffer */
-  _sw32(context->dest + 8, context->blocksize);                  /* block size */
-  context->bstarts = context->dest + 16;                         /* starts for every block */
-  context->num_output_bytes = 16 + sizeof(int32_t) * context->nblocks;  /* space for header and pointers */
+  if (context->extended) {
+    _sw32(context->dest + 4, 0);                                 /* reserved */
+    _sw64(context->dest + 8, context->sourcesize);               /* size of the buffer */
+    _sw64(context->dest + 16, context->blocksize);               /* block size */
+    context->bstarts = context->dest + BLOSC_EXTENDED_HEADER_LENGTH;
+    context->num_output_bytes = BLOSC_EXTENDED_HEADER_LENGTH +
+                                (int64_t)sizeof(int64_t) * context->nblocks;
+  }
+  else {
+    _sw32(context->dest + 4, (int32_t)context->sourcesize);      /* size of the buffer */
+    _sw32(context->dest + 8, context->blocksize);                /* block size */
+    context->bstarts = context->dest + 16;                       /* starts for every block */
+    context->num_output_bytes = 16 + sizeof(int32_t) * context->nblocks;  /* space for header and pointers */
+  }
 
   if (context->clevel == 0) {
     /* Compression level 0 means buffer to be memcpy'ed */
@@ -1268,8 +2314,18 @@ static int write_compression_header(blosc_context* context) {
   return 1;
 }
 
-int blosc_compress_context(blosc_context* context) {
-  int32_t ntbytes = 0;
+/* Set the number of compressed bytes in the header */
+static void set_header_cbytes(blosc_context* context, int64_t cbytes) {
+  if (context->extended) {
+    _sw64(context->dest + 24, cbytes);
+  }
+  else {
+    _sw32(context->dest + 12, (int32_t)cbytes);
+  }
+}
+
+int64_t blosc_compress_context(blosc_context* context) {
+  int64_t ntbytes = 0;
 
   if (!(*(context->header_flags) & BLOSC_MEMCPYED)) {
     /* Do the actual compression */
@@ -1277,7 +2333,8 @@ int blosc_compress_context(blosc_context* context) {
     if (ntbytes < 0) {
       return -1;
     }
-    if ((ntbytes == 0) && (context->sourcesize + BLOSC_MAX_OVERHEAD <= context->destsize)) {
+    if ((ntbytes == 0) &&
+        (context->sourcesize + context->header_len <= context->destsize)) {
       /* Last chance for fitting `src` buffer in `dest`.  Update flags
        and do a memcpy later on. */
       *(context->header_flags) |= BLOSC_MEMCPYED;
@@ -1285,37 +2342,39 @@ int blosc_compress_context(blosc_context* context) {
   }
 
   if (*(context->header_flags) & BLOSC_MEMCPYED) {
-    if (context->sourcesize + BLOSC_MAX_OVERHEAD > context->destsize) {
+    if (context->sourcesize + context->header_len > context->destsize) {
       /* We are exceeding maximum output size */
       ntbytes = 0;
     }
-    else if (((context->sourcesize % L1) == 0) || (context->nthreads > 1)) {
+    else if (((context->sourcesize % get_l1_size()) == 0) ||
+             (context->nthreads > 1)) {
       /* More effective with large buffers that are multiples of the
        cache size or multi-cores */
-      context->num_output_bytes = BLOSC_MAX_OVERHEAD;
+      context->num_output_bytes = context->header_len;
       ntbytes = do_job(context);
       if (ntbytes < 0) {
         return -1;
       }
     }
     else {
-      memcpy(context->dest + BLOSC_MAX_OVERHEAD, context->src, context->sourcesize);
-      ntbytes = context->sourcesize + BLOSC_MAX_OVERHEAD;
+      memcpy(context->dest + context->header_len, context->src,
+             (size_t)context->sourcesize);
+      ntbytes = context->sourcesize + context->header_len;
     }
   }
 
   /* Set the number of compressed bytes in header */
-  _sw32(context->dest + 12, ntbytes);
+  set_header_cbytes(context, ntbytes);
 
   assert(ntbytes <= context->destsize);
   return ntbytes;
 }
 
-/* The public routine for compression with context. */
-int blosc2_compress_ctx(
+/* Compression with context (for buffers of any size) */
+static int64_t compress_ctx(
     blosc_context* context, size_t nbytes, const void* src, void* dest,
     size_t destsize) {
-  int error, result;
+  int error;
 
   if (context->compress != 1) {
     fprintf(stderr, "Context is not meant for compression.  Giving up.\n");
@@ -1332,9 +2391,249 @@ int blosc2_compress_ctx(
   error = write_compression_header(context);
   if (error < 0) { return error; }
 
-  result = blosc_compress_context(context);
+  return blosc_compress_context(context);
+}
+
+/* Return a timestamp in seconds (only meaningful for differences) */
+static double get_seconds(void) {
+#if defined(_WIN32)
+  LARGE_INTEGER counter, freq;
 
-  return result;
+  QueryPerformanceCounter(&counter);
+  QueryPerformanceFrequency(&freq);
+  return (double)counter.QuadPart / (double)freq.QuadPart;
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + 1e-9 * (double)ts.tv_nsec;
+#endif
+}
+
+/* A rough log2(x) for positive values, good enough for scoring (this
+   avoids linking with the math library) */
+static double approx_log2(double x) {
+  double e = 0;
+
+  while (x >= 2) {
+    x /= 2;
+    e += 1;
+  }
+  while (x < 1) {
+    x *= 2;
+    e -= 1;
+  }
+  /* Quadratic fit of log2 in [1, 2) */
+  x -= 1;
+  return e + x * (1.3465 - 0.3465 * x);
+}
+
+/* Score the compression of the sample with the params in the trial
+   context.  Higher is better. */
+static double tune_score(struct blosc_tune* tune, int32_t sample_size) {
+  int64_t cbytes;
+  double start, elapsed;
+
+  start = get_seconds();
+  cbytes = compress_ctx(tune->trial_ctx, (size_t)sample_size, tune->sample,
+                        tune->cdest, (size_t)sample_size + BLOSC_MAX_OVERHEAD);
+  elapsed = get_seconds() - start;
+  if (cbytes < 0) {
+    return -1e300;     /* the params are not usable */
+  }
+  if (cbytes == 0) {
+    cbytes = sample_size;
+  }
+  if (elapsed < 1e-9) {
+    elapsed = 1e-9;
+  }
+  /* Maximize ratio^w * speed^(1-w) */
+  return tune->ratio_weight * approx_log2((double)sample_size / (double)cbytes) +
+         (1 - tune->ratio_weight) * approx_log2((double)sample_size / elapsed);
+}
+
+/* Keep the params in the trial context if they are the best so far */
+static void tune_try(struct blosc_tune* tune, int32_t sample_size,
+                     double* best) {
+  blosc_context* trial = tune->trial_ctx;
+  double score = tune_score(tune, sample_size);
+
+  if (score > *best) {
+    *best = score;
+    tune->compcode = trial->compcode;
+    tune->filtercode = trial->filtercode;
+    tune->clevel = trial->clevel;
+    tune->blocksize = trial->blocksize;
+  }
+}
+
+/* Choose the codec, filter, clevel and blocksize for compressing `src`.
+
+   The candidates are trial-compressed on a sample of the buffer in three
+   rounds: codecs and filters first, then compression levels and finally
+   blocksizes, each round keeping the winners of the previous ones. */
+static int tune_params(blosc_context* context, size_t nbytes,
+                       const void* src) {
+  struct blosc_tune* tune = context->tune;
+  blosc_context* trial;
+  int compcodes[] = {BLOSC_BLOSCLZ, BLOSC_LZ4, BLOSC_ZSTD};
+  int filtercodes[] = {BLOSC_NOFILTER, BLOSC_SHUFFLE, BLOSC_BITSHUFFLE};
+  int32_t typesize = context->typesize;
+  int32_t slicesize = TUNE_SLICESIZE / typesize * typesize;
+  int32_t sample_size, blocksize;
+  int64_t nitems, stride;
+  double best = -1e300;
+  char* compname;
+  int i, j;
+
+  if (tune->trial_ctx == NULL) {
+    blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+
+    cparams.typesize = (uint8_t)typesize;
+    cparams.allocator = &context->allocator;
+    tune->trial_ctx = blosc2_create_cctx(&cparams);
+    tune->sample = my_malloc(&context->allocator,
+                             TUNE_NSLICES * TUNE_SLICESIZE);
+    tune->cdest = my_malloc(&context->allocator,
+                            TUNE_NSLICES * TUNE_SLICESIZE + BLOSC_MAX_OVERHEAD);
+    if (tune->trial_ctx == NULL || tune->sample == NULL ||
+        tune->cdest == NULL) {
+      return -1;
+    }
+  }
+  trial = tune->trial_ctx;
+  trial->typesize = (uint8_t)typesize;
+
+  /* Build the sample out of slices spread evenly over the buffer */
+  if (nbytes <= (size_t)(TUNE_NSLICES * slicesize)) {
+    sample_size = (int32_t)nbytes;
+    memcpy(tune->sample, src, nbytes);
+  }
+  else {
+    sample_size = TUNE_NSLICES * slicesize;
+    nitems = (int64_t)nbytes / typesize;
+    stride = (nitems - slicesize / typesize) / (TUNE_NSLICES - 1);
+    for (i = 0; i < TUNE_NSLICES; i++) {
+      memcpy(tune->sample + i * slicesize,
+             (const uint8_t*)src + i * stride * typesize, (size_t)slicesize);
+    }
+  }
+
+  /* Codecs and filters */
+  trial->clevel = 5;
+  for (i = 0; i < 3; i++) {
+    if (blosc_compcode_to_compname(compcodes[i], &compname) < 0) {
+      continue;   /* codec not available */
+    }
+    for (j = 0; j < 3; j++) {
+      trial->compcode = (uint8_t)compcodes[i];
+      trial->filtercode = (uint8_t)filtercodes[j];
+      trial->blocksize = context->forced_blocksize;
+      tune_try(tune, sample_size, &best);
+    }
+  }
+
+  /* Compression levels */
+  for (i = 1; i <= 9; i += 2) {
+    if (i == 5) {
+      continue;   /* already tried */
+    }
+    trial->compcode = tune->compcode;
+    trial->filtercode = tune->filtercode;
+    trial->clevel = (int8_t)i;
+    trial->blocksize = context->forced_blocksize;
+    tune_try(tune, sample_size, &best);
+  }
+
+  /* Blocksizes around the automatic one */
+  blocksize = tune->blocksize;
+  for (i = 0; i < 3 && !context->forced_blocksize; i++) {
+    trial->compcode = tune->compcode;
+    trial->filtercode = tune->filtercode;
+    trial->clevel = tune->clevel;
+    trial->blocksize = (i == 0) ? blocksize / 2 : blocksize * (2 << (i - 1));
+    if (trial->blocksize < MIN_BUFFERSIZE || trial->blocksize > sample_size) {
+      continue;
+    }
+    tune_try(tune, sample_size, &best);
+  }
+
+  tune->nbytes = (int64_t)nbytes;
+  tune->cratio = 0;
+  tune->valid = 1;
+  return 0;
+}
+
+/* Compression with context, setting the params with the autotuner first
+   when the context has one */
+static int64_t tuned_compress_ctx(
+    blosc_context* context, size_t nbytes, const void* src, void* dest,
+    size_t destsize) {
+  struct blosc_tune* tune = context->tune;
+  int64_t cbytes;
+  double cratio;
+
+  if (tune == NULL) {
+    /* The blocksize of the previous buffer is not a request */
+    context->blocksize = context->forced_blocksize;
+    return compress_ctx(context, nbytes, src, dest, destsize);
+  }
+
+  /* Buffers of a very different size need different params */
+  if (tune->valid &&
+      ((int64_t)nbytes > 2 * tune->nbytes || 2 * (int64_t)nbytes < tune->nbytes)) {
+    tune->valid = 0;
+  }
+  if (!tune->valid && tune_params(context, nbytes, src) < 0) {
+    return -1;
+  }
+  context->compcode = tune->compcode;
+  context->filtercode = tune->filtercode;
+  context->clevel = tune->clevel;
+  context->blocksize = tune->blocksize;
+
+  cbytes = compress_ctx(context, nbytes, src, dest, destsize);
+
+  /* Discard the params when the data statistics drift */
+  if (cbytes > 0) {
+    cratio = (double)nbytes / (double)cbytes;
+    if (tune->cratio == 0) {
+      tune->cratio = cratio;
+    }
+    else if (cratio > tune->cratio * TUNE_DRIFT ||
+             cratio * TUNE_DRIFT < tune->cratio) {
+      tune->valid = 0;
+    }
+  }
+  return cbytes;
+}
+
+/* Check that the size of a buffer fits in the regular API */
+static int check_buffersize(size_t nbytes) {
+  if (nbytes > BLOSC_MAX_BUFFERSIZE) {
+    /* If buffer is too large, give up. */
+    fprintf(stderr, "Input buffer size cannot exceed %d bytes\n",
+            BLOSC_MAX_BUFFERSIZE);
+    return -1;
+  }
+  return 0;
+}
+
+/* The public routine for compression with context. */
+int blosc2_compress_ctx(
+    blosc_context* context, size_t nbytes, const void* src, void* dest,
+    size_t destsize) {
+  if (check_buffersize(nbytes) < 0) {
+    return -1;
+  }
+  return (int)tuned_compress_ctx(context, nbytes, src, dest, destsize);
+}
+
+/* The public routine for compression of large buffers with context. */
+int64_t blosc2_compress_ctx64(
+    blosc_context* context, size_t nbytes, const void* src, void* dest,
+    size_t destsize) {
+  return tuned_compress_ctx(context, nbytes, src, dest, destsize);
 }
 
 /* The public routine for compression.  See blosc.h for docstrings. */
@@ -1349,6 +2648,10 @@ int blosc_compress(int clevel, int doshuffle, size_t typesize, size_t nbytes,
   /* Check whether the library should be initialized */
   if (!g_initlib) blosc_init();
 
+  if (check_buffersize(nbytes) < 0) {
+    return -1;
+  }
+
   /* Check for a BLOSC_CLEVEL environment variable */
   envvar = getenv("BLOSC_CLEVEL");
   if (envvar != NULL) {
@@ -1442,20 +2745,19 @@ int blosc_compress(int clevel, int doshuffle, size_t typesize, size_t nbytes,
   error = write_compression_header(g_global_context);
   if (error < 0) { return error; }
 
-  result = blosc_compress_context(g_global_context);
+  result = (int)blosc_compress_context(g_global_context);
 
   pthread_mutex_unlock(&global_comp_mutex);
 
   return result;
 }
 
-int blosc_run_decompression_with_context(
+int64_t blosc_run_decompression_with_context(
     blosc_context* context, const void* src, void* dest,
     size_t destsize) {
   uint8_t version;
   uint8_t versionlz;
-  uint32_t ctbytes;
-  int32_t ntbytes;
+  int64_t ntbytes;
   int error;
 
   error = initialize_context_decompression(context, src, dest, destsize);
@@ -1464,16 +2766,15 @@ int blosc_run_decompression_with_context(
   /* Read the header block */
   version = context->src[0];                        /* blosc format version */
   versionlz = context->src[1];                      /* blosclz format version */
-  ctbytes = sw32_(context->src + 12);               /* compressed buffer size */
 
   /* Unused values */
   version += 0;                             /* shut up compiler warning */
   versionlz += 0;                           /* shut up compiler warning */
-  ctbytes += 0;                             /* shut up compiler warning */
 
   /* Check whether this buffer is memcpy'ed */
   if (*(context->header_flags) & BLOSC_MEMCPYED) {
-    memcpy(dest, (uint8_t*)src + BLOSC_MAX_OVERHEAD, context->sourcesize);
+    memcpy(dest, (uint8_t*)src + context->header_len,
+           (size_t)context->sourcesize);
     ntbytes = context->sourcesize;
   }
   else {
@@ -1484,22 +2785,272 @@ int blosc_run_decompression_with_context(
     }
   }
 
-  assert(ntbytes <= (int32_t)destsize);
+  assert(ntbytes <= context->destsize);
   return ntbytes;
 }
 
+/* Check that the uncompressed size of a buffer fits in the regular API */
+static int check_cbuffer_nbytes(const void* src) {
+  int64_t nbytes, cbytes;
+  int32_t blocksize;
+
+  read_header_sizes((const uint8_t*)src, &nbytes, &blocksize, &cbytes);
+  if (nbytes > INT_MAX) {
+    fprintf(stderr, "Buffers larger than %d bytes can only be decompressed "
+                    "with blosc2_decompress_ctx64()\n", INT_MAX);
+    return -1;
+  }
+  return 0;
+}
+
 /* The public routine for decompression with context. */
 int blosc2_decompress_ctx(
     blosc_context* context, const void* src, void* dest, size_t destsize) {
-  int result;
+  if (context->compress != 0) {
+    fprintf(stderr, "Context is not meant for decompression.  Giving up.\n");
+    return -10;
+  }
+  if (check_cbuffer_nbytes(src) < 0) {
+    return -1;
+  }
+
+  return (int)blosc_run_decompression_with_context(context, src, dest,
+                                                   destsize);
+}
+
+/* The public routine for decompression of large buffers with context. */
+int64_t blosc2_decompress_ctx64(
+    blosc_context* context, const void* src, void* dest, size_t destsize) {
+  if (context->compress != 0) {
+    fprintf(stderr, "Context is not meant for decompression.  Giving up.\n");
+    return -10;
+  }
+
+  return blosc_run_decompression_with_context(context, src, dest, destsize);
+}
+
+/* Make room for (at least) `nbuffers` contexts for batch calls */
+static int get_batch_contexts(blosc_context* context, int32_t nbuffers) {
+  blosc_context** contexts;
+  blosc_context** job;
+  int32_t i;
+
+  if (nbuffers <= context->batch_ncontexts) {
+    return 0;
+  }
+  contexts = (blosc_context**)my_malloc(&context->allocator,
+                                        nbuffers * sizeof(blosc_context*));
+  job = (blosc_context**)my_malloc(&context->allocator,
+                                   nbuffers * sizeof(blosc_context*));
+  if (contexts == NULL || job == NULL) {
+    my_free(&context->allocator, contexts);
+    my_free(&context->allocator, job);
+    return -1;
+  }
+  for (i = 0; i < context->batch_ncontexts; i++) {
+    contexts[i] = context->batch_contexts[i];
+  }
+  for (; i < nbuffers; i++) {
+    contexts[i] = (blosc_context*)my_malloc(&context->allocator,
+                                            sizeof(blosc_context));
+    memset(contexts[i], 0, sizeof(blosc_context));
+    contexts[i]->allocator = context->allocator;
+    contexts[i]->compress = context->compress;
+    contexts[i]->nthreads = 1;
+  }
+  my_free(&context->allocator, context->batch_contexts);
+  my_free(&context->allocator, context->batch_job);
+  context->batch_contexts = contexts;
+  context->batch_job = job;
+  context->batch_ncontexts = nbuffers;
+
+  return 0;
+}
+
+/* Launch the private threads of a context for a batch (if needed) */
+static int start_batch_threads(blosc_context* context) {
+  if (context->threadpool == NULL && context->nthreads > 1) {
+    if (blosc_set_nthreads_(context) < 0) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/* The public routine for batch compression with context. */
+int blosc2_compress_batch(
+    blosc_context* context, int32_t nbuffers, const void* const* srcs,
+    const size_t* sizes, void* const* dests, const size_t* destsizes,
+    int* cbytes) {
+  blosc_context* bctx;
+  int32_t njob = 0;
+  int64_t ntbytes;
+  int32_t i, j;
+  int error, result = 0;
+
+  if (context->compress != 1) {
+    fprintf(stderr, "Context is not meant for compression.  Giving up.\n");
+    return -10;
+  }
+  if (nbuffers <= 0) {
+    return 0;
+  }
+  if (get_batch_contexts(context, nbuffers) < 0 ||
+      start_batch_threads(context) < 0) {
+    return -1;
+  }
+
+  if (context->tune != NULL) {
+    /* Tune the params with the largest buffer */
+    for (i = 1, j = 0; i < nbuffers; i++) {
+      if (sizes[i] > sizes[j]) {
+        j = i;
+      }
+    }
+    if (!context->tune->valid &&
+        tune_params(context, sizes[j], srcs[j]) < 0) {
+      return -1;
+    }
+    context->compcode = context->tune->compcode;
+    context->filtercode = context->tune->filtercode;
+    context->clevel = context->tune->clevel;
+    context->blocksize = context->tune->blocksize;
+  }
+  else {
+    context->blocksize = context->forced_blocksize;
+  }
+
+  /* Prepare the header of every buffer */
+  for (i = 0; i < nbuffers; i++) {
+    bctx = context->batch_contexts[i];
+    cbytes[i] = 0;
+    error = check_buffersize(sizes[i]);
+    if (error < 0) {
+      cbytes[i] = error;
+      continue;
+    }
+    error = initialize_context_compression(
+      bctx, sizes[i], srcs[i], dests[i], destsizes[i],
+      context->clevel, context->filtercode, context->typesize,
+      context->compcode, context->blocksize, 1, context->schunk);
+    if (error >= 0) {
+      error = write_compression_header(bctx);
+    }
+    if (error < 0) {
+      cbytes[i] = error;
+      continue;
+    }
+    if (*(bctx->header_flags) & BLOSC_MEMCPYED) {
+      if (bctx->sourcesize + bctx->header_len > bctx->destsize) {
+        /* We are exceeding maximum output size */
+        set_header_cbytes(bctx, 0);
+        continue;
+      }
+      bctx->num_output_bytes = bctx->header_len;
+    }
+    context->batch_job[njob++] = bctx;
+  }
+
+  /* Compress the blocks of all the buffers in one go */
+  run_job(context, context->batch_job, njob);
+
+  /* Finish the buffers (in the same order than they were queued) */
+  for (i = 0, j = 0; i < nbuffers && j < njob; i++) {
+    bctx = context->batch_contexts[i];
+    if (bctx != context->batch_job[j]) {
+      continue;
+    }
+    j++;
+    ntbytes = (bctx->thread_giveup_code > 0) ?
+              bctx->num_output_bytes : bctx->thread_giveup_code;
+    if (ntbytes < 0) {
+      cbytes[i] = -1;
+      continue;
+    }
+    if ((ntbytes == 0) && !(*(bctx->header_flags) & BLOSC_MEMCPYED) &&
+        (bctx->sourcesize + bctx->header_len <= bctx->destsize)) {
+      /* Last chance for fitting `src` buffer in `dest` */
+      *(bctx->header_flags) |= BLOSC_MEMCPYED;
+      cbytes[i] = (int)blosc_compress_context(bctx);
+      continue;
+    }
+    set_header_cbytes(bctx, ntbytes);
+    cbytes[i] = (int)ntbytes;
+  }
+
+  for (i = 0; i < nbuffers; i++) {
+    if (cbytes[i] < 0) {
+      result = cbytes[i];
+      break;
+    }
+  }
+  return result;
+}
+
+/* The public routine for batch decompression with context. */
+int blosc2_decompress_batch(
+    blosc_context* context, int32_t nbuffers, const void* const* srcs,
+    void* const* dests, const size_t* destsizes, int* nbytes) {
+  blosc_context* bctx;
+  int32_t njob = 0;
+  int32_t i, j;
+  int error, result = 0;
 
   if (context->compress != 0) {
     fprintf(stderr, "Context is not meant for decompression.  Giving up.\n");
     return -10;
   }
+  if (nbuffers <= 0) {
+    return 0;
+  }
+  if (get_batch_contexts(context, nbuffers) < 0 ||
+      start_batch_threads(context) < 0) {
+    return -1;
+  }
+
+  /* Read the header of every buffer */
+  for (i = 0; i < nbuffers; i++) {
+    bctx = context->batch_contexts[i];
+    bctx->schunk = context->schunk;
+    bctx->block_cache = context->block_cache;
+    bctx->block_cache_borrowed = 1;
+    error = check_cbuffer_nbytes(srcs[i]);
+    if (error >= 0) {
+      error = initialize_context_decompression(bctx, srcs[i], dests[i],
+                                               destsizes[i]);
+    }
+    if (error < 0) {
+      nbytes[i] = error;
+      continue;
+    }
+    if (*(bctx->header_flags) & BLOSC_MEMCPYED) {
+      memcpy(dests[i], (uint8_t*)srcs[i] + bctx->header_len,
+             (size_t)bctx->sourcesize);
+      nbytes[i] = (int)bctx->sourcesize;
+      continue;
+    }
+    context->batch_job[njob++] = bctx;
+  }
+
+  /* Decompress the blocks of all the buffers in one go */
+  run_job(context, context->batch_job, njob);
 
-  result = blosc_run_decompression_with_context(context, src, dest, destsize);
+  for (i = 0, j = 0; i < nbuffers && j < njob; i++) {
+    bctx = context->batch_contexts[i];
+    if (bctx != context->batch_job[j]) {
+      continue;
+    }
+    j++;
+    nbytes[i] = (bctx->thread_giveup_code > 0) ?
+                (int)bctx->num_output_bytes : -1;
+  }
 
+  for (i = 0; i < nbuffers; i++) {
+    if (nbytes[i] < 0) {
+      result = nbytes[i];
+      break;
+    }
+  }
   return result;
 }
 
@@ -1537,125 +3088,117 @@ int blosc_decompress(const void* src, void* dest, size_t destsize) {
     return result;
   }
 
+  if (check_cbuffer_nbytes(src) < 0) {
+    return -1;
+  }
+
   pthread_mutex_lock(&global_comp_mutex);
 
-  result = blosc_run_decompression_with_context(g_global_context, src, dest,
-                                                destsize);
+  result = (int)blosc_run_decompression_with_context(g_global_context, src,
+                                                     dest, destsize);
 
   pthread_mutex_unlock(&global_comp_mutex);
 
   return result;
 }
 
-/* Specific routine optimized for decompression a small number of
-   items out of a compressed chunk.  This does not use threads because
-   it would affect negatively to performance. */
-int _blosc_getitem(const blosc_context* context, const void* src, int start,
-    int nitems, void* dest) {
-  uint8_t* _src = NULL;             /* current pos for source buffer */
-  uint8_t version, versionlz;       /* versions for compressed header */
-  uint8_t flags;                    /* flags for header */
-  int32_t ntbytes = 0;              /* the number of uncompressed bytes */
-  int32_t nblocks;                  /* number of total blocks in buffer */
-  int32_t leftover;                 /* extra bytes at end of buffer */
-  uint8_t* bstarts;                 /* start pointers for each block */
-  int tmp_init = 0;
-  int32_t typesize, blocksize, nbytes, ctbytes;
-  int32_t j, bsize, bsize2, leftoverblock;
-  int32_t cbytes, startb, stopb;
-  int stop = start + nitems;
-  int32_t ebsize;
-
-  _src = (uint8_t*)(src);
+/* Read the header of the compressed buffer in `src` for fetching items
+   out of it into `dest` */
+static void initialize_context_items(blosc_context* context, const void* src,
+                                     void* dest) {
+  int64_t cbytes;
 
-  /* Read the header block */
-  version = _src[0];                        /* blosc format version */
-  versionlz = _src[1];                      /* blosclz format version */
-  flags = _src[2];                          /* flags */
-  typesize = (int32_t)_src[3];              /* typesize */
-  nbytes = sw32_(_src + 4);                 /* buffer size */
-  blocksize = sw32_(_src + 8);              /* block size */
-  ctbytes = sw32_(_src + 12);               /* compressed buffer size */
+  context->src = (const uint8_t*)src;
+  context->dest = (uint8_t*)dest;
+  context->num_output_bytes = 0;
 
-  ebsize = blocksize + typesize * (int32_t)sizeof(int32_t);
+  context->header_flags = (uint8_t*)(context->src + 2); /* flags */
+  context->typesize = (int32_t)context->src[3];      /* typesize */
+  context->header_len = read_header_sizes(context->src, &context->sourcesize,
+                                          &context->blocksize, &cbytes);
+  context->extended = (context->header_len == BLOSC_EXTENDED_HEADER_LENGTH);
+  context->filtercode = get_filtercode(*(context->header_flags), context->typesize);
+  context->bstarts = (uint8_t*)(context->src + context->header_len);
+  context->nblocks = (int32_t)(context->sourcesize / context->blocksize);
+  context->leftover = (int32_t)(context->sourcesize % context->blocksize);
+  context->nblocks = (context->leftover > 0) ? context->nblocks + 1 : context->nblocks;
+  if (context->block_cache != NULL) {
+    set_block_cache_tag(context, cbytes);
+  }
+}
 
-  version += 0;                             /* shut up compiler warning */
-  versionlz += 0;                           /* shut up compiler warning */
-  ctbytes += 0;                             /* shut up compiler warning */
+/* Prepare `context` for decompressing `nitems` items, starting at item
+   `start`, out of the compressed buffer in `src` into `dest` */
+static int initialize_context_getitem(blosc_context* context, const void* src,
+                                      int64_t start, int64_t nitems,
+                                      void* dest) {
+  int64_t stop;
 
-  _src += 16;
-  bstarts = _src;
-  /* Compute some params */
-  /* Total blocks */
-  nblocks = nbytes / blocksize;
-  leftover = nbytes % blocksize;
-  nblocks = (leftover > 0) ? nblocks + 1 : nblocks;
-  _src += sizeof(int32_t) * nblocks;
+  initialize_context_items(context, src, dest);
 
-  /* Check region boundaries */
-  if ((start < 0) || (start * typesize > nbytes)) {
+  /* Check region boundaries (before multiplying, so that nothing
+     overflows) */
+  if ((start < 0) || (start > context->sourcesize) ||
+      (start * context->typesize > context->sourcesize)) {
     fprintf(stderr, "`start` out of bounds");
     return -1;
   }
 
-  if ((stop < 0) || (stop * typesize > nbytes)) {
+  stop = start + nitems;
+  if ((nitems > context->sourcesize) || (stop < 0) ||
+      (stop * context->typesize > context->sourcesize)) {
     fprintf(stderr, "`start`+`nitems` out of bounds");
     return -1;
   }
 
-  for (j = 0; j < nblocks; j++) {
-    bsize = blocksize;
-    leftoverblock = 0;
-    if ((j == nblocks - 1) && (leftover > 0)) {
-      bsize = leftover;
-      leftoverblock = 1;
-    }
+  /* The blocks overlapping the items are computed up front */
+  context->range_start = start * context->typesize;
+  context->range_stop = stop * context->typesize;
+  context->block_start = (int32_t)(context->range_start / context->blocksize);
+  context->block_stop = (int32_t)((context->range_stop + context->blocksize - 1) /
+                                  context->blocksize);
+  if (context->range_stop <= context->range_start) {
+    context->block_stop = context->block_start;
+  }
 
-    /* Compute start & stop for each block */
-    startb = start * typesize - j * blocksize;
-    stopb = stop * typesize - j * blocksize;
-    if ((startb >= (int)blocksize) || (stopb <= 0)) {
-      continue;
-    }
-    if (startb < 0) {
-      startb = 0;
-    }
-    if (stopb > (int)blocksize) {
-      stopb = blocksize;
-    }
-    bsize2 = stopb - startb;
+  return 0;
+}
+
+/* Specific routine optimized for decompression a small number of
+   items out of a compressed chunk.  Only the blocks overlapping the
+   items are decompressed, and the threads of the context are used when
+   there are several of them. */
+static int64_t _blosc_getitem(blosc_context* context, const void* src,
+                              int64_t start, int64_t nitems, void* dest) {
+  struct thread_context* scontext;
+  int64_t ntbytes = 0;
+  int32_t j, cbytes;
+  int error;
 
-    /* Do the actual data copy */
-    if (flags & BLOSC_MEMCPYED) {
-      /* We want to memcpy only */
-      memcpy((uint8_t*)dest + ntbytes,
-             (uint8_t*)src + BLOSC_MAX_OVERHEAD + j * blocksize + startb,
-             bsize2);
-      cbytes = bsize2;
+  error = initialize_context_getitem(context, src, start, nitems, dest);
+  if (error < 0) {
+    return error;
+  }
+
+  if (!context->compress && context->nthreads > 1 &&
+      (context->block_stop - context->block_start) > 1) {
+    if (context->threadpool == NULL && blosc_set_nthreads_(context) < 0) {
+      return -1;
     }
-    else {
-      struct thread_context* scontext = context->serial_context;
-
-      /* Resize the temporaries in serial context if needed */
-      if (blocksize != scontext->tmpblocksize) {
-        my_free(scontext->tmp);
-        scontext->tmp = my_malloc(blocksize + ebsize + blocksize);
-        scontext->tmp2 = scontext->tmp + blocksize;
-        scontext->tmp3 = scontext->tmp + blocksize + ebsize;
-        scontext->tmpblocksize = blocksize;
-      }
+    return pool_blosc(context);
+  }
 
-      /* Regular decompression.  Put results in tmp2. */
-      cbytes = blosc_d(context->serial_context, bsize, leftoverblock,
-                       (uint8_t*)src + sw32_(bstarts + j * 4),
-                       scontext->tmp2, 0, scontext->tmp, scontext->tmp3);
-      if (cbytes < 0) {
-        ntbytes = cbytes;
-        break;
-      }
-      /* Copy to destination */
-      memcpy((uint8_t*)dest + ntbytes, scontext->tmp2 + startb, bsize2);
-      cbytes = bsize2;
+  /* Serial version */
+  if (context->serial_context == NULL) {
+    context->serial_context = create_thread_context(context, &context->allocator, 0);
+  }
+  scontext = context->serial_context;
+  scontext->parent_context = context;
+  resize_temporaries(scontext, context->blocksize, context->typesize);
+  for (j = context->block_start; j < context->block_stop; j++) {
+    cbytes = decompress_block(scontext, j);
+    if (cbytes < 0) {
+      return cbytes;
     }
     ntbytes += cbytes;
   }
@@ -1663,279 +3206,921 @@ int _blosc_getitem(const blosc_context* context, const void* src, int start,
   return ntbytes;
 }
 
+/* Check that the `nitems` items fetched out of the buffer in `src` fit
+   in the int returned by the regular getitem functions */
+static int check_getitem_nbytes(const void* src, int nitems) {
+  if ((int64_t)nitems * ((const uint8_t*)src)[3] > INT_MAX) {
+    fprintf(stderr, "Items larger than %d bytes can only be fetched "
+                    "with blosc2_getitem_ctx64()\n", INT_MAX);
+    return -1;
+  }
+  return 0;
+}
+
 
 /* Specific routine optimized for decompression a small number of
    items out of a compressed chunk.  Public non-contextual API. */
 int blosc_getitem(const void* src, int start, int nitems, void* dest) {
-  uint8_t* _src = (uint8_t*)(src);
   blosc_context context;
   int result;
 
-  /* Minimally populate the context */
-  context.typesize = (int32_t)_src[3];
-  context.blocksize = sw32_(_src + 8);
-  context.header_flags = _src + 2;
-  context.filtercode = get_filtercode(*(_src + 2), context.typesize);
+  if (check_getitem_nbytes(src, nitems) < 0) {
+    return -1;
+  }
+
+  /* A serial context living in the stack */
+  memset(&context, 0, sizeof(blosc_context));
+  context.nthreads = 1;
   context.schunk = g_schunk;
-  context.serial_context = create_thread_context(&context, 0);
+  context.allocator = g_allocator;
 
   /* Call the actual getitem function */
-  result = _blosc_getitem(&context, src, start, nitems, dest);
+  result = (int)_blosc_getitem(&context, src, start, nitems, dest);
 
   /* Release resources */
-  free_thread_context(context.serial_context);
+  if (context.serial_context != NULL) {
+    free_thread_context(context.serial_context);
+  }
   return result;
 }
 
 int blosc2_getitem_ctx(blosc_context* context, const void* src, int start,
     int nitems, void* dest) {
-  uint8_t* _src = (uint8_t*)(src);
-  int result;
-
-  /* Minimally populate the context */
-  context->typesize = (int32_t)_src[3];
-  context->blocksize = sw32_(_src + 8);
-  context->header_flags = _src + 2;
-  context->filtercode = get_filtercode(*(_src + 2), context->typesize);
-  if (context->serial_context == NULL) {
-    context->serial_context = create_thread_context(context, 0);
+  if (check_getitem_nbytes(src, nitems) < 0) {
+    return -1;
   }
+  return (int)_blosc_getitem(context, src, start, nitems, dest);
+}
 
-  /* Call the actual getitem function */
-  result = _blosc_getitem(context, src, start, nitems, dest);
-
-  return result;
+int64_t blosc2_getitem_ctx64(blosc_context* context, const void* src,
+                             int64_t start, int64_t nitems, void* dest) {
+  return _blosc_getitem(context, src, start, nitems, dest);
 }
 
+/* Make room for (at least) `npieces` pieces for gathers */
+static int get_gather_pieces(blosc_context* context, int64_t npieces) {
+  struct blosc_gather_piece* pieces;
+  int32_t* groups;
 
-/* Decompress & unshuffle several blocks in a single thread */
-static void* t_blosc(void* ctxt) {
-  struct thread_context* context = (struct thread_context*)ctxt;
-  int32_t cbytes, ntdest;
-  int32_t tblocks;              /* number of blocks per thread */
-  int32_t leftover2;
-  int32_t tblock;               /* limit block on a thread */
-  int32_t nblock_;              /* private copy of nblock */
-  int32_t bsize, leftoverblock;
-  /* Parameters for threads */
-  int32_t blocksize;
-  int32_t ebsize;
-  int32_t compress;
-  int32_t maxbytes;
-  int32_t ntbytes;
-  int32_t flags;
-  int32_t nblocks;
-  int32_t leftover;
-  uint8_t* bstarts;
-  const uint8_t* src;
-  uint8_t* dest;
-  uint8_t* tmp;
-  uint8_t* tmp2;
-  uint8_t* tmp3;
-  int rc;
+  if (npieces <= context->gather_maxpieces) {
+    return 0;
+  }
+  if (npieces >= INT32_MAX) {
+    fprintf(stderr, "Too many pieces to gather\n");
+    return -1;
+  }
+  pieces = (struct blosc_gather_piece*)my_malloc(
+      &context->allocator, npieces * sizeof(struct blosc_gather_piece));
+  groups = (int32_t*)my_malloc(&context->allocator,
+                               (npieces + 1) * sizeof(int32_t));
+  if (pieces == NULL || groups == NULL) {
+    my_free(&context->allocator, pieces);
+    my_free(&context->allocator, groups);
+    return -1;
+  }
+  my_free(&context->allocator, context->gather_pieces);
+  my_free(&context->allocator, context->gather_groups);
+  context->gather_pieces = pieces;
+  context->gather_groups = groups;
+  context->gather_maxpieces = (int32_t)npieces;
 
-  while (1) {
-    /* Synchronization point for all threads (wait for initialization) */
-    WAIT_INIT(NULL, context->parent_context);
+  return 0;
+}
 
-    if (context->parent_context->end_threads) {
-      break;
-    }
+/* Order gather pieces by block, and by position inside the block */
+static int compare_pieces(const void* a, const void* b) {
+  const struct blosc_gather_piece* pa = (const struct blosc_gather_piece*)a;
+  const struct blosc_gather_piece* pb = (const struct blosc_gather_piece*)b;
 
-    /* Get parameters for this thread before entering the main loop */
-    blocksize = context->parent_context->blocksize;
-    ebsize = blocksize + context->parent_context->typesize * (int32_t)sizeof(int32_t);
-    compress = context->parent_context->compress;
-    flags = *(context->parent_context->header_flags);
-    maxbytes = context->parent_context->destsize;
-    nblocks = context->parent_context->nblocks;
-    leftover = context->parent_context->leftover;
-    bstarts = context->parent_context->bstarts;
-    src = context->parent_context->src;
-    dest = context->parent_context->dest;
+  if (pa->nblock != pb->nblock) {
+    return (pa->nblock < pb->nblock) ? -1 : 1;
+  }
+  if (pa->start != pb->start) {
+    return (pa->start < pb->start) ? -1 : 1;
+  }
+  return 0;
+}
 
-    /* Resize the temporaries if needed */
-    if (blocksize != context->tmpblocksize) {
-      my_free(context->tmp);
-      context->tmp = my_malloc(blocksize + ebsize + blocksize);
-      context->tmp2 = context->tmp + blocksize;
-      context->tmp3 = context->tmp + blocksize + ebsize;
-      context->tmpblocksize = blocksize;
+int blosc2_getitems_ctx(blosc_context* context, const void* src,
+                        const int* starts, const int* nitems, int n,
+                        void* dest) {
+  struct blosc_gather_piece* pieces;
+  struct thread_context* scontext;
+  int64_t startb, stopb, bstop, doffset;
+  int64_t npieces = 0;
+  int64_t ntbytes = 0;
+  int32_t blocksize, ngroups, cbytes;
+  int32_t i, j;
+
+  if (n <= 0) {
+    return 0;
+  }
+  initialize_context_items(context, src, dest);
+  blocksize = context->blocksize;
+
+  /* Check the ranges and count their pieces */
+  for (i = 0; i < n; i++) {
+    startb = (int64_t)starts[i] * context->typesize;
+    stopb = startb + (int64_t)nitems[i] * context->typesize;
+    if (starts[i] < 0 || nitems[i] < 0 || stopb > context->sourcesize) {
+      fprintf(stderr, "range %d of items out of bounds\n", i);
+      return -1;
     }
+    if (stopb > startb) {
+      npieces += (stopb - 1) / blocksize - startb / blocksize + 1;
+    }
+    ntbytes += stopb - startb;
+  }
+  if (ntbytes > INT_MAX) {
+    fprintf(stderr, "Cannot gather more than %d bytes\n", INT_MAX);
+    return -1;
+  }
+  if (npieces == 0) {
+    return 0;
+  }
+  if (get_gather_pieces(context, npieces) < 0) {
+    return -1;
+  }
 
-    tmp = context->tmp;
-    tmp2 = context->tmp2;
-    tmp3 = context->tmp3;
+  /* Split the ranges in pieces of a single block */
+  pieces = context->gather_pieces;
+  doffset = 0;
+  for (i = 0, j = 0; i < n; i++) {
+    startb = (int64_t)starts[i] * context->typesize;
+    stopb = startb + (int64_t)nitems[i] * context->typesize;
+    while (startb < stopb) {
+      pieces[j].nblock = (int32_t)(startb / blocksize);
+      bstop = (int64_t)(pieces[j].nblock + 1) * blocksize;
+      if (bstop > stopb) {
+        bstop = stopb;
+      }
+      pieces[j].start = (int32_t)(startb - (int64_t)pieces[j].nblock * blocksize);
+      pieces[j].nbytes = (int32_t)(bstop - startb);
+      pieces[j].doffset = doffset;
+      doffset += bstop - startb;
+      startb = bstop;
+      j++;
+    }
+  }
 
-    ntbytes = 0;                /* only useful for decompression */
+  /* Group the pieces by block, so that every block is decompressed once */
+  qsort(pieces, (size_t)npieces, sizeof(struct blosc_gather_piece),
+        compare_pieces);
+  ngroups = 0;
+  for (j = 0; j < npieces; j++) {
+    if (j == 0 || pieces[j].nblock != pieces[j - 1].nblock) {
+      context->gather_groups[ngroups++] = j;
+    }
+  }
+  context->gather_groups[ngroups] = (int32_t)npieces;
+  context->gather_npieces = (int32_t)npieces;
+  context->num_output_bytes = 0;
+  context->block_start = 0;
+  context->block_stop = ngroups;
 
-    if (compress && !(flags & BLOSC_MEMCPYED)) {
-      /* Compression always has to follow the block order */
-      pthread_mutex_lock(&context->parent_context->count_mutex);
-      context->parent_context->thread_nblock++;
-      nblock_ = context->parent_context->thread_nblock;
-      pthread_mutex_unlock(&context->parent_context->count_mutex);
-      tblock = nblocks;
+  if (!context->compress && context->nthreads > 1 && ngroups > 1) {
+    if (context->threadpool == NULL && blosc_set_nthreads_(context) < 0) {
+      ntbytes = -1;
     }
     else {
-      /* Decompression can happen using any order.  We choose
-       sequential block order on each thread */
-
-      /* Blocks per thread */
-      tblocks = nblocks / context->parent_context->nthreads;
-      leftover2 = nblocks % context->parent_context->nthreads;
-      tblocks = (leftover2 > 0) ? tblocks + 1 : tblocks;
-
-      nblock_ = context->tid * tblocks;
-      tblock = nblock_ + tblocks;
-      if (tblock > nblocks) {
-        tblock = nblocks;
-      }
+      ntbytes = pool_blosc(context);
     }
-
-    /* Loop over blocks */
-    leftoverblock = 0;
-    while ((nblock_ < tblock) && context->parent_context->thread_giveup_code > 0) {
-      bsize = blocksize;
-      if (nblock_ == (nblocks - 1) && (leftover > 0)) {
-        bsize = leftover;
-        leftoverblock = 1;
-      }
-      if (compress) {
-        if (flags & BLOSC_MEMCPYED) {
-          /* We want to memcpy only */
-          memcpy(dest + BLOSC_MAX_OVERHEAD + nblock_ * blocksize,
-                 src + nblock_ * blocksize, bsize);
-          cbytes = bsize;
-        }
-        else {
-          /* Regular compression */
-          cbytes = blosc_c(context, bsize, leftoverblock, 0,
-                           ebsize, src, nblock_ * blocksize, tmp2, tmp, tmp3);
-        }
-      }
-      else {
-        if (flags & BLOSC_MEMCPYED) {
-          /* We want to memcpy only */
-          memcpy(dest + nblock_ * blocksize,
-                 src + BLOSC_MAX_OVERHEAD + nblock_ * blocksize, bsize);
-          cbytes = bsize;
-        }
-        else {
-          cbytes = blosc_d(context, bsize, leftoverblock,
-                           src + sw32_(bstarts + nblock_ * 4),
-                           dest, nblock_ * blocksize,
-                           tmp, tmp2);
-        }
-      }
-
-      /* Check whether current thread has to giveup */
-      if (context->parent_context->thread_giveup_code <= 0) {
-        break;
-      }
-
-      /* Check results for the compressed/decompressed block */
-      if (cbytes < 0) {            /* compr/decompr failure */
-        /* Set giveup_code error */
-        pthread_mutex_lock(&context->parent_context->count_mutex);
-        context->parent_context->thread_giveup_code = cbytes;
-        pthread_mutex_unlock(&context->parent_context->count_mutex);
+  }
+  else {
+    /* Serial version */
+    if (context->serial_context == NULL) {
+      context->serial_context = create_thread_context(context, &context->allocator, 0);
+    }
+    scontext = context->serial_context;
+    scontext->parent_context = context;
+    resize_temporaries(scontext, blocksize, context->typesize);
+    ntbytes = 0;
+    for (j = 0; j < ngroups; j++) {
+      cbytes = gather_block(scontext, j);
+      if (cbytes < 0) {
+        ntbytes = cbytes;
         break;
       }
-
-      if (compress && !(flags & BLOSC_MEMCPYED)) {
-        /* Start critical section */
-        pthread_mutex_lock(&context->parent_context->count_mutex);
-        ntdest = context->parent_context->num_output_bytes;
-        _sw32(bstarts + nblock_ * 4, ntdest); /* update block start counter */
-        if ((cbytes == 0) || (ntdest + cbytes > maxbytes)) {
-          context->parent_context->thread_giveup_code = 0;  /* uncompressible buffer */
-          pthread_mutex_unlock(&context->parent_context->count_mutex);
-          break;
-        }
-        context->parent_context->thread_nblock++;
-        nblock_ = context->parent_context->thread_nblock;
-        context->parent_context->num_output_bytes += cbytes;           /* update return bytes counter */
-        pthread_mutex_unlock(&context->parent_context->count_mutex);
-        /* End of critical section */
-
-        /* Copy the compressed buffer to destination */
-        memcpy(dest + ntdest, tmp2, cbytes);
-      }
-      else {
-        nblock_++;
-        /* Update counter for this thread */
-        ntbytes += cbytes;
-      }
-
-    } /* closes while (nblock_) */
-
-    /* Sum up all the bytes decompressed */
-    if ((!compress || (flags & BLOSC_MEMCPYED)) && context->parent_context->thread_giveup_code > 0) {
-      /* Update global counter for all threads (decompression only) */
-      pthread_mutex_lock(&context->parent_context->count_mutex);
-      context->parent_context->num_output_bytes += ntbytes;
-      pthread_mutex_unlock(&context->parent_context->count_mutex);
+      ntbytes += cbytes;
     }
-
-    /* Meeting point for all threads (wait for finalization) */
-    WAIT_FINISH(NULL, context->parent_context);
   }
 
-  /* Cleanup our working space and context */
-  free_thread_context(context);
-
-  return (NULL);
+  context->gather_npieces = 0;
+  return (int)ntbytes;
 }
 
-static int init_threads(blosc_context* context) {
-  int32_t tid;
-  int rc2;
-  struct thread_context* thread_context;
+int blosc2_get_blocksize_info(blosc_context* context, size_t nbytes,
+                              blosc2_blocksize_info* info) {
+  int32_t typesize = context->typesize;
 
-  /* Initialize mutex and condition variable objects */
-  pthread_mutex_init(&context->count_mutex, NULL);
+  if (!context->compress) {
+    fprintf(stderr, "Context is not meant for compression\n");
+    return -1;
+  }
+  if (typesize > BLOSC_MAX_TYPESIZE) {
+    typesize = 1;
+  }
+  info->blocksize = compute_blocksize(context, context->clevel, typesize,
+                                      (int64_t)nbytes, context->forced_blocksize);
+  info->l1_size = get_l1_size();
+  info->l2_size = g_cache_sizes[1];
+  info->l3_size = g_cache_sizes[2];
+  info->nblocks_in_use = working_set_nblocks(context->filtercode);
+  return info->blocksize;
+}
 
-  /* Set context thread sentinels */
-  context->thread_giveup_code = 1;
-  context->thread_nblock = -1;
 
-  /* Barrier initialization */
-#ifdef _POSIX_BARRIERS_MINE
-  pthread_barrier_init(&context->barr_init, NULL, context->nthreads + 1);
-  pthread_barrier_init(&context->barr_finish, NULL, context->nthreads + 1);
+/* Compress or decompress the blocks of the job in the parent context of
+   `thread_context` until there are no pending ones left.
+
+   Blocks are handed out dynamically through an atomic counter, so a thread
+   that finishes its block early just grabs the next pending one instead of
+   waiting for a statically assigned range to be completed by others.  This
+   keeps the tail latency even for buffers with mixed-entropy blocks. */
+static void process_blocks(struct thread_context* thread_context) {
+  blosc_context* parent = thread_context->parent_context;
+  int32_t cbytes;
+  int64_t ntdest, offset;
+  int32_t nblock_;              /* block being processed by this thread */
+  int32_t bsize, leftoverblock;
+  int32_t blocksize = parent->blocksize;
+  int32_t ebsize = blocksize + parent->typesize * (int32_t)sizeof(int32_t);
+  int32_t compress = parent->compress;
+  int32_t flags = *(parent->header_flags);
+  int32_t header_len = parent->header_len;
+  int extended = parent->extended;
+  int64_t maxbytes = parent->destsize;
+  int32_t nblocks = parent->nblocks;
+  int32_t leftover = parent->leftover;
+  uint8_t* bstarts = parent->bstarts;
+  const uint8_t* src = parent->src;
+  uint8_t* dest = parent->dest;
+  uint8_t* tmp = thread_context->tmp;
+  uint8_t* tmp2 = thread_context->tmp2;
+  uint8_t* tmp3 = thread_context->tmp3;
+  int64_t ntbytes = 0;          /* bytes processed by this thread */
+
+  while (BLOSC_ATOMIC_LOAD32(&parent->thread_giveup_code) > 0) {
+    /* Grab the next pending block */
+    nblock_ = BLOSC_ATOMIC_ADD32(&parent->thread_nblock, 1);
+    if (nblock_ >= parent->block_stop) {
+      break;
+    }
+    bsize = blocksize;
+    leftoverblock = 0;
+    if (nblock_ == (nblocks - 1) && (leftover > 0)) {
+      bsize = leftover;
+      leftoverblock = 1;
+    }
+    offset = (int64_t)nblock_ * blocksize;
+    if (compress) {
+      if (flags & BLOSC_MEMCPYED) {
+        /* We want to memcpy only */
+        memcpy(dest + header_len + offset, src + offset, bsize);
+        cbytes = bsize;
+      }
+      else {
+        /* Regular compression */
+        cbytes = blosc_c(thread_context, bsize, leftoverblock, 0,
+                         ebsize, src + offset, offset, tmp2, tmp, tmp3);
+      }
+    }
+    else if (parent->gather_npieces > 0) {
+      cbytes = gather_block(thread_context, nblock_);
+    }
+    else {
+      cbytes = decompress_block(thread_context, nblock_);
+    }
+
+    /* Check results for the compressed/decompressed block */
+    if (cbytes < 0) {            /* compr/decompr failure */
+      /* Set giveup_code error */
+      BLOSC_ATOMIC_STORE32(&parent->thread_giveup_code, cbytes);
+      break;
+    }
+
+    if (compress && !(flags & BLOSC_MEMCPYED)) {
+      /* Reserve room in the output buffer without blocking other
+         threads.  If the reservation overflows `maxbytes` the buffer
+         is uncompressible and the whole job gives up. */
+      if (cbytes == 0) {
+        BLOSC_ATOMIC_STORE32(&parent->thread_giveup_code, 0);
+        break;
+      }
+      ntdest = BLOSC_ATOMIC_ADD64(&parent->num_output_bytes, cbytes);
+      if (ntdest + cbytes > maxbytes) {
+        BLOSC_ATOMIC_STORE32(&parent->thread_giveup_code, 0);
+        break;
+      }
+
+      /* Copy the compressed buffer to its slot and then publish its
+         start.  Each block owns its own bstarts entry, so no ordering
+         among threads is needed until the finalization barrier. */
+      memcpy(dest + ntdest, tmp2, cbytes);
+      set_bstart(bstarts, extended, nblock_, ntdest);
+    }
+    else {
+      /* Update counter for this thread */
+      ntbytes += cbytes;
+    }
+
+  } /* closes while (giveup_code) */
+
+  /* Sum up all the bytes decompressed */
+  if ((!compress || (flags & BLOSC_MEMCPYED)) &&
+      BLOSC_ATOMIC_LOAD32(&parent->thread_giveup_code) > 0) {
+    /* Update global counter for all threads (decompression only) */
+    BLOSC_ATOMIC_ADD64(&parent->num_output_bytes, ntbytes);
+  }
+}
+
+/* Whether all the blocks of a context have been handed out already */
+static int context_exhausted(blosc_context* context) {
+  return (BLOSC_ATOMIC_LOAD32(&context->thread_giveup_code) <= 0 ||
+          BLOSC_ATOMIC_LOAD32(&context->thread_nblock) >= context->block_stop);
+}
+
+/* Whether all the blocks of a job have been handed out already */
+static int job_exhausted(struct blosc_job* job) {
+  int32_t i;
+
+  if (job->async != NULL) {
+    /* Asynchronous calls are dequeued as soon as a worker takes them */
+    return 0;
+  }
+  for (i = BLOSC_ATOMIC_LOAD32(&job->ncontext); i < job->ncontexts; i++) {
+    if (!context_exhausted(job->contexts[i])) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Work on the blocks of all the buffers of a job until they are all
+   handed out */
+static void process_job(struct blosc_job* job,
+                        struct thread_context* thread_context) {
+  blosc_context* context;
+  int32_t i;
+
+  for (i = BLOSC_ATOMIC_LOAD32(&job->ncontext); i < job->ncontexts; i++) {
+    context = job->contexts[i];
+    if (context_exhausted(context)) {
+      continue;
+    }
+    thread_context->parent_context = context;
+    resize_temporaries(thread_context, context->blocksize, context->typesize);
+    process_blocks(thread_context);
+    /* Let the other threads skip this buffer (this is just a hint) */
+    if (BLOSC_ATOMIC_LOAD32(&job->ncontext) <= i) {
+      BLOSC_ATOMIC_STORE32(&job->ncontext, i + 1);
+    }
+  }
+}
+
+/* Remove a job from the queue of a pool.  Must be called with the pool
+   mutex held. */
+static void dequeue_job(blosc2_threadpool* pool, struct blosc_job* job) {
+  struct blosc_job* prev = NULL;
+  struct blosc_job* cur = pool->first_job;
+
+  while (cur != NULL && cur != job) {
+    prev = cur;
+    cur = cur->next;
+  }
+  if (cur == NULL) {
+    return;     /* not queued (anymore) */
+  }
+  if (prev == NULL) {
+    pool->first_job = job->next;
+  }
+  else {
+    prev->next = job->next;
+  }
+  if (pool->last_job == job) {
+    pool->last_job = prev;
+  }
+  job->next = NULL;
+}
+
+/* Append a job to the queue of a pool.  Must be called with the pool
+   mutex held. */
+static void queue_job_tail(blosc2_threadpool* pool, struct blosc_job* job) {
+  if (pool->last_job == NULL) {
+    pool->first_job = job;
+  }
+  else {
+    pool->last_job->next = job;
+  }
+  pool->last_job = job;
+}
+
+/* Queue a new job in a pool, waking up the parked workers if any */
+static void submit_job(blosc2_threadpool* pool, struct blosc_job* job) {
+  pthread_mutex_lock(&pool->mutex);
+  queue_job_tail(pool, job);
+  BLOSC_ATOMIC_ADD32(&pool->generation, 1);
+  if (pool->nsleeping > 0) {
+    pthread_cond_broadcast(&pool->work_cv);
+  }
+  pthread_mutex_unlock(&pool->mutex);
+}
+
+/* Run an asynchronous call and signal its completion */
+static void run_async(blosc2_async* handle) {
+  int result;
+
+  if (handle->compress) {
+    result = blosc2_compress_ctx(handle->context, handle->nbytes, handle->src,
+                                 handle->dest, handle->destsize);
+  }
+  else {
+    result = blosc2_decompress_ctx(handle->context, handle->src,
+                                   handle->dest, handle->destsize);
+  }
+  handle->result = result;
+  if (handle->callback != NULL) {
+    handle->callback(handle, result, handle->callback_data);
+  }
+
+  /* The waiter may free the handle as soon as the mutex is released */
+  pthread_mutex_lock(&handle->mutex);
+  BLOSC_ATOMIC_STORE32(&handle->done, 1);
+  pthread_cond_broadcast(&handle->done_cv);
+  pthread_mutex_unlock(&handle->mutex);
+}
+
+/* Pick the next job that a worker should attach to.  Exhausted jobs are
+   dropped from the queue, and the chosen one is moved to the tail so
+   that idle workers are spread evenly among concurrent jobs.  Must be
+   called with the pool mutex held. */
+static struct blosc_job* next_job(blosc2_threadpool* pool) {
+  struct blosc_job* job = pool->first_job;
+  struct blosc_job* next;
+
+  while (job != NULL) {
+    next = job->next;
+    if (job_exhausted(job)) {
+      dequeue_job(pool, job);
+    }
+    else if (BLOSC_ATOMIC_LOAD32(&job->nworkers) < job->maxworkers) {
+      BLOSC_ATOMIC_ADD32(&job->nworkers, 1);
+      dequeue_job(pool, job);
+      if (job->async == NULL) {
+        queue_job_tail(pool, job);
+      }
+      return job;
+    }
+    job = next;
+  }
+  return NULL;
+}
+
+/* Pin the calling thread to a CPU.  Only supported on Linux. */
+static void pin_thread(int cpu) {
+#if defined(__linux__)
+  cpu_set_t cpuset;
+  int rc;
+
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  rc = pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset);
+  if (rc) {
+    fprintf(stderr, "Warning: cannot pin thread to CPU %d: %s\n",
+            cpu, strerror(rc));
+  }
 #else
-  pthread_mutex_init(&context->count_threads_mutex, NULL);
-  pthread_cond_init(&context->count_threads_cv, NULL);
-  context->count_threads = 0;      /* Reset threads counter */
+  (void)cpu;
 #endif
+}
 
-#if !defined(_WIN32)
-  /* Initialize and set thread detached attribute */
-  pthread_attr_init(&context->ct_attr);
-  pthread_attr_setdetachstate(&context->ct_attr, PTHREAD_CREATE_JOINABLE);
-#endif
+/* Worker thread in a pool */
+static void* t_pool(void* ctxt) {
+  struct thread_context* thread_context = (struct thread_context*)ctxt;
+  blosc2_threadpool* pool = thread_context->threadpool;
+  struct blosc_job* job;
+  int32_t generation;
+  int i;
 
-  /* Make space for thread handlers */
-  context->threads = (pthread_t*)my_malloc(context->nthreads * sizeof(pthread_t));
-  /* Finally, create the threads */
-  for (tid = 0; tid < context->nthreads; tid++) {
-    /* Create a thread context thread owns context (will destroy when finished) */
-    thread_context = create_thread_context(context, tid);
+  if (pool->ncpus > 0) {
+    pin_thread(pool->cpus[thread_context->tid % pool->ncpus]);
+  }
 
-#if !defined(_WIN32)
-    rc2 = pthread_create(&context->threads[tid], &context->ct_attr, t_blosc, (void*)thread_context);
+  pthread_mutex_lock(&pool->mutex);
+  while (1) {
+    job = next_job(pool);
+    if (job == NULL) {
+      if (pool->end_threads) {
+        break;
+      }
+      /* Spin for a while before parking, because jobs for small buffers
+         tend to come in quick succession and waking up a parked thread
+         is expensive compared with (de-)compressing them */
+      generation = pool->generation;
+      pthread_mutex_unlock(&pool->mutex);
+      for (i = 0; i < SPIN_COUNT; i++) {
+        if (BLOSC_ATOMIC_LOAD32(&pool->generation) != generation) {
+          break;
+        }
+        BLOSC_CPU_RELAX();
+      }
+      pthread_mutex_lock(&pool->mutex);
+      if (pool->generation == generation && !pool->end_threads) {
+        pool->nsleeping++;
+        pthread_cond_wait(&pool->work_cv, &pool->mutex);
+        pool->nsleeping--;
+      }
+      continue;
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    if (job->async != NULL) {
+      /* A whole call.  Its blocks go to the pool as a job of its own. */
+      run_async(job->async);
+      pthread_mutex_lock(&pool->mutex);
+      continue;
+    }
+
+    /* Work on the blocks of the job */
+    process_job(job, thread_context);
+
+    /* Detach from the job.  The submitter may return as soon as the
+       counter drops to zero, so `job` cannot be used after this. */
+    if (BLOSC_ATOMIC_ADD32(&job->nworkers, -1) == 1) {
+      pthread_mutex_lock(&pool->mutex);
+      pthread_cond_broadcast(&pool->done_cv);
+    }
+    else {
+      pthread_mutex_lock(&pool->mutex);
+    }
+  }
+  pthread_mutex_unlock(&pool->mutex);
+
+  /* Cleanup our working space and context */
+  free_thread_context(thread_context);
+
+  return (NULL);
+}
+
+/* Run the blocks of all the `contexts` as a single job in the pool of
+   threads of `context` (the shared one if the context is attached to it,
+   else the private one).  The calling thread works on the job too, so it
+   always makes progress, even if all the workers in the pool are busy
+   with other jobs.
+
+   Finishing a job does not require any barrier: the caller just waits for
+   the counter of attached workers to drop to zero, spinning for a while
+   before parking. */
+static void run_job(blosc_context* context, blosc_context** contexts,
+                    int32_t ncontexts) {
+  blosc2_threadpool* pool = context->threadpool;
+  struct blosc_job job;
+  int i;
+
+  if (pool == NULL) {
+    pool = context->private_threadpool;
+  }
+
+  /* Set sentinels */
+  for (i = 0; i < ncontexts; i++) {
+    contexts[i]->thread_giveup_code = 1;
+    contexts[i]->thread_nblock = contexts[i]->block_start;
+  }
+
+  /* Queue the job */
+  job.context = context;
+  job.contexts = contexts;
+  job.ncontexts = ncontexts;
+  job.ncontext = 0;
+  job.async = NULL;
+  job.nworkers = 0;
+  job.maxworkers = context->nthreads - 1;
+  job.next = NULL;
+  if (pool != NULL) {
+    submit_job(pool, &job);
+  }
+
+  /* Work on the job from this thread too */
+  if (context->serial_context == NULL) {
+    context->serial_context = create_thread_context(NULL, &context->allocator, 0);
+  }
+  process_job(&job, context->serial_context);
+
+  if (pool != NULL) {
+    /* No more workers can attach to the job from now on */
+    pthread_mutex_lock(&pool->mutex);
+    dequeue_job(pool, &job);
+    pthread_mutex_unlock(&pool->mutex);
+
+    /* Wait for the attached workers to finish */
+    for (i = 0; i < SPIN_COUNT; i++) {
+      if (BLOSC_ATOMIC_LOAD32(&job.nworkers) == 0) {
+        break;
+      }
+      BLOSC_CPU_RELAX();
+    }
+    if (BLOSC_ATOMIC_LOAD32(&job.nworkers) > 0) {
+      pthread_mutex_lock(&pool->mutex);
+      while (BLOSC_ATOMIC_LOAD32(&job.nworkers) > 0) {
+        pthread_cond_wait(&pool->done_cv, &pool->mutex);
+      }
+      pthread_mutex_unlock(&pool->mutex);
+    }
+  }
+}
+
+/* Run the job in context using a pool of threads */
+static int64_t pool_blosc(blosc_context* context) {
+  run_job(context, &context, 1);
+
+  if (context->thread_giveup_code > 0) {
+    /* Return the total bytes (de-)compressed in threads */
+    return context->num_output_bytes;
+  }
+  else {
+    /* Compression/decompression gave up.  Return error code. */
+    return context->thread_giveup_code;
+  }
+}
+
+/* Create a pool of threads (to be shared among contexts or not) */
+static blosc2_threadpool* create_threadpool(
+    int nthreads, const int* cpus, int ncpus,
+    const blosc2_allocator* allocator) {
+  blosc2_threadpool* pool;
+  struct thread_context* thread_context;
+  int32_t tid;
+  int rc2;
+
+  if (nthreads <= 0) {
+    fprintf(stderr, "Error.  nthreads must be a positive integer");
+    return NULL;
+  }
+
+  pool = (blosc2_threadpool*)my_malloc(allocator, sizeof(blosc2_threadpool));
+  pool->allocator = *allocator;
+  pool->cpus = NULL;
+  pool->ncpus = 0;
+  if (ncpus > 0) {
+    pool->cpus = (int*)my_malloc(allocator, ncpus * sizeof(int));
+    memcpy(pool->cpus, cpus, ncpus * sizeof(int));
+    pool->ncpus = ncpus;
+  }
+  pool->nthreads = 0;
+  pool->first_job = NULL;
+  pool->last_job = NULL;
+  pool->generation = 0;
+  pool->nsleeping = 0;
+  pool->end_threads = 0;
+  pthread_mutex_init(&pool->mutex, NULL);
+  pthread_cond_init(&pool->work_cv, NULL);
+  pthread_cond_init(&pool->done_cv, NULL);
+
+  /* Make space for thread handlers and create the threads */
+  pool->threads = (pthread_t*)my_malloc(&pool->allocator, nthreads * sizeof(pthread_t));
+  for (tid = 0; tid < nthreads; tid++) {
+    /* The thread owns its context (will destroy it when finished) */
+    thread_context = create_thread_context(NULL, &pool->allocator, tid);
+    thread_context->threadpool = pool;
+    rc2 = pthread_create(&pool->threads[tid], NULL, t_pool, (void*)thread_context);
+    if (rc2) {
+      fprintf(stderr, "ERROR; return code from pthread_create() is %d\n", rc2);
+      fprintf(stderr, "\tError detail: %s\n", strerror(rc2));
+      free_thread_context(thread_context);
+      blosc2_free_threadpool(pool);
+      return NULL;
+    }
+    pool->nthreads++;
+  }
+
+  return pool;
+}
+
+blosc2_threadpool* blosc2_create_threadpool(int nthreads) {
+  return create_threadpool(nthreads, NULL, 0, &g_allocator);
+}
+
+blosc2_threadpool* blosc2_create_threadpool_pinned(int nthreads,
+                                                   const int* cpus,
+                                                   int ncpus) {
+  int i;
+
+  if (cpus == NULL || ncpus <= 0) {
+    fprintf(stderr, "Error.  At least one CPU must be passed\n");
+    return NULL;
+  }
+  /* The CPUs go to CPU_SET() in the workers, which does not check them */
+  for (i = 0; i < ncpus; i++) {
+#if defined(__linux__)
+    if (cpus[i] < 0 || cpus[i] >= CPU_SETSIZE) {
 #else
-    rc2 = pthread_create(&context->threads[tid], NULL, t_blosc, (void *)thread_context);
+    if (cpus[i] < 0) {
 #endif
+      fprintf(stderr, "Error.  Invalid CPU: %d\n", cpus[i]);
+      return NULL;
+    }
+  }
+  return create_threadpool(nthreads, cpus, ncpus, &g_allocator);
+}
+
+/* Stop the threads of a shared pool and release its resources */
+void blosc2_free_threadpool(blosc2_threadpool* pool) {
+  blosc2_allocator allocator;
+  int32_t t;
+  void* status;
+  int rc2;
+
+  /* Tell all existing threads to finish */
+  pthread_mutex_lock(&pool->mutex);
+  pool->end_threads = 1;
+  pthread_cond_broadcast(&pool->work_cv);
+  pthread_mutex_unlock(&pool->mutex);
+
+  /* Join exiting threads */
+  for (t = 0; t < pool->nthreads; t++) {
+    rc2 = pthread_join(pool->threads[t], &status);
     if (rc2) {
-      fprintf(stderr, "ERROR; return code from pthread_create() is %d\n", rc2);
+      fprintf(stderr, "ERROR; return code from pthread_join() is %d\n", rc2);
       fprintf(stderr, "\tError detail: %s\n", strerror(rc2));
-      return (-1);
     }
   }
 
-  return (0);
+  pthread_mutex_destroy(&pool->mutex);
+  pthread_cond_destroy(&pool->work_cv);
+  pthread_cond_destroy(&pool->done_cv);
+  allocator = pool->allocator;
+  my_free(&allocator, pool->cpus);
+  my_free(&allocator, pool->threads);
+  my_free(&allocator, pool);
+}
+
+/* Initialize the mutex of the shared pools, only once */
+static void init_shared_pools(void) {
+  if (BLOSC_ATOMIC_LOAD32(&g_shared_pools_ready)) {
+    return;
+  }
+  if (BLOSC_ATOMIC_ADD32(&g_shared_pools_claimed, 1) == 0) {
+    pthread_mutex_init(&g_shared_pools_mutex, NULL);
+    BLOSC_ATOMIC_STORE32(&g_shared_pools_ready, 1);
+    return;
+  }
+  while (!BLOSC_ATOMIC_LOAD32(&g_shared_pools_ready)) {
+    BLOSC_CPU_RELAX();
+  }
+}
+
+blosc2_threadpool* blosc_acquire_shared_pool(int nthreads) {
+  blosc2_threadpool* pool;
+
+  if (nthreads <= 1 || nthreads >= MAX_SHARED_POOLS) {
+    return NULL;
+  }
+  init_shared_pools();
+  pthread_mutex_lock(&g_shared_pools_mutex);
+  pool = g_shared_pools[nthreads];
+  if (pool == NULL) {
+    pool = create_threadpool(nthreads, NULL, 0, &g_allocator);
+    g_shared_pools[nthreads] = pool;
+  }
+  if (pool != NULL) {
+    g_shared_pool_refs[nthreads]++;
+  }
+  pthread_mutex_unlock(&g_shared_pools_mutex);
+  return pool;
+}
+
+void blosc_release_shared_pool(blosc2_threadpool* pool) {
+  int32_t nthreads = pool->nthreads;
+
+  pthread_mutex_lock(&g_shared_pools_mutex);
+  if (--g_shared_pool_refs[nthreads] > 0) {
+    pool = NULL;
+  }
+  else {
+    g_shared_pools[nthreads] = NULL;
+  }
+  pthread_mutex_unlock(&g_shared_pools_mutex);
+  /* The last user stops the threads (out of the lock) */
+  if (pool != NULL) {
+    blosc2_free_threadpool(pool);
+  }
+}
+
+#if defined(BLOSC_TESTING)
+int32_t blosc_get_nshared_pools(void) {
+  int32_t npools = 0;
+  int i;
+
+  init_shared_pools();
+  pthread_mutex_lock(&g_shared_pools_mutex);
+  for (i = 0; i < MAX_SHARED_POOLS; i++) {
+    npools += (g_shared_pools[i] != NULL);
+  }
+  pthread_mutex_unlock(&g_shared_pools_mutex);
+  return npools;
+}
+#endif  /* defined(BLOSC_TESTING) */
+
+/* Queue a whole call for running in the pool of the context */
+static blosc2_async* async_ctx(
+    blosc_context* context, int compress, size_t nbytes, const void* src,
+    void* dest, size_t destsize, blosc2_async_cb callback,
+    void* callback_data) {
+  blosc2_threadpool* pool = context->threadpool;
+  blosc2_async* handle;
+
+  if (pool == NULL) {
+    if (blosc_set_nthreads_(context) < 0) {
+      return NULL;
+    }
+    if (context->private_threadpool == NULL) {
+      /* Serial contexts still need a worker for running the call */
+      context->private_threadpool = create_threadpool(1, NULL, 0, &context->allocator);
+      if (context->private_threadpool == NULL) {
+        return NULL;
+      }
+    }
+    pool = context->private_threadpool;
+  }
+
+  handle = (blosc2_async*)my_malloc(&context->allocator, sizeof(blosc2_async));
+  if (handle == NULL) {
+    return NULL;
+  }
+  handle->job.context = context;
+  handle->job.contexts = NULL;
+  handle->job.ncontexts = 0;
+  handle->job.ncontext = 0;
+  handle->job.async = handle;
+  handle->job.nworkers = 0;
+  handle->job.maxworkers = 1;
+  handle->job.next = NULL;
+  handle->context = context;
+  handle->compress = compress;
+  handle->nbytes = nbytes;
+  handle->src = src;
+  handle->dest = dest;
+  handle->destsize = destsize;
+  handle->result = 0;
+  handle->callback = callback;
+  handle->callback_data = callback_data;
+  handle->done = 0;
+  pthread_mutex_init(&handle->mutex, NULL);
+  pthread_cond_init(&handle->done_cv, NULL);
+
+  submit_job(pool, &handle->job);
+
+  return handle;
+}
+
+blosc2_async* blosc2_compress_ctx_async(
+    blosc_context* context, size_t nbytes, const void* src, void* dest,
+    size_t destsize, blosc2_async_cb callback, void* callback_data) {
+  if (context->compress != 1) {
+    fprintf(stderr, "Context is not meant for compression.  Giving up.\n");
+    return NULL;
+  }
+  return async_ctx(context, 1, nbytes, src, dest, destsize,
+                   callback, callback_data);
+}
+
+blosc2_async* blosc2_decompress_ctx_async(
+    blosc_context* context, const void* src, void* dest, size_t destsize,
+    blosc2_async_cb callback, void* callback_data) {
+  if (context->compress != 0) {
+    fprintf(stderr, "Context is not meant for decompression.  Giving up.\n");
+    return NULL;
+  }
+  return async_ctx(context, 0, 0, src, dest, destsize,
+                   callback, callback_data);
+}
+
+int blosc2_async_poll(blosc2_async* handle) {
+  return BLOSC_ATOMIC_LOAD32(&handle->done);
+}
+
+int blosc2_async_wait(blosc2_async* handle) {
+  int result;
+
+  if (!BLOSC_ATOMIC_LOAD32(&handle->done)) {
+    pthread_mutex_lock(&handle->mutex);
+    while (!BLOSC_ATOMIC_LOAD32(&handle->done)) {
+      pthread_cond_wait(&handle->done_cv, &handle->mutex);
+    }
+    pthread_mutex_unlock(&handle->mutex);
+  }
+  else {
+    /* Make sure that the worker is done with the handle */
+    pthread_mutex_lock(&handle->mutex);
+    pthread_mutex_unlock(&handle->mutex);
+  }
+  result = handle->result;
+
+  pthread_mutex_destroy(&handle->mutex);
+  pthread_cond_destroy(&handle->done_cv);
+  my_free(&handle->context->allocator, handle);
+
+  return result;
 }
 
 int blosc_get_nthreads(void)
@@ -1968,10 +4153,15 @@ int blosc_set_nthreads_(blosc_context* context) {
     return -1;
   }
 
-  /* Launch a new pool of threads */
+  /* Launch a new pool of threads.  The calling thread works on the jobs
+     too, so the pool only needs nthreads - 1 workers. */
   if (context->nthreads > 1 && context->nthreads != context->threads_started) {
     blosc_release_threadpool(context);
-    init_threads(context);
+    context->private_threadpool = create_threadpool(context->nthreads - 1, NULL, 0,
+                                                    &context->allocator);
+    if (context->private_threadpool == NULL) {
+      return -1;
+    }
   }
 
   /* We have now started the threads */
@@ -2090,6 +4280,8 @@ void blosc_cbuffer_sizes(const void* cbuffer, size_t* nbytes,
                          size_t* cbytes, size_t* blocksize) {
   uint8_t* _src = (uint8_t*)(cbuffer);    /* current pos for source buffer */
   uint8_t version, versionlz;              /* versions for compressed header */
+  int64_t nbytes_, cbytes_;
+  int32_t blocksize_;
 
   /* Read the version info (could be useful in the future) */
   version = _src[0];                       /* blosc format version */
@@ -2098,10 +4290,11 @@ void blosc_cbuffer_sizes(const void* cbuffer, size_t* nbytes,
   version += 0;                            /* shut up compiler warning */
   versionlz += 0;                          /* shut up compiler warning */
 
-  /* Read the interesting values */
-  *nbytes = (size_t)sw32_(_src + 4);       /* uncompressed buffer size */
-  *blocksize = (size_t)sw32_(_src + 8);    /* block size */
-  *cbytes = (size_t)sw32_(_src + 12);      /* compressed buffer size */
+  /* Read the interesting values (regular or extended header) */
+  read_header_sizes(_src, &nbytes_, &blocksize_, &cbytes_);
+  *nbytes = (size_t)nbytes_;               /* uncompressed buffer size */
+  *blocksize = (size_t)blocksize_;         /* block size */
+  *cbytes = (size_t)cbytes_;               /* compressed buffer size */
 }
 
 /* Return `typesize` and `flags` from a compressed buffer. */
@@ -2165,11 +4358,14 @@ void blosc_set_schunk(blosc2_sheader* schunk) {
 }
 
 blosc_context* create_context(int nthreads) {
-  blosc_context* context = (blosc_context*)my_malloc(sizeof(blosc_context));
+  blosc_context* context = (blosc_context*)my_malloc(&g_allocator, sizeof(blosc_context));
 
   /* Initialize some struct components */
+  memset(context, 0, sizeof(blosc_context));
+  context->allocator = g_allocator;
+  context->nthreads = nthreads;
   context->serial_context = NULL;
-  context->threads = NULL;
+  context->private_threadpool = NULL;
 
   return context;
 }
@@ -2179,12 +4375,15 @@ void blosc_init(void) {
   if (g_initlib) return;
 
   pthread_mutex_init(&global_comp_mutex, NULL);
+  init_cache_sizes();
   g_global_context = create_context(g_nthreads);
   g_global_context->threads_started = 0;
   g_initlib = 1;
 }
 
 void blosc_destroy(void) {
+  blosc2_allocator allocator;
+
   /* Return if Blosc is not initialized */
   if (!g_initlib) return;
 
@@ -2193,51 +4392,15 @@ void blosc_destroy(void) {
   if (g_global_context->serial_context != NULL) {
     free_thread_context(g_global_context->serial_context);
   }
-  my_free(g_global_context);
+  allocator = g_global_context->allocator;
+  my_free(&allocator, g_global_context);
   pthread_mutex_destroy(&global_comp_mutex);
 }
 
 int blosc_release_threadpool(blosc_context* context) {
-  int32_t t;
-  void* status;
-  int rc;
-  int rc2;
-
-  if (context->threads_started > 0) {
-    /* Tell all existing threads to finish */
-    context->end_threads = 1;
-
-    /* Sync threads */
-    WAIT_INIT(-1, context);
-
-    /* Join exiting threads */
-    for (t = 0; t < context->threads_started; t++) {
-      rc2 = pthread_join(context->threads[t], &status);
-      if (rc2) {
-        fprintf(stderr, "ERROR; return code from pthread_join() is %d\n", rc2);
-        fprintf(stderr, "\tError detail: %s\n", strerror(rc2));
-      }
-    }
-
-    /* Release mutex and condition variable objects */
-    pthread_mutex_destroy(&context->count_mutex);
-
-    /* Barriers */
-  #ifdef _POSIX_BARRIERS_MINE
-    pthread_barrier_destroy(&context->barr_init);
-    pthread_barrier_destroy(&context->barr_finish);
-  #else
-    pthread_mutex_destroy(&context->count_threads_mutex);
-    pthread_cond_destroy(&context->count_threads_cv);
-  #endif
-
-    /* Thread attributes */
-  #if !defined(_WIN32)
-    pthread_attr_destroy(&context->ct_attr);
-  #endif
-
-    /* Release thread handlers */
-    my_free(context->threads);
+  if (context->private_threadpool != NULL) {
+    blosc2_free_threadpool(context->private_threadpool);
+    context->private_threadpool = NULL;
   }
 
   context->threads_started = 0;
@@ -2257,9 +4420,17 @@ int blosc_free_resources(void) {
 
 /* Create a context for compression */
 blosc_context* blosc2_create_cctx(blosc2_context_cparams* cparams) {
-  int error;
-  blosc_context* context = (blosc_context*)my_malloc(sizeof(blosc_context));
+  blosc2_allocator allocator = cparams->allocator ? *cparams->allocator : g_allocator;
+  blosc_context* context;
+
+  /* Negative weights mean the default one (this rejects NaN too) */
+  if (!(cparams->tune_ratio_weight <= 1)) {
+    fprintf(stderr, "`tune_ratio_weight` parameter must be between 0 and 1!\n");
+    return NULL;
+  }
+  context = (blosc_context*)my_malloc(&allocator, sizeof(blosc_context));
   memset(context, 0, sizeof(blosc_context));
+  context->allocator = allocator;
 
   context->compress = 1;   /* meant for compression */
   /* Populate the context, using default values for zeroed values */
@@ -2267,9 +4438,19 @@ blosc_context* blosc2_create_cctx(blosc2_context_cparams* cparams) {
   context->compcode = cparams->compcode ? cparams->compcode : BLOSC_BLOSCLZ;
   context->clevel = cparams->clevel ? cparams->clevel : 5;
   context->filtercode = cparams->filtercode ? cparams->filtercode : BLOSC_SHUFFLE;
-  context->blocksize = cparams->blocksize ? cparams->blocksize : 0;
+  context->forced_blocksize = cparams->blocksize;
   context->nthreads = cparams->nthreads ? cparams->nthreads : 1;
   context->schunk = cparams->schunk ? cparams->schunk : NULL;
+  context->threadpool = cparams->threadpool;
+
+  if (context->compcode == BLOSC_AUTO) {
+    /* The params are chosen on the fly by the autotuner */
+    context->tune = (struct blosc_tune*)my_malloc(&allocator,
+                                                  sizeof(struct blosc_tune));
+    memset(context->tune, 0, sizeof(struct blosc_tune));
+    context->tune->ratio_weight = cparams->tune_ratio_weight >= 0 ?
+                                  cparams->tune_ratio_weight : 0.5;
+  }
 
   return context;
 }
@@ -2278,22 +4459,739 @@ blosc_context* blosc2_create_cctx(blosc2_context_cparams* cparams) {
 
 /* Create a context for decompression */
 blosc_context* blosc2_create_dctx(blosc2_context_dparams* dparams) {
-  int error;
-  blosc_context* context = (blosc_context*)my_malloc(sizeof(blosc_context));
+  blosc2_allocator allocator = dparams->allocator ? *dparams->allocator : g_allocator;
+  blosc_context* context = (blosc_context*)my_malloc(&allocator, sizeof(blosc_context));
   memset(context, 0, sizeof(blosc_context));
+  context->allocator = allocator;
 
   context->compress = 0;   /* Meant for decompression */
   /* Populate the context, using default values for zeroed values */
   context->nthreads = dparams->nthreads ? dparams->nthreads : 1;
   context->schunk = dparams->schunk ? dparams->schunk : NULL;
+  context->threadpool = dparams->threadpool;
+  if (dparams->block_cache_nblocks > 0) {
+    context->block_cache = create_block_cache(&allocator,
+                                              dparams->block_cache_nblocks);
+  }
 
   return context;
 }
 
 void blosc2_free_ctx(blosc_context* context) {
+  blosc2_allocator allocator = context->allocator;
+  int32_t i;
+
+  for (i = 0; i < context->batch_ncontexts; i++) {
+    blosc2_free_ctx(context->batch_contexts[i]);
+  }
+  my_free(&allocator, context->batch_contexts);
+  my_free(&allocator, context->batch_job);
+  my_free(&allocator, context->gather_pieces);
+  my_free(&allocator, context->gather_groups);
+  if (context->block_cache != NULL && !context->block_cache_borrowed) {
+    free_block_cache(context->block_cache);
+  }
+  if (context->tune != NULL) {
+    if (context->tune->trial_ctx != NULL) {
+      blosc2_free_ctx(context->tune->trial_ctx);
+    }
+    my_free(&allocator, context->tune->sample);
+    my_free(&allocator, context->tune->cdest);
+    my_free(&allocator, context->tune);
+  }
   blosc_release_threadpool(context);
   if (context->serial_context != NULL) {
     free_thread_context(context->serial_context);
   }
-  my_free(context);
+  my_free(&allocator, context);
+}
+
+int blosc2_get_block_cache_stats(blosc_context* context,
+                                 blosc2_block_cache_stats* stats) {
+  struct blosc_block_cache* cache = context->block_cache;
+
+  if (cache == NULL) {
+    memset(stats, 0, sizeof(blosc2_block_cache_stats));
+    return -1;
+  }
+  pthread_mutex_lock(&cache->mutex);
+  stats->hits = cache->hits;
+  stats->misses = cache->misses;
+  stats->nblocks = cache->nentries;
+  pthread_mutex_unlock(&cache->mutex);
+  return 0;
+}
+
+void blosc2_clear_block_cache(blosc_context* context) {
+  if (context->block_cache != NULL) {
+    clear_block_cache(context->block_cache);
+  }
+}
+
+
+/* Size of the header (including the starts of the blocks) of the chunks
+   of a compression stream */
+static int64_t cstream_header_len(blosc2_cstream* stream) {
+  blosc_context* context = stream->context;
+
+  if (*(context->header_flags) & BLOSC_MEMCPYED) {
+    return context->header_len;
+  }
+  return context->header_len + (int64_t)sizeof(int32_t) * stream->maxblocks;
+}
+
+/* Compress the `bsize` bytes of input in `src` as the next block of the
+   chunk being built */
+static int cstream_compress_block(blosc2_cstream* stream, const uint8_t* src,
+                                  int32_t bsize) {
+  blosc_context* context = stream->context;
+  struct thread_context* scontext = context->serial_context;
+  int32_t ebsize = context->blocksize + context->typesize * (int32_t)sizeof(int32_t);
+  int64_t offset = (int64_t)stream->nblocks * context->blocksize;
+  int32_t cbytes;
+
+  if (*(context->header_flags) & BLOSC_MEMCPYED) {
+    /* We want to memcpy only */
+    memcpy(stream->chunk + context->header_len + offset, src, (size_t)bsize);
+    cbytes = bsize;
+  }
+  else {
+    /* The room of a block is reserved in the chunk, so that incompressible
+       blocks are just stored */
+    set_bstart(context->bstarts, 0, stream->nblocks, stream->cbytes);
+    cbytes = blosc_c(scontext, bsize, bsize < context->blocksize, 0, ebsize,
+                     src, offset, stream->chunk + stream->cbytes,
+                     scontext->tmp, scontext->tmp2);
+    if (cbytes <= 0) {
+      return (cbytes < 0) ? cbytes : -1;
+    }
+  }
+  stream->nbytes += bsize;
+  stream->nblocks++;
+  stream->cbytes += cbytes;
+  return 0;
+}
+
+/* Finish the chunk being built and pass it to the output of the stream.
+   Returns the number of chunks finished (0 or 1) or a negative value if
+   some error happens. */
+static int cstream_finish_chunk(blosc2_cstream* stream) {
+  blosc_context* context = stream->context;
+  int64_t header_len = cstream_header_len(stream);
+  int64_t shift;
+  uint8_t* chunk;
+  int32_t j;
+  int error = 0;
+
+  if (stream->block_nbytes > 0) {
+    error = cstream_compress_block(stream, stream->block, stream->block_nbytes);
+    stream->block_nbytes = 0;
+    if (error < 0) {
+      return error;
+    }
+  }
+  if (stream->nblocks == 0) {
+    return 0;
+  }
+
+  if (!(*(context->header_flags) & BLOSC_MEMCPYED)) {
+    /* Drop the starts reserved for the blocks that the chunk does not have */
+    shift = (int64_t)sizeof(int32_t) * (stream->maxblocks - stream->nblocks);
+    if (shift > 0) {
+      memmove(stream->chunk + header_len - shift, stream->chunk + header_len,
+              (size_t)(stream->cbytes - header_len));
+      for (j = 0; j < stream->nblocks; j++) {
+        set_bstart(context->bstarts, 0, j,
+                   get_bstart(context->bstarts, 0, j) - shift);
+      }
+      stream->cbytes -= shift;
+    }
+  }
+  _sw32(stream->chunk + 4, stream->nbytes);     /* size of the buffer */
+  set_header_cbytes(context, stream->cbytes);
+
+  if (stream->output != NULL) {
+    error = stream->output(stream->chunk, (int32_t)stream->cbytes,
+                           stream->user_data);
+  }
+  else {
+    /* Super-chunks own their chunks, so they get a copy */
+    chunk = blosc_malloc(schunk_allocator(context->schunk),
+                         (size_t)stream->cbytes);
+    if (chunk == NULL) {
+      error = -1;
+    }
+    else {
+      memcpy(chunk, stream->chunk, (size_t)stream->cbytes);
+      /* This frees the chunk if it cannot be appended */
+      if ((int64_t)append_chunk(context->schunk, chunk) < 0) {
+        error = -1;
+      }
+    }
+  }
+
+  stream->nbytes = 0;
+  stream->nblocks = 0;
+  stream->cbytes = header_len;
+  return (error < 0) ? error : 1;
+}
+
+blosc2_cstream* blosc2_create_cstream(blosc_context* context,
+                                      int32_t chunksize,
+                                      blosc2_cstream_output output,
+                                      void* user_data) {
+  blosc2_cstream* stream;
+  uint8_t filters[BLOSC_MAX_FILTERS];
+  uint8_t* chunk;
+  int64_t chunk_capacity;
+  int32_t ebsize;
+  int error;
+
+  if (context->compress != 1) {
+    fprintf(stderr, "Context is not meant for compression.  Giving up.\n");
+    return NULL;
+  }
+  if (context->tune != NULL) {
+    fprintf(stderr, "Compression streams do not support BLOSC_AUTO\n");
+    return NULL;
+  }
+  if (chunksize <= 0 || chunksize > BLOSC_MAX_BUFFERSIZE) {
+    fprintf(stderr, "`chunksize` must be between 1 and BLOSC_MAX_BUFFERSIZE\n");
+    return NULL;
+  }
+  if (output == NULL) {
+    if (context->schunk == NULL) {
+      fprintf(stderr, "Streams need an output or a super-chunk\n");
+      return NULL;
+    }
+    decode_filters(context->schunk->filters, filters);
+    if (filters[0] == BLOSC_DELTA && context->schunk->filters_chunk == NULL) {
+      fprintf(stderr, "The delta reference of the super-chunk is not set\n");
+      return NULL;
+    }
+  }
+
+  error = initialize_context_compression(
+    context, (size_t)chunksize, NULL, NULL, 0,
+    context->clevel, context->filtercode, context->typesize,
+    context->compcode, context->forced_blocksize, 1, context->schunk);
+  if (error < 0) {
+    return NULL;
+  }
+  /* Chunks always get the regular header */
+  context->extended = 0;
+  context->header_len = BLOSC_MIN_HEADER_LENGTH;
+
+  ebsize = context->blocksize + context->typesize * (int32_t)sizeof(int32_t);
+  chunk_capacity = context->header_len +
+                   (int64_t)(sizeof(int32_t) + ebsize) * context->nblocks;
+  chunk = my_malloc(&context->allocator, (size_t)chunk_capacity);
+  if (chunk == NULL) {
+    return NULL;
+  }
+  context->dest = chunk;
+  context->destsize = chunk_capacity;
+  error = write_compression_header(context);
+  if (error < 0) {
+    my_free(&context->allocator, chunk);
+    return NULL;
+  }
+
+  stream = (blosc2_cstream*)my_malloc(&context->allocator,
+                                      sizeof(blosc2_cstream));
+  if (stream == NULL) {
+    my_free(&context->allocator, chunk);
+    return NULL;
+  }
+  memset(stream, 0, sizeof(blosc2_cstream));
+  stream->context = context;
+  stream->chunksize = chunksize;
+  stream->maxblocks = context->nblocks;
+  stream->output = output;
+  stream->user_data = user_data;
+  stream->block = my_malloc(&context->allocator, (size_t)context->blocksize);
+  stream->chunk = chunk;
+  stream->chunk_capacity = chunk_capacity;
+  stream->cbytes = cstream_header_len(stream);
+
+  if (context->serial_context == NULL) {
+    context->serial_context = create_thread_context(context, &context->allocator, 0);
+  }
+  else {
+    context->serial_context->parent_context = context;
+    resize_temporaries(context->serial_context, context->blocksize,
+                       context->typesize);
+  }
+
+  return stream;
+}
+
+int blosc2_cstream_write(blosc2_cstream* stream, const void* src,
+                         size_t nbytes) {
+  blosc_context* context = stream->context;
+  const uint8_t* _src = (const uint8_t*)src;
+  int32_t wanted, n;
+  int nchunks = 0;
+  int error;
+
+  while (nbytes > 0) {
+    /* The bytes that fill the current block (the last block of a chunk may
+       be smaller) */
+    wanted = stream->chunksize - stream->nbytes;
+    if (wanted > context->blocksize) {
+      wanted = context->blocksize;
+    }
+    if (stream->block_nbytes == 0 && nbytes >= (size_t)wanted) {
+      /* Whole blocks are compressed straight from `src` */
+      error = cstream_compress_block(stream, _src, wanted);
+      n = wanted;
+    }
+    else {
+      n = wanted - stream->block_nbytes;
+      if ((size_t)n > nbytes) {
+        n = (int32_t)nbytes;
+      }
+      memcpy(stream->block + stream->block_nbytes, _src, (size_t)n);
+      stream->block_nbytes += n;
+      error = 0;
+      if (stream->block_nbytes == wanted) {
+        stream->block_nbytes = 0;
+        error = cstream_compress_block(stream, stream->block, wanted);
+      }
+    }
+    if (error < 0) {
+      return error;
+    }
+    _src += n;
+    nbytes -= n;
+
+    if (stream->nbytes == stream->chunksize) {
+      error = cstream_finish_chunk(stream);
+      if (error < 0) {
+        return error;
+      }
+      nchunks += error;
+    }
+  }
+
+  return nchunks;
+}
+
+int blosc2_cstream_flush(blosc2_cstream* stream) {
+  return cstream_finish_chunk(stream);
+}
+
+int blosc2_cstream_end(blosc2_cstream* stream) {
+  blosc2_allocator allocator = stream->context->allocator;
+  int result;
+
+  result = cstream_finish_chunk(stream);
+  my_free(&allocator, stream->block);
+  my_free(&allocator, stream->chunk);
+  my_free(&allocator, stream);
+  return result;
+}
+
+
+int64_t blosc2_dstream_read_fd(void* buf, int64_t nbytes, void* user_data) {
+  int fd = *(int*)user_data;
+  int64_t n;
+
+  if (nbytes > INT_MAX) {
+    nbytes = INT_MAX;
+  }
+  do {
+#if defined(_WIN32) && !defined(__MINGW32__)
+    n = _read(fd, buf, (unsigned int)nbytes);
+#else
+    n = read(fd, buf, (size_t)nbytes);
+#endif  /* _WIN32 */
+  } while (n < 0 && errno == EINTR);
+  return n;
+}
+
+/* Make sure that the input up to the position `stop` is in the window of
+   the stream.  Returns 0 on success, 1 if the input ends before or a
+   negative value if reading fails. */
+static int dstream_fill(struct blosc_dstream* ds, int64_t stop) {
+  blosc2_allocator* allocator = &ds->context->allocator;
+  int64_t n, capacity;
+  uint8_t* buf;
+
+  if (stop - ds->start > ds->capacity) {
+    capacity = 2 * ds->capacity;
+    if (capacity < stop - ds->start) {
+      capacity = stop - ds->start;
+    }
+    buf = my_malloc(allocator, (size_t)capacity);
+    if (buf == NULL) {
+      return -1;
+    }
+    memcpy(buf, ds->buf, (size_t)ds->len);
+    my_free(allocator, ds->buf);
+    ds->buf = buf;
+    ds->capacity = capacity;
+  }
+  while (ds->start + ds->len < stop) {
+    n = ds->read(ds->buf + ds->len, ds->capacity - ds->len, ds->read_data);
+    if (n < 0) {
+      return (int)n;
+    }
+    if (n == 0) {
+      return 1;
+    }
+    ds->len += n;
+  }
+  return 0;
+}
+
+/* Drop the input before the position `stop` (reading it if needed) */
+static int dstream_skip(struct blosc_dstream* ds, int64_t stop) {
+  int64_t n;
+  int rc;
+
+  while (ds->start + ds->len < stop) {
+    ds->start += ds->len;
+    ds->len = 0;
+    n = stop - ds->start;
+    if (n > ds->capacity) {
+      n = (ds->capacity > 0) ? ds->capacity : stop - ds->start;
+    }
+    rc = dstream_fill(ds, ds->start + n);
+    if (rc != 0) {
+      return (rc > 0) ? -1 : rc;
+    }
+  }
+  if (stop > ds->start) {
+    n = stop - ds->start;
+    memmove(ds->buf, ds->buf + n, (size_t)(ds->len - n));
+    ds->start = stop;
+    ds->len -= n;
+  }
+  return 0;
+}
+
+/* Pass `nbytes` of decompressed data in `data` to the output */
+static int dstream_output(struct blosc_dstream* ds, const uint8_t* data,
+                          int32_t nbytes) {
+  int rc = ds->output(data, nbytes, ds->output_data);
+
+  if (rc < 0) {
+    return rc;
+  }
+  ds->ntbytes += nbytes;
+  return 0;
+}
+
+static int compare_dstream_blocks(const void* a, const void* b) {
+  const struct blosc_dstream_block* pa = (const struct blosc_dstream_block*)a;
+  const struct blosc_dstream_block* pb = (const struct blosc_dstream_block*)b;
+
+  if (pa->start != pb->start) {
+    return (pa->start < pb->start) ? -1 : 1;
+  }
+  return pa->nblock - pb->nblock;
+}
+
+/* Read the starts of the blocks of the chunk at `cstart` and work out where
+   every block ends.  The blocks are stored sorted by their position. */
+static int dstream_read_blocks(struct blosc_dstream* ds, int64_t cstart,
+                               int64_t cbytes) {
+  blosc_context* context = ds->context;
+  blosc2_allocator* allocator = &context->allocator;
+  int32_t bstart_len = context->extended ? 8 : 4;
+  int64_t data_start = context->header_len + (int64_t)bstart_len * context->nblocks;
+  struct blosc_dstream_block* blocks;
+  int32_t i;
+  int rc;
+
+  if (context->nblocks > ds->maxblocks) {
+    my_free(allocator, ds->blocks);
+    my_free(allocator, ds->minstarts);
+    ds->blocks = (struct blosc_dstream_block*)my_malloc(
+        allocator, context->nblocks * sizeof(struct blosc_dstream_block));
+    ds->minstarts = (int64_t*)my_malloc(
+        allocator, (context->nblocks + 1) * sizeof(int64_t));
+    ds->maxblocks = context->nblocks;
+  }
+  blocks = ds->blocks;
+
+  rc = dstream_fill(ds, cstart + data_start);
+  if (rc != 0) {
+    return (rc > 0) ? -1 : rc;
+  }
+  for (i = 0; i < context->nblocks; i++) {
+    blocks[i].start = get_bstart(ds->buf + (cstart + context->header_len - ds->start),
+                                 context->extended, i);
+    blocks[i].nblock = i;
+    if (blocks[i].start < data_start || blocks[i].start >= cbytes) {
+      fprintf(stderr, "Corrupted block starts in stream\n");
+      return -1;
+    }
+  }
+  qsort(blocks, (size_t)context->nblocks, sizeof(struct blosc_dstream_block),
+        compare_dstream_blocks);
+  for (i = 0; i < context->nblocks; i++) {
+    blocks[i].stop = (i < context->nblocks - 1) ? blocks[i + 1].start : cbytes;
+  }
+
+  /* Back to the order of the blocks in the chunk */
+  for (i = 0; i < context->nblocks; i++) {
+    ds->minstarts[i] = blocks[i].start;
+  }
+  for (i = 0; i < context->nblocks; i++) {
+    while (blocks[i].nblock != i) {
+      struct blosc_dstream_block tmp = blocks[blocks[i].nblock];
+      blocks[blocks[i].nblock] = blocks[i];
+      blocks[i] = tmp;
+    }
+  }
+  ds->minstarts[context->nblocks] = cbytes;
+  for (i = context->nblocks - 1; i >= 0; i--) {
+    ds->minstarts[i] = blocks[i].start < ds->minstarts[i + 1] ?
+                       blocks[i].start : ds->minstarts[i + 1];
+  }
+  return 0;
+}
+
+/* Decompress the chunk that starts at the position `cstart` of the input.
+   Returns the position where the chunk ends, 0 if the input ends right
+   at `cstart` or a negative value if some error happens. */
+static int64_t dstream_chunk(struct blosc_dstream* ds, int64_t cstart) {
+  blosc_context* context = ds->context;
+  struct thread_context* scontext;
+  uint8_t header[BLOSC_EXTENDED_HEADER_LENGTH];
+  const uint8_t* src;
+  int64_t cbytes, offset, nbytes;
+  int32_t j, bsize;
+  int rc;
+
+  rc = dstream_fill(ds, cstart + BLOSC_MIN_HEADER_LENGTH);
+  if (rc != 0) {
+    if (rc > 0 && ds->start + ds->len == cstart) {
+      return 0;
+    }
+    return (rc > 0) ? -1 : rc;
+  }
+  if (ds->buf[cstart - ds->start] == BLOSC_VERSION_FORMAT_64) {
+    rc = dstream_fill(ds, cstart + BLOSC_EXTENDED_HEADER_LENGTH);
+    if (rc != 0) {
+      return (rc > 0) ? -1 : rc;
+    }
+  }
+  memcpy(header, ds->buf + (cstart - ds->start), BLOSC_MIN_HEADER_LENGTH);
+  if (header[0] == BLOSC_VERSION_FORMAT_64) {
+    memcpy(header, ds->buf + (cstart - ds->start), BLOSC_EXTENDED_HEADER_LENGTH);
+  }
+
+  /* The header stays valid while the window slides */
+  context->compress = 0;
+  context->header_flags = header + 2;
+  context->typesize = header[3];
+  context->header_len = read_header_sizes(header, &context->sourcesize,
+                                          &context->blocksize, &cbytes);
+  context->extended = (context->header_len == BLOSC_EXTENDED_HEADER_LENGTH);
+  context->filtercode = get_filtercode(*(context->header_flags), context->typesize);
+  if (context->blocksize <= 0 || cbytes < context->header_len) {
+    fprintf(stderr, "Corrupted chunk header in stream\n");
+    return -1;
+  }
+  context->nblocks = (int32_t)(context->sourcesize / context->blocksize);
+  context->leftover = (int32_t)(context->sourcesize % context->blocksize);
+  context->nblocks = (context->leftover > 0) ? context->nblocks + 1 : context->nblocks;
+
+  if (*(context->header_flags) & BLOSC_MEMCPYED) {
+    for (offset = 0; offset < context->sourcesize; offset += nbytes) {
+      nbytes = context->sourcesize - offset;
+      if (nbytes > context->blocksize) {
+        nbytes = context->blocksize;
+      }
+      rc = dstream_fill(ds, cstart + context->header_len + offset + nbytes);
+      if (rc != 0) {
+        return (rc > 0) ? -1 : rc;
+      }
+      src = ds->buf + (cstart + context->header_len + offset - ds->start);
+      rc = dstream_output(ds, src, (int32_t)nbytes);
+      if (rc < 0) {
+        return rc;
+      }
+      rc = dstream_skip(ds, cstart + context->header_len + offset + nbytes);
+      if (rc < 0) {
+        return rc;
+      }
+    }
+    rc = dstream_skip(ds, cstart + cbytes);
+    return (rc < 0) ? rc : cstart + cbytes;
+  }
+
+  rc = dstream_read_blocks(ds, cstart, cbytes);
+  if (rc < 0) {
+    return rc;
+  }
+  if (context->serial_context == NULL) {
+    context->serial_context = create_thread_context(context, &context->allocator, 0);
+  }
+  scontext = context->serial_context;
+  scontext->parent_context = context;
+  resize_temporaries(scontext, context->blocksize, context->typesize);
+
+  for (j = 0; j < context->nblocks; j++) {
+    bsize = context->blocksize;
+    if ((j == context->nblocks - 1) && (context->leftover > 0)) {
+      bsize = context->leftover;
+    }
+    offset = (int64_t)j * context->blocksize;
+    rc = dstream_fill(ds, cstart + ds->blocks[j].stop);
+    if (rc != 0) {
+      return (rc > 0) ? -1 : rc;
+    }
+    src = ds->buf + (cstart + ds->blocks[j].start - ds->start);
+    rc = blosc_d(scontext, bsize, bsize < context->blocksize, src,
+                 scontext->tmp3, offset, scontext->tmp, scontext->tmp2);
+    if (rc < 0) {
+      return rc;
+    }
+    if (ds->filters_chunk != NULL) {
+      /* Packed super-chunks undo the delta after decompressing */
+      delta_decoder8(get_delta_dctx(scontext), ds->filters_chunk, offset,
+                     bsize, scontext->tmp3, scontext->tmp);
+    }
+    rc = dstream_output(ds, scontext->tmp3, bsize);
+    if (rc < 0) {
+      return rc;
+    }
+    /* Forget the input that no block needs anymore */
+    rc = dstream_skip(ds, cstart + ds->minstarts[j + 1]);
+    if (rc < 0) {
+      return rc;
+    }
+  }
+
+  rc = dstream_skip(ds, cstart + cbytes);
+  return (rc < 0) ? rc : cstart + cbytes;
+}
+
+/* Set up a streaming decompression with `context` */
+static void dstream_init(struct blosc_dstream* ds, blosc_context* context,
+                         blosc2_dstream_read read, void* read_data,
+                         blosc2_dstream_output output, void* output_data) {
+  memset(ds, 0, sizeof(struct blosc_dstream));
+  ds->context = context;
+  ds->read = read;
+  ds->read_data = read_data;
+  ds->output = output;
+  ds->output_data = output_data;
+}
+
+static void dstream_free(struct blosc_dstream* ds) {
+  blosc2_allocator* allocator = &ds->context->allocator;
+
+  my_free(allocator, ds->buf);
+  my_free(allocator, ds->blocks);
+  my_free(allocator, ds->minstarts);
+  my_free(allocator, ds->filters_chunk);
+}
+
+int64_t blosc2_decompress_stream(blosc_context* context,
+                                 blosc2_dstream_read read, void* read_data,
+                                 blosc2_dstream_output output,
+                                 void* output_data) {
+  struct blosc_block_cache* cache = context->block_cache;
+  struct blosc_dstream ds;
+  int64_t cstart = 0;
+
+  /* The window moves, so its blocks cannot be cached */
+  context->block_cache = NULL;
+  dstream_init(&ds, context, read, read_data, output, output_data);
+  do {
+    cstart = dstream_chunk(&ds, cstart);
+  } while (cstart > 0);
+  dstream_free(&ds);
+  context->block_cache = cache;
+
+  return (cstart < 0) ? cstart : ds.ntbytes;
+}
+
+int64_t blosc2_decompress_packed_stream(
+    blosc_context* context, blosc2_dstream_read read, void* read_data,
+    blosc2_dstream_output output, void* output_data) {
+  struct blosc_block_cache* cache = context->block_cache;
+  blosc2_sheader* schunk = context->schunk;
+  struct blosc_dstream ds;
+  uint8_t filters[BLOSC_MAX_FILTERS];
+  int64_t offsets[4];
+  int64_t nchunks, data_offsets, capacity, pos, cbytes, i;
+  int64_t rc = 0;
+  int32_t j;
+
+  context->block_cache = NULL;
+  /* Packed super-chunks do not run the delta filter in the pipeline */
+  context->schunk = NULL;
+  dstream_init(&ds, context, read, read_data, output, output_data);
+
+  pos = sizeof(blosc2_sheader);
+  rc = dstream_fill(&ds, pos);
+  if (rc != 0) {
+    rc = (rc > 0) ? -1 : rc;
+    goto out;
+  }
+  decode_filters(*(uint16_t*)(ds.buf + 8), filters);
+  nchunks = *(int64_t*)(ds.buf + 16);
+  data_offsets = *(int64_t*)(ds.buf + 72);
+  capacity = *(int64_t*)(ds.buf + 80);
+  for (j = 0; j < 4; j++) {
+    offsets[j] = *(int64_t*)(ds.buf + 40 + 8 * j);
+  }
+
+  /* The ancillary chunks come first, in the order of the header */
+  for (j = 0; j < 4; j++) {
+    if (offsets[j] == 0) {
+      continue;
+    }
+    if (offsets[j] < pos) {
+      fprintf(stderr, "The chunks of the packed super-chunk are not in order\n");
+      rc = -1;
+      goto out;
+    }
+    rc = dstream_skip(&ds, offsets[j]);
+    if (rc == 0) {
+      rc = dstream_fill(&ds, offsets[j] + BLOSC_MIN_HEADER_LENGTH);
+    }
+    if (rc != 0) {
+      rc = (rc > 0) ? -1 : rc;
+      goto out;
+    }
+    cbytes = sw32_(ds.buf + 12);    /* the window starts at the chunk */
+    if (j == 0 && filters[0] == BLOSC_DELTA) {
+      rc = dstream_fill(&ds, offsets[j] + cbytes);
+      if (rc != 0) {
+        rc = (rc > 0) ? -1 : rc;
+        goto out;
+      }
+      ds.filters_chunk = my_malloc(&context->allocator, (size_t)cbytes);
+      memcpy(ds.filters_chunk, ds.buf, (size_t)cbytes);
+    }
+    pos = offsets[j] + cbytes;
+  }
+
+  /* And then the data chunks, one after the other */
+  for (i = 0; i < nchunks; i++) {
+    rc = dstream_chunk(&ds, pos);
+    if (rc <= 0) {
+      rc = (rc == 0) ? -1 : rc;
+      goto out;
+    }
+    pos = rc;
+  }
+  /* The room reserved for appending chunks (if any) follows the chunks */
+  if (pos > data_offsets || (pos < data_offsets && capacity == 0)) {
+    fprintf(stderr, "The chunks of the packed super-chunk are not in order\n");
+    rc = -1;
+  }
+
+  out:
+  dstream_free(&ds);
+  context->block_cache = cache;
+  context->schunk = schunk;
+  return (rc < 0) ? rc : ds.ntbytes;
 }
@@ -36,15 +36,28 @@ extern "C" {
    2 -> Blosc 1.x series
    3 -> Blosc 2.x series */
 
+#define BLOSC_VERSION_FORMAT_64 4
+/* Blosc format version for buffers with an extended header (64-bit sizes
+   and block starts).  These are used for buffers larger than
+   BLOSC_MAX_BUFFERSIZE. */
+
 /* Minimum header length */
 #define BLOSC_MIN_HEADER_LENGTH 16
 
+/* Header length for buffers with an extended header */
+#define BLOSC_EXTENDED_HEADER_LENGTH 32
+
 /* The maximum overhead during compression in bytes.  This equals to
    BLOSC_MIN_HEADER_LENGTH now, but can be higher in future
    implementations */
 #define BLOSC_MAX_OVERHEAD BLOSC_MIN_HEADER_LENGTH
 
-/* Maximum source buffer size to be compressed */
+/* The maximum overhead during compression of buffers larger than
+   BLOSC_MAX_BUFFERSIZE (only with blosc2_compress_ctx64()) */
+#define BLOSC_EXTENDED_MAX_OVERHEAD BLOSC_EXTENDED_HEADER_LENGTH
+
+/* Maximum source buffer size to be compressed (except for
+   blosc2_compress_ctx64()) */
 #define BLOSC_MAX_BUFFERSIZE (INT_MAX - BLOSC_MAX_OVERHEAD)
 
 /* Maximum typesize before considering source buffer as a stream of bytes */
@@ -74,6 +87,11 @@ extern "C" {
 #define BLOSC_ZLIB           4
 #define BLOSC_ZSTD           5
 
+/* Code for letting a compression context choose the codec, the filter,
+   the compression level and the blocksize by itself (see the `compcode`
+   field of blosc2_context_cparams) */
+#define BLOSC_AUTO           255
+
 /* Names for the different compressors shipped with Blosc */
 #define BLOSC_BLOSCLZ_COMPNAME   "blosclz"
 #define BLOSC_LZ4_COMPNAME       "lz4"
@@ -371,7 +389,8 @@ BLOSC_EXPORT int blosc_free_resources(void);
   compression by blocks).
 
   You only need to pass the first BLOSC_MIN_HEADER_LENGTH bytes of a
-  compressed buffer for this call to work.
+  compressed buffer for this call to work (BLOSC_EXTENDED_HEADER_LENGTH
+  bytes for buffers with an extended header).
 
   This function should always succeed.
 */
@@ -469,15 +488,70 @@ typedef struct {
   uint8_t filters[BLOSC_MAX_FILTERS];
   /* the (sequence of) filters */
   uint16_t filters_meta;   /* metadata for filters */
+  uint8_t nthreads;
+  /* the number of threads for (de-)compressing chunks (0; the global one
+     set with blosc_set_nthreads() when the super-chunk is created) */
+  int32_t block_cache_nblocks;
+  /* the number of decompressed blocks that the contexts reading chunks
+     keep in a cache (0; no cache).  See blosc2_create_dctx(). */
 } blosc2_sparams;
 
 /* Default struct for schunk params meant for user initialization */
 static const blosc2_sparams BLOSC_SPARAMS_DEFAULTS = \
-  { BLOSC_ZSTD, 5, {BLOSC_SHUFFLE, 0, 0, 0, 0}, 0 };
-
-/* Create a new super-chunk. */
+  { BLOSC_ZSTD, 5, {BLOSC_SHUFFLE, 0, 0, 0, 0}, 0, 0, 0 };
+
+/* Create a new super-chunk.
+
+   The super-chunk owns the contexts for compressing and decompressing
+   its chunks, so it does not touch the global state of the library, and
+   different super-chunks can be used from different threads at the same
+   time.  If `nthreads` in `sparams` (or, if it is 0, the number of
+   threads set with blosc_set_nthreads()) is larger than 1, the blocks
+   of each chunk are (de-)compressed in parallel by a pool of threads.
+   The pool is shared by all the super-chunks with the same number of
+   threads, and it is started by the first (de-)compression of any of
+   them, so creating many super-chunks does not start many threads.
+   Later calls to blosc_set_nthreads() do not affect existing
+   super-chunks.
+*/
 BLOSC_EXPORT blosc2_sheader* blosc2_new_schunk(blosc2_sparams* sparams);
 
+/* Create a new super-chunk backed by the file at `path`.
+
+   The file is truncated and gets the layout of a packed super-chunk
+   (see README_PACKED_HEADER.rst).  Appended chunks are written straight
+   to the file, so chunks are not kept in memory.  The index of chunk
+   offsets and the header are written at the end of the file by
+   blosc2_sync_schunk_file() and blosc2_destroy_schunk() (which also
+   closes the file), and only then the file is a valid packed super-chunk.
+   The delta reference (if any) has to be set before appending chunks.
+   The usual super-chunk functions work on the returned header.
+
+   Returns NULL if the file cannot be created.
+*/
+BLOSC_EXPORT blosc2_sheader* blosc2_new_schunk_file(blosc2_sparams* sparams,
+                                                    const char* path);
+
+/* Write the index of chunk offsets and the header of a super-chunk file
+   after its last chunk, and flush the file.  Until this is called (or the
+   super-chunk is destroyed), the chunks appended are not part of the
+   packed super-chunk in the file.
+
+   Returns 0 on success, or a negative value if the file cannot be
+   written or the super-chunk is not backed by a file.
+*/
+BLOSC_EXPORT int blosc2_sync_schunk_file(blosc2_sheader* sheader);
+
+/* Open a super-chunk file created with blosc2_new_schunk_file() (or
+   holding a packed super-chunk) for reading and appending.  Only the
+   header, the delta reference and the index of chunk offsets are read.
+   The super-chunk uses the number of threads set with
+   blosc_set_nthreads().
+
+   Returns NULL if the file cannot be opened or read.
+*/
+BLOSC_EXPORT blosc2_sheader* blosc2_open_schunk_file(const char* path);
+
 /* Set a delta reference for the super-chunk */
 BLOSC_EXPORT int blosc2_set_delta_ref(blosc2_sheader* sheader,
     size_t typesize, size_t nbytes, void* ref);
@@ -496,9 +570,41 @@ BLOSC_EXPORT int blosc2_destroy_schunk(blosc2_sheader* sheader);
 BLOSC_EXPORT size_t blosc2_append_buffer(blosc2_sheader* sheader,
      size_t typesize, size_t nbytes, void* src);
 
+/* Append `nbuffers` data buffers to a super-chunk in one call.
+
+ Buffer i starts at `srcs[i]` and has `sizes[i]` bytes.  The buffers are
+ compressed in parallel by the threads of the super-chunk (see `nthreads`
+ in blosc2_sparams), and the chunks are appended in order.
+
+ This returns the number of chunks in super-chunk.  If some problem is
+ detected, this number will be negative (and if it happened while
+ compressing, no chunk is appended).
+ */
+BLOSC_EXPORT size_t blosc2_append_buffers(blosc2_sheader* sheader,
+     size_t typesize, int32_t nbuffers, const void* const* srcs,
+     const size_t* sizes);
+
 BLOSC_EXPORT void* blosc2_packed_append_buffer(void* packed, size_t typesize,
                                                size_t nbytes, void* src);
 
+/* Reserve room in a *packed* super-chunk for appending `nchunks` more
+ chunks with `cbytes` more compressed bytes in total.
+
+ The data chunk offsets are moved to the end of the buffer, after the
+ room for data chunks, and the size of the buffer is stored in bytes
+ 80-87 of the header (see README_PACKED_HEADER.rst).  From then on,
+ appends do not move the offsets, and the room is doubled when it runs
+ out, so appending is amortized O(1).
+
+ Returns the new address of the packed super-chunk.
+ */
+BLOSC_EXPORT void* blosc2_packed_reserve(void* packed, int64_t nchunks,
+                                         int64_t cbytes);
+
+/* Release the room reserved in a *packed* super-chunk, so that its size
+ is `cbytes` again.  Returns the new address of the packed super-chunk. */
+BLOSC_EXPORT void* blosc2_packed_shrink(void* packed);
+
 /* Decompress and return the `nchunk` chunk of a super-chunk.
 
  If the chunk is uncompressed successfully, it is put in the `*dest`
@@ -508,19 +614,75 @@ BLOSC_EXPORT void* blosc2_packed_append_buffer(void* packed, size_t typesize,
 
  The size of the decompressed chunk is returned.  If some problem is
  detected, a negative code is returned instead.
+
+ Many threads can decompress chunks of an in-memory super-chunk while a
+ single thread appends chunks to it (with blosc2_append_buffer() or
+ blosc2_append_buffers()) without any locking.  The array of chunk
+ pointers is never reallocated in place; the ones replaced by larger
+ arrays are freed with the super-chunk.  This does not apply to
+ super-chunks backed by files.
  */
 BLOSC_EXPORT int blosc2_decompress_chunk(blosc2_sheader* sheader,
      int64_t nchunk, void* dest, int nbytes);
 
+/* Decompress the `count` consecutive chunks of a super-chunk starting at
+   `first` into the contiguous buffer `dest`, which has room for `nbytes`
+   bytes.
+
+   The blocks of all the chunks are handed out to the threads of the
+   super-chunk (see `nthreads` in blosc2_sparams) as a single job, so
+   scanning many chunks is faster than calling blosc2_decompress_chunk()
+   for each of them.  The chunks of super-chunks backed by files are
+   decompressed one by one.
+
+   The total size of the decompressed chunks is returned.  If some problem
+   is detected, a negative code is returned instead.
+ */
+BLOSC_EXPORT int64_t blosc2_decompress_chunks(blosc2_sheader* sheader,
+     int64_t first, int64_t count, void* dest, int64_t nbytes);
+
 BLOSC_EXPORT int blosc2_packed_decompress_chunk(void* packed, int nchunk,
       void** dest);
 
+/* Decompress the `nchunk` chunk of a *packed* super-chunk into `dest`.
+
+ The chunk is decompressed straight from `packed` (which can be mapped
+ with blosc2_map_packed_schunk()), without intermediate copies.
+ `nbytes` is the size of the area pointed by `dest`.
+
+ The size of the decompressed chunk is returned.  If some problem is
+ detected, a negative code is returned instead.
+ */
+BLOSC_EXPORT int blosc2_packed_decompress_chunk_into(void* packed,
+      int nchunk, void* dest, size_t nbytes);
+
 /* Pack a super-chunk by using the header. */
 BLOSC_EXPORT void* blosc2_pack_schunk(blosc2_sheader* sheader);
 
-/* Unpack a packed super-chunk */
+/* Unpack a packed super-chunk.  The super-chunk uses the number of
+   threads set with blosc_set_nthreads(). */
 BLOSC_EXPORT blosc2_sheader* blosc2_unpack_schunk(void* packed);
 
+/* Map the packed super-chunk in the file at `path` (read-only).
+
+ Nothing is read from the file until chunks are accessed, so this takes
+ the same time for any file size.  The returned pointer can be passed to
+ the functions for packed super-chunks that do not modify them, like
+ blosc2_packed_decompress_chunk_into().  If `sequential` is not 0, the
+ OS is told that the chunks will be read in order, so that it reads
+ ahead of them.  The size of the mapping is stored in `*length` (if not
+ NULL).
+
+ Returns NULL if the file cannot be mapped or does not hold a packed
+ super-chunk.
+ */
+BLOSC_EXPORT void* blosc2_map_packed_schunk(const char* path, int sequential,
+                                            int64_t* length);
+
+/* Unmap a packed super-chunk mapped with blosc2_map_packed_schunk().
+ `length` is the size of the mapping.  Returns 0 on success. */
+BLOSC_EXPORT int blosc2_unmap_packed_schunk(void* packed, int64_t length);
+
 
 /*********************************************************************
 
@@ -529,6 +691,52 @@ BLOSC_EXPORT blosc2_sheader* blosc2_unpack_schunk(void* packed);
 *********************************************************************/
 
 typedef struct blosc_context_s blosc_context;   /* uncomplete type */
+typedef struct blosc2_threadpool_s blosc2_threadpool;   /* uncomplete type */
+typedef struct blosc2_async_s blosc2_async;   /* uncomplete type */
+typedef struct blosc2_cstream_s blosc2_cstream;   /* uncomplete type */
+
+/* Function called when an asynchronous call finishes */
+typedef void (*blosc2_async_cb)(blosc2_async* handle, int result,
+                                void* user_data);
+
+/**
+  A set of functions for managing the memory used internally.
+
+  `alignment` is a hint with the alignment (in bytes) that is desired for
+  the block; 0 means that no special alignment is needed.  Blosc asks for
+  32-byte alignment for its temporaries, so that SIMD code can work at
+  full speed on them, but it will work with any alignment.
+*/
+typedef struct {
+  void* (*malloc_fn)(size_t size, size_t alignment, void* user_data);
+  /* allocate a block of `size` bytes; return NULL if this fails */
+  void* (*realloc_fn)(void* ptr, size_t size, size_t alignment,
+                      void* user_data);
+  /* resize a block allocated by malloc_fn (only for super-chunks) */
+  void (*free_fn)(void* ptr, void* user_data);
+  /* release a block allocated by malloc_fn or realloc_fn */
+  void* user_data;
+  /* the data passed to the functions above */
+} blosc2_allocator;
+
+/**
+  Set the global allocator for the memory used internally by Blosc.
+
+  This allocator is used by the contexts (unless a different one is
+  specified in the `allocator` field of blosc2_context_cparams and
+  blosc2_context_dparams), the pools of threads, and the super-chunks
+  (including the buffers returned by blosc2_pack_schunk(),
+  blosc2_packed_append_chunk() and blosc2_packed_decompress_chunk()).
+  The allocator is copied, so it is picked up by objects created after
+  this call.  Super-chunks keep the allocator they were created with for
+  all their memory (including the contexts they create), so it can be
+  changed while they are alive.  Packed buffers, though, have to be freed
+  with the allocator that was set when they were created.
+
+  Passing NULL restores the built-in allocator.  All the functions of the
+  allocator must be set; otherwise a negative value is returned.
+*/
+BLOSC_EXPORT int blosc2_set_allocator(const blosc2_allocator* allocator);
 
 /**
   The parameters for creating a context for compression purposes.
@@ -551,11 +759,19 @@ typedef struct {
   /* the requested size of the compressed blocks (0; meaning automatic) */
   blosc2_sheader* schunk;
   /* the associated schunk, if any (NULL) */
+  blosc2_threadpool* threadpool;
+  /* the shared pool of threads to use, if any (NULL) */
+  const blosc2_allocator* allocator;
+  /* the allocator for the memory of the context (NULL; the global one) */
+  float tune_ratio_weight;
+  /* the weight of the compression ratio against the speed when compcode
+     is BLOSC_AUTO, from 0 (only speed) to 1 (only ratio); a negative
+     value means the default (0.5) */
 } blosc2_context_cparams;
 
 /* Default struct for compression params meant for user initialization */
 static const blosc2_context_cparams BLOSC_CPARAMS_DEFAULTS = \
-  { 8, BLOSC_BLOSCLZ, 5, BLOSC_SHUFFLE, 1, 0, NULL };
+  { 8, BLOSC_BLOSCLZ, 5, BLOSC_SHUFFLE, 1, 0, NULL, NULL, NULL, -1 };
 
 
 /**
@@ -569,22 +785,88 @@ typedef struct {
   /* the number of threads to use internally (1) */
   blosc2_sheader* schunk;
   /* the associated schunk, if any (NULL) */
+  blosc2_threadpool* threadpool;
+  /* the shared pool of threads to use, if any (NULL) */
+  const blosc2_allocator* allocator;
+  /* the allocator for the memory of the context (NULL; the global one) */
+  int32_t block_cache_nblocks;
+  /* the number of decompressed blocks to keep in a cache (0; no cache) */
 } blosc2_context_dparams;
 
 /* Default struct for compression params meant for user initialization */
 static const blosc2_context_dparams BLOSC_DPARAMS_DEFAULTS = \
-  { 1, NULL };
+  { 1, NULL, NULL, NULL, 0 };
+
+/**
+  Create a pool of `nthreads` threads that can be shared among many
+  contexts (see the `threadpool` field in blosc2_context_cparams and
+  blosc2_context_dparams).
+
+  A context attached to a pool does not start threads of its own.
+  Instead, its jobs are queued in the pool and the calling thread works
+  on them too, together with up to `nthreads` - 1 workers of the pool
+  (where `nthreads` is the one of the context).  Idle workers are spread
+  evenly among the jobs that are running concurrently.
+
+  A pointer to the new pool is returned.  NULL is returned if this fails.
+*/
+BLOSC_EXPORT blosc2_threadpool* blosc2_create_threadpool(int nthreads);
+
+/**
+  Same than blosc2_create_threadpool(), but the worker `i` of the pool is
+  pinned to the CPU `cpus[i % ncpus]`.
+
+  Pinned workers do not float between the sockets of NUMA machines, and
+  they touch their temporaries first, so these are placed in the memory
+  of their node.  For best results, pass CPUs of the same socket than
+  the data to be (de-)compressed.  Pinning is only supported on Linux;
+  in other platforms the threads are not pinned.
+
+  A pointer to the new pool is returned.  NULL is returned if this fails,
+  or if a CPU is negative or beyond the ones supported by the platform.
+*/
+BLOSC_EXPORT blosc2_threadpool* blosc2_create_threadpool_pinned(int nthreads,
+                                                                const int* cpus,
+                                                                int ncpus);
+
+/**
+  Stop the threads in a shared pool and release its resources.
+
+  All the contexts attached to the pool must have finished their jobs
+  (including the asynchronous ones) before calling this.
+*/
+BLOSC_EXPORT void blosc2_free_threadpool(blosc2_threadpool* pool);
 
 /**
   Create a context for *_ctx() compression functions.
 
-  A pointer to the new context is returned.  NULL is returned if this fails.
+  If `compcode` in `cparams` is BLOSC_AUTO, the context picks the codec,
+  the filter, the compression level and the blocksize (unless a
+  `blocksize` is passed) by itself.  For doing so, it trial-compresses a
+  sample of the buffer with different candidates, and keeps the one that
+  maximizes ratio^w * speed^(1-w), where `w` is `tune_ratio_weight`.  The
+  chosen params are reused until the size of the buffers or their
+  compression ratio change significantly.
+
+  A pointer to the new context is returned.  NULL is returned if this fails
+  (e.g. `tune_ratio_weight` is greater than 1).
 */
 BLOSC_EXPORT blosc_context* blosc2_create_cctx(blosc2_context_cparams* cparams);
 
 /**
   Create a context for *_ctx() decompression functions.
 
+  If `block_cache_nblocks` in `dparams` is positive, the context keeps
+  that many decompressed blocks in a LRU cache, so that repeated
+  getitems (or chunk reads) on hot chunks do not decompress the same
+  blocks over and over.  The cache is also used for fetching the delta
+  references of the super-chunk of the context.  Blocks are identified by
+  the address of their chunk and a hash of the chunk header, the block
+  starts and the first compressed bytes of the block, so a buffer can be
+  reused for reading other chunks.  The cache should still be cleared
+  with blosc2_clear_block_cache() if a chunk is rewritten in place with
+  the same layout.
+
   A pointer to the new context is returned.  NULL is returned if this fails.
 */
 BLOSC_EXPORT blosc_context* blosc2_create_dctx(blosc2_context_dparams* dparams);
@@ -637,11 +919,122 @@ BLOSC_EXPORT int blosc2_compress_ctx(
 BLOSC_EXPORT int blosc2_decompress_ctx(blosc_context* context, const void* src,
                                        void* dest, size_t destsize);
 
+/**
+  Same than blosc2_compress_ctx(), but `nbytes` can be larger than
+  BLOSC_MAX_BUFFERSIZE.
+
+  Such large buffers get an extended header (see BLOSC_VERSION_FORMAT_64)
+  with 64-bit sizes and block starts, so the overhead can be up to
+  BLOSC_EXTENDED_MAX_OVERHEAD bytes.  Buffers with extended headers can be
+  decompressed with the regular functions as long as their uncompressed
+  size fits in an int, and their items retrieved as long as their index
+  and the bytes fetched do; blosc2_decompress_ctx64() and
+  blosc2_getitem_ctx64() have no such limits.
+
+  Return the number of bytes compressed, 0 if the buffer does not fit in
+  `dest`, or a negative value if some error happens.
+*/
+BLOSC_EXPORT int64_t blosc2_compress_ctx64(
+  blosc_context* context, size_t nbytes, const void* src, void* dest,
+  size_t destsize);
+
+/**
+  Same than blosc2_decompress_ctx(), but for buffers with any size,
+  including the ones larger than BLOSC_MAX_BUFFERSIZE created by
+  blosc2_compress_ctx64().
+
+  Return the number of bytes decompressed, or 0 (zero) or a negative value
+  if some error happens.
+*/
+BLOSC_EXPORT int64_t blosc2_decompress_ctx64(
+  blosc_context* context, const void* src, void* dest, size_t destsize);
+
+/**
+  Compress `nbuffers` buffers in one call.  Buffer i is compressed from
+  `srcs[i]` (with `sizes[i]` bytes) into `dests[i]` (with room for
+  `destsizes[i]` bytes) exactly as blosc2_compress_ctx() would do, and
+  its return value is stored in `cbytes[i]`.
+
+  The blocks of all the buffers are handed out to the threads of the
+  context as a single job, so many buffers that are smaller than a block
+  are still compressed in parallel.
+
+  Returns 0 if all the buffers have been processed without errors, or
+  the (negative) error code of the first one that failed.
+*/
+BLOSC_EXPORT int blosc2_compress_batch(
+  blosc_context* context, int32_t nbuffers, const void* const* srcs,
+  const size_t* sizes, void* const* dests, const size_t* destsizes,
+  int* cbytes);
+
+/**
+  Decompress `nbuffers` buffers in one call.  Buffer i is decompressed
+  from `srcs[i]` into `dests[i]` (with room for `destsizes[i]` bytes)
+  exactly as blosc2_decompress_ctx() would do, and its return value is
+  stored in `nbytes[i]`.
+
+  The blocks of all the buffers are handed out to the threads of the
+  context as a single job.
+
+  Returns 0 if all the buffers have been processed without errors, or
+  the (negative) error code of the first one that failed.
+*/
+BLOSC_EXPORT int blosc2_decompress_batch(
+  blosc_context* context, int32_t nbuffers, const void* const* srcs,
+  void* const* dests, const size_t* destsizes, int* nbytes);
+
+/**
+  Asynchronous version of blosc2_compress_ctx().
+
+  The call is queued in the pool of threads of the context (its shared
+  pool, or else its private one, which is started if needed) and this
+  returns right away, so the calling thread can do other work (e.g. I/O)
+  while Blosc compresses.  The buffers must not be touched, and the
+  context must not be used, until the call has finished.
+
+  `callback`, if not NULL, is called with `user_data` from the thread
+  that ran the call, as soon as it finishes (but blosc2_async_wait()
+  must not be called on `handle` from there).
+
+  A handle for the call is returned, which must be released with
+  blosc2_async_wait().  NULL is returned if the call cannot be queued.
+*/
+BLOSC_EXPORT blosc2_async* blosc2_compress_ctx_async(
+  blosc_context* context, size_t nbytes, const void* src, void* dest,
+  size_t destsize, blosc2_async_cb callback, void* user_data);
+
+/**
+  Asynchronous version of blosc2_decompress_ctx().
+
+  See blosc2_compress_ctx_async() for details on the parameters and the
+  returned handle.
+*/
+BLOSC_EXPORT blosc2_async* blosc2_decompress_ctx_async(
+  blosc_context* context, const void* src, void* dest, size_t destsize,
+  blosc2_async_cb callback, void* user_data);
+
+/**
+  Return 1 if the asynchronous call of `handle` has finished, 0 otherwise.
+  This never blocks.
+*/
+BLOSC_EXPORT int blosc2_async_poll(blosc2_async* handle);
+
+/**
+  Wait until the asynchronous call of `handle` finishes and release the
+  handle.
+
+  Returns the value that blosc2_compress_ctx() or blosc2_decompress_ctx()
+  would have returned.
+*/
+BLOSC_EXPORT int blosc2_async_wait(blosc2_async* handle);
+
 /**
   Context interface counterpart for blosc_getitem().
 
   It uses similar parameters than the blosc_getitem() function plus a
-  `context` parameter.
+  `context` parameter.  When the items span several blocks and the
+  context has more than one thread, the blocks are decompressed in
+  parallel (straight into `dest`, except for the ones at the edges).
 
   Returns the number of bytes copied to `dest` or a negative value if
   some error happens.
@@ -649,6 +1042,210 @@ BLOSC_EXPORT int blosc2_decompress_ctx(blosc_context* context, const void* src,
 BLOSC_EXPORT int blosc2_getitem_ctx(blosc_context* context, const void* src,
                                     int start, int nitems, void* dest);
 
+/**
+  Same than blosc2_getitem_ctx(), but `start` and `nitems` are 64-bit,
+  so that every item of the buffers larger than BLOSC_MAX_BUFFERSIZE
+  created by blosc2_compress_ctx64() can be reached.
+
+  Returns the number of bytes copied to `dest` or a negative value if
+  some error happens.
+*/
+BLOSC_EXPORT int64_t blosc2_getitem_ctx64(blosc_context* context,
+                                          const void* src, int64_t start,
+                                          int64_t nitems, void* dest);
+
+/**
+  The counters of the cache of blocks of a context (see
+  blosc2_get_block_cache_stats()).
+*/
+typedef struct {
+  int64_t hits;
+  /* the number of blocks found in the cache */
+  int64_t misses;
+  /* the number of blocks that had to be decompressed */
+  int32_t nblocks;
+  /* the number of blocks in the cache */
+} blosc2_block_cache_stats;
+
+/**
+  Get the counters of the cache of decompressed blocks of `context` into
+  `stats`.
+
+  Returns 0 on success or a negative value if the context has no cache.
+*/
+BLOSC_EXPORT int blosc2_get_block_cache_stats(blosc_context* context,
+                                              blosc2_block_cache_stats* stats);
+
+/**
+  Drop all the blocks in the cache of decompressed blocks of `context`
+  (if any).  The counters are kept.
+*/
+BLOSC_EXPORT void blosc2_clear_block_cache(blosc_context* context);
+
+/**
+  Get many ranges of items out of the same compressed buffer at once.
+
+  Range `i` has `nitems[i]` items starting at item `starts[i]`.  The
+  ranges are stored one after the other in `dest`, in the same order
+  than they are passed.  Ranges may overlap and do not need to be sorted.
+
+  This is faster than calling blosc2_getitem_ctx() for every range,
+  because the header is read only once and every block holding items is
+  decompressed only once.  When the context has more than one thread, the
+  blocks are decompressed in parallel.
+
+  Returns the number of bytes copied to `dest` or a negative value if
+  some error happens (e.g. some range is out of bounds).
+*/
+BLOSC_EXPORT int blosc2_getitems_ctx(blosc_context* context, const void* src,
+                                     const int* starts, const int* nitems,
+                                     int n, void* dest);
+
+/**
+  The decision taken for the blocksize (see blosc2_get_blocksize_info()).
+*/
+typedef struct {
+  int32_t blocksize;
+  /* the blocksize that is used for the buffer */
+  int32_t l1_size;
+  /* the size of the L1 data cache (32 KB if it cannot be detected) */
+  int32_t l2_size;
+  /* the size of the L2 cache (0 if it cannot be detected) */
+  int32_t l3_size;
+  /* the size of the L3 cache (0 if it cannot be detected) */
+  int32_t nblocks_in_use;
+  /* the blocks that every thread keeps in use for the codec and filter */
+} blosc2_blocksize_info;
+
+/**
+  Tell the blocksize that the compression `context` would use for a
+  buffer of `nbytes` bytes, and why.
+
+  Unless it is forced, the blocksize starts from the size of the L1 data
+  cache and is scaled by the compression level (and doubled for codecs
+  meant for high compression ratios).  Then it is limited so that the
+  blocks that every thread keeps in use fit in the L2 cache.  The cache
+  sizes are detected at runtime (via sysfs or sysconf() on Linux, and
+  GetLogicalProcessorInformation() on Windows).
+
+  The details are stored in `info` and the blocksize is returned.  A
+  negative value is returned if `context` is not meant for compression.
+*/
+BLOSC_EXPORT int blosc2_get_blocksize_info(blosc_context* context,
+                                           size_t nbytes,
+                                           blosc2_blocksize_info* info);
+
+/* Function receiving the chunks produced by a compression stream.  The
+   chunk is only valid during the call.  A negative return value aborts
+   the stream call that produced the chunk with that value. */
+typedef int (*blosc2_cstream_output)(const void* chunk, int32_t cbytes,
+                                     void* user_data);
+
+/**
+  Create a stream for compressing an input of unbounded size that
+  arrives in pieces of any size (see blosc2_cstream_write()).
+
+  The input is cut in chunks of `chunksize` bytes that are compressed
+  with the params of the compression `context`.  Every block is
+  compressed as soon as it is filled, so the stream only keeps a block of
+  input and the chunk being built in memory.  Finished chunks are passed
+  to `output` (with `user_data`) or, if `output` is NULL, appended to the
+  super-chunk of `context`.  Super-chunks with the delta filter need their
+  delta reference set (see blosc2_set_delta_ref()) beforehand.
+
+  `chunksize` must not exceed BLOSC_MAX_BUFFERSIZE, and the autotuner
+  (BLOSC_AUTO) is not supported.  The context should not be used for
+  anything else until the stream ends.
+
+  A pointer to the new stream is returned.  NULL is returned if this fails.
+*/
+BLOSC_EXPORT blosc2_cstream* blosc2_create_cstream(blosc_context* context,
+                                                   int32_t chunksize,
+                                                   blosc2_cstream_output output,
+                                                   void* user_data);
+
+/**
+  Add the `nbytes` bytes in `src` to the compression `stream`.
+
+  Returns the number of chunks that have been finished during the call or
+  a negative value if some error happens.
+*/
+BLOSC_EXPORT int blosc2_cstream_write(blosc2_cstream* stream, const void* src,
+                                      size_t nbytes);
+
+/**
+  Finish the chunk being built by `stream` with the input that has been
+  written so far, even if it is smaller than `chunksize` (nothing is done
+  if there is no pending input).
+
+  Returns the number of chunks finished (0 or 1) or a negative value if
+  some error happens.
+*/
+BLOSC_EXPORT int blosc2_cstream_flush(blosc2_cstream* stream);
+
+/**
+  Flush `stream` and release its resources.
+
+  Returns the same than blosc2_cstream_flush().
+*/
+BLOSC_EXPORT int blosc2_cstream_end(blosc2_cstream* stream);
+
+/* Function reading up to `nbytes` bytes of compressed input into `buf`
+   for a streaming decompression.  It returns the number of bytes read
+   (which may be less than `nbytes`), 0 at the end of the input, or a
+   negative value if some error happens. */
+typedef int64_t (*blosc2_dstream_read)(void* buf, int64_t nbytes,
+                                       void* user_data);
+
+/* Function receiving the decompressed data of a streaming decompression.
+   The data is only valid during the call.  A negative return value
+   aborts the decompression with that value. */
+typedef int (*blosc2_dstream_output)(const void* data, int32_t nbytes,
+                                     void* user_data);
+
+/**
+  A blosc2_dstream_read function that reads from the file descriptor
+  pointed by `user_data` (an `int*`).
+*/
+BLOSC_EXPORT int64_t blosc2_dstream_read_fd(void* buf, int64_t nbytes,
+                                            void* user_data);
+
+/**
+  Decompress a sequence of chunks (like the ones written by a compression
+  stream) that is read incrementally with `read` (and `read_data`) until
+  the input ends.
+
+  The decompressed blocks are passed to `output` (with `output_data`) in
+  order, as soon as their compressed bytes have been read.  Only the
+  compressed bytes between the first block not passed yet and the block
+  being decompressed are kept in memory, which for chunks compressed by a
+  single thread is about a block.  The blocks are decompressed serially
+  with the params of the decompression `context` (its super-chunk is used
+  for the delta filter, but its cache of blocks is not).
+
+  Returns the number of decompressed bytes or a negative value if some
+  error happens (including the input ending in the middle of a chunk).
+*/
+BLOSC_EXPORT int64_t blosc2_decompress_stream(blosc_context* context,
+                                              blosc2_dstream_read read,
+                                              void* read_data,
+                                              blosc2_dstream_output output,
+                                              void* output_data);
+
+/**
+  Same than blosc2_decompress_stream(), but for a packed super-chunk (see
+  blosc2_pack_schunk()) whose chunks are decompressed one after the other.
+
+  The delta reference (if any) is kept in memory, and the offsets of the
+  chunks at the end of the packed super-chunk are not read.
+
+  Returns the number of decompressed bytes or a negative value if some
+  error happens.
+*/
+BLOSC_EXPORT int64_t blosc2_decompress_packed_stream(
+    blosc_context* context, blosc2_dstream_read read, void* read_data,
+    blosc2_dstream_output output, void* output_data);
+
 
 /*********************************************************************
 
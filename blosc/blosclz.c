@@ -86,6 +86,7 @@
 #endif
 
 #define MAX_COPY       32
+#define MAX_HASH_LOG   14
 #define MAX_DISTANCE 8191
 #define MAX_FARDISTANCE (65535+MAX_DISTANCE-1)
 
@@ -181,7 +182,8 @@ int blosclz_compress(const int opt_level, const void* input, int length,
   uint8_t* ip_limit = ip + length - 12;
   uint8_t* op = (uint8_t*)output;
 
-  /* Hash table depends on the opt level.  Hash_log cannot be larger than 15. */
+  /* Hash table depends on the opt level.  Hash_log cannot be larger than
+     MAX_HASH_LOG. */
   /* The parametrization below is made from playing with the bench suite, like:
      $ bench/bench blosclz single 4
      $ bench/bench blosclz single 4 4194280 12 25
@@ -191,7 +193,9 @@ int blosclz_compress(const int opt_level, const void* input, int length,
   int8_t hash_log_[10] = {-1, 11, 11, 11, 12, 13, 14, 14, 14, 14};
   uint8_t hash_log = hash_log_[opt_level];
   uint16_t hash_size = 1 << hash_log;
-  uint16_t* htab;
+  /* The hash table lives in the stack, so that compressing does not
+     need any heap allocation */
+  uint16_t htab[1 << MAX_HASH_LOG];
   uint8_t* op_limit;
 
   int32_t hval;
@@ -213,7 +217,7 @@ int blosclz_compress(const int opt_level, const void* input, int length,
   accel = accel < 1 ? 1 : accel;
   accel -= 1;
 
-  htab = (uint16_t*)calloc(hash_size, sizeof(uint16_t));
+  memset(htab, 0, hash_size * sizeof(uint16_t));
 
   /* we start with literal copy */
   copy = 2;
@@ -409,11 +413,9 @@ int blosclz_compress(const int opt_level, const void* input, int length,
   /* marker for blosclz */
   *(uint8_t*)output |= (1 << 5);
 
-  free(htab);
   return (int)(op - (uint8_t*)output);
 
   out:
-  free(htab);
   return 0;
 
 }
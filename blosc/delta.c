@@ -16,41 +16,38 @@
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 
 
-/* Apply the delta filters to src.  This can never fail. */
-void delta_encoder8(uint8_t* filters_chunk, int32_t offset, int32_t nbytes,
-                    uint8_t* src, uint8_t* dest) {
+/* Apply the delta filters to src.  This can never fail.
+
+   The reference is decompressed straight into dest by using `dctx`, a
+   decompression context that the caller keeps around, so that no memory
+   is allocated here. */
+void delta_encoder8(blosc_context* dctx, uint8_t* filters_chunk,
+                    int64_t offset, int32_t nbytes, uint8_t* src,
+                    uint8_t* dest) {
   int i;
   uint8_t typesize = *(uint8_t*)(filters_chunk + 3);
   int32_t rbytes = *(int32_t*)(filters_chunk + 4);
   int32_t mbytes;
   int32_t cpy_bytes;
-  uint8_t* dref;
-  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
-  blosc_context *dctx;
 
-  mbytes = MIN(nbytes, rbytes - offset);
+  mbytes = (offset >= rbytes) ?
+           0 : (int32_t)MIN((int64_t)nbytes, rbytes - offset);
   if (mbytes > 0) {
-    /* Fetch mbytes from reference frame */
-    dref = malloc((size_t)mbytes);
     if ((mbytes % typesize) != 0) {
-      printf("nbytes is not a multiple of typesize (delta_decoder8).  Please report this!\n");
+      printf("nbytes is not a multiple of typesize (delta_encoder8).  Please report this!\n");
       return;
     }
-    /* Create a context for decompressing the interesting part of the reference */
-    dparams.nthreads = 1;  /* we don't want to interfere with existing threads */
-    dctx = blosc2_create_dctx(&dparams);
-    cpy_bytes = blosc2_getitem_ctx(dctx, filters_chunk, offset / typesize, mbytes / typesize, dref);
-    blosc2_free_ctx(dctx);
+    /* Fetch mbytes from reference frame */
+    cpy_bytes = blosc2_getitem_ctx(dctx, filters_chunk, (int)(offset / typesize), mbytes / typesize, dest);
     if (cpy_bytes != mbytes) {
-      printf("Error in getting items (delta_decoder8).  Please report this!\n");
+      printf("Error in getting items (delta_encoder8).  Please report this!\n");
       return;
     }
 
     /* Encode delta */
     for (i = 0; i < mbytes; i++) {
-      dest[i] = src[i] - dref[i];
+      dest[i] = src[i] - dest[i];
     }
-    free(dref);
   }
 
   /* Copy the leftovers */
@@ -61,30 +58,28 @@ void delta_encoder8(uint8_t* filters_chunk, int32_t offset, int32_t nbytes,
 }
 
 
-/* Undo the delta filter in dest.  This can never fail. */
-void delta_decoder8(uint8_t* filters_chunk, int32_t offset, int32_t nbytes, uint8_t* dest) {
+/* Undo the delta filter in dest.  This can never fail.
+
+   The reference is decompressed into `dref` (with room for `nbytes`
+   at least) by using the decompression context `dctx`. */
+void delta_decoder8(blosc_context* dctx, uint8_t* filters_chunk,
+                    int64_t offset, int32_t nbytes, uint8_t* dest,
+                    uint8_t* dref) {
   int i;
   uint8_t typesize = *(uint8_t*)(filters_chunk + 3);
   int32_t rbytes = *(int32_t*)(filters_chunk + 4);
   int32_t mbytes;
   int32_t cpy_bytes;
-  uint8_t* dref;
-  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
-  blosc_context *dctx;
 
-  mbytes = MIN(nbytes, rbytes - offset);
+  mbytes = (offset >= rbytes) ?
+           0 : (int32_t)MIN((int64_t)nbytes, rbytes - offset);
   if (mbytes > 0) {
-    /* Fetch mbytes from reference frame */
-    dref = malloc((size_t)mbytes);
     if ((mbytes % typesize) != 0) {
       printf("nbytes is not a multiple of typesize (delta_decoder8).  Please report this!\n");
       return;
     }
-    /* Create a context for decompressing the interesting part of the reference */
-    dparams.nthreads = 1;  /* we don't want to interfere with existing threads */
-    dctx = blosc2_create_dctx(&dparams);
-    cpy_bytes = blosc2_getitem_ctx(dctx, filters_chunk, offset / typesize, mbytes / typesize, dref);
-    blosc2_free_ctx(dctx);
+    /* Fetch mbytes from reference frame */
+    cpy_bytes = blosc2_getitem_ctx(dctx, filters_chunk, (int)(offset / typesize), mbytes / typesize, dref);
     if (cpy_bytes != mbytes) {
       printf("Error in getting items (delta_decoder8).  Please report this!\n");
       return;
@@ -94,7 +89,6 @@ void delta_decoder8(uint8_t* filters_chunk, int32_t offset, int32_t nbytes, uint
     for (i = 0; i < mbytes; i++) {
       dest[i] += dref[i];
     }
-    free(dref);
   }
 
   /* The leftovers are in-place already */
@@ -9,8 +9,12 @@
 #ifndef BLOSC_DELTA_H
 #define BLOSC_DELTA_H
 
-void delta_encoder8(uint8_t* filters_chunk, int32_t offset, int32_t nbytes, uint8_t* src, uint8_t* dest);
+#include "blosc.h"
 
-void delta_decoder8(uint8_t* filters_chunk, int32_t offset, int32_t nbytes, uint8_t* src);
+void delta_encoder8(blosc_context* dctx, uint8_t* filters_chunk, int64_t offset,
+                    int32_t nbytes, uint8_t* src, uint8_t* dest);
+
+void delta_decoder8(blosc_context* dctx, uint8_t* filters_chunk, int64_t offset,
+                    int32_t nbytes, uint8_t* dest, uint8_t* dref);
 
 #endif //BLOSC_DELTA_H
@@ -13,7 +13,10 @@
 #include <string.h>
 #include <assert.h>
 #include "blosc.h"
+#include "schunk.h"
 #include "delta.h"
+#include "blosc-private.h"
+#include "blosc-atomic.h"
 
 
 #if defined(_WIN32) && !defined(__MINGW32__)
@@ -35,6 +38,146 @@
 #endif
 
 
+#if defined(_WIN32)
+  #include <windows.h>
+#else
+  #include <fcntl.h>
+  #include <unistd.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+#endif
+
+
+#if defined(_WIN32)
+  #define fseek64(fp, pos) _fseeki64(fp, pos, SEEK_SET)
+#else
+  #define fseek64(fp, pos) fseeko(fp, (off_t)(pos), SEEK_SET)
+#endif
+
+/* The length of the header of packed super-chunks (and super-chunk files) */
+#define PACKED_HEADER_LENGTH ((int64_t)sizeof(blosc2_sheader))
+
+
+/* The state of a super-chunk whose chunks live in a file (see
+   blosc2_new_schunk_file()).  The file has the layout of a packed
+   super-chunk: the header, the filters chunk, the data chunks in order
+   and their offsets at the end.  Appends only write the data chunks; the
+   offsets and the header are written by blosc2_sync_schunk_file(). */
+typedef struct {
+  FILE* fp;
+  int64_t* offsets;
+  int64_t maxchunks;
+  /* the offsets of the data chunks in the file and the room for them */
+  int64_t filters_offset;
+  /* the position of the filters chunk (0 if none) */
+  int64_t data_end;
+  /* the end of the last data chunk, where the offsets start */
+  int64_t nbytes;
+  /* the uncompressed size of the packed super-chunk */
+  uint8_t* chunk;
+  int32_t chunk_size;
+  /* a buffer for reading chunks */
+  int dirty;
+  /* whether chunks were appended after the offsets were written */
+} schunk_file;
+
+/* The maximum number of chunk pointer arrays that a super-chunk retires
+   (these double in size every time) */
+#define MAX_RETIRED 64
+
+/* The maximum number of chunks that blosc2_decompress_chunks() decompresses
+   in a single job */
+#define DECOMPRESS_CHUNKS_BATCH 256
+
+/* The internal state of a super-chunk.  It is hooked in the `reserved`
+   field of the header, and created by the first call that needs it. */
+typedef struct {
+  int64_t maxchunks;
+  /* the room in the array of chunk pointers (`data`) */
+  uint8_t** retired[MAX_RETIRED];
+  int nretired;
+  /* the arrays of chunk pointers replaced by larger ones.  Readers may
+     still be using them, so they are freed with the super-chunk. */
+  schunk_file* file;
+  /* the file of the super-chunk, if any */
+  int nthreads;
+  blosc2_threadpool* pool;
+  /* the threads for (de-)compressing chunks.  The pool is shared with
+     the super-chunks with the same number of threads, and it is taken
+     by the first (de-)compression (see get_pool()). */
+  blosc_context* cctx;
+  size_t cctx_typesize;
+  /* the context for compressing appended buffers and its typesize */
+  blosc_context* dctx;
+  /* a spare context for decompressing chunks.  Readers take it while they
+     use it, so concurrent readers create contexts of their own. */
+  int32_t block_cache_nblocks;
+  /* the size of the cache of blocks of the decompression contexts */
+  blosc2_allocator allocator;
+  /* the allocator of the memory of the super-chunk (the global one when
+     it was created), so that it can be changed meanwhile */
+} schunk_state;
+
+#define SCHUNK_STATE(sheader) ((schunk_state*)(sheader)->reserved)
+#define SCHUNK_FILE(sheader) \
+  (((sheader)->reserved != NULL) ? SCHUNK_STATE(sheader)->file : NULL)
+/* The allocator of a super-chunk (the global one if it has no state) */
+#define SCHUNK_ALLOCATOR(sheader) \
+  (((sheader)->reserved != NULL) ? &SCHUNK_STATE(sheader)->allocator : NULL)
+
+
+/* Create the internal state of a super-chunk that uses `nthreads` threads
+   for (de-)compressing its chunks and `allocator` for its memory */
+static schunk_state* new_state(blosc2_sheader* sheader, int nthreads,
+                               const blosc2_allocator* allocator) {
+  schunk_state* state = blosc_malloc(allocator, sizeof(schunk_state));
+
+  memset(state, 0, sizeof(schunk_state));
+  state->allocator = *allocator;
+  /* The chunk pointers of unpacked super-chunks have no room left */
+  state->maxchunks = (sheader->data != NULL) ? sheader->nchunks : 0;
+  state->nthreads = (nthreads > 1) ? nthreads : 1;
+  sheader->reserved = (uint8_t*)state;
+  return state;
+}
+
+
+/* Get the internal state of a super-chunk, creating it if needed */
+static schunk_state* get_state(blosc2_sheader* sheader) {
+  schunk_state* state = SCHUNK_STATE(sheader);
+  blosc2_allocator allocator;
+
+  if (state == NULL) {
+    blosc_get_allocator(&allocator);
+    state = new_state(sheader, blosc_get_nthreads(), &allocator);
+  }
+  return state;
+}
+
+
+/* Get the pool of threads of a super-chunk, taking the shared one for its
+   number of threads the first time.  NULL is returned if the super-chunk
+   has a single thread or if the pool cannot be started. */
+static blosc2_threadpool* get_pool(schunk_state* state) {
+  blosc2_threadpool* pool = BLOSC_ATOMIC_LOADPTR(&state->pool);
+
+  if (pool == NULL && state->nthreads > 1) {
+    pool = blosc_acquire_shared_pool(state->nthreads);
+    if (pool != NULL && BLOSC_ATOMIC_XCHGPTR(&state->pool, pool) != NULL) {
+      /* Another reader took it meanwhile (it is the same pool) */
+      blosc_release_shared_pool(pool);
+    }
+  }
+  return pool;
+}
+
+
+/* The allocator of the memory of a super-chunk */
+const blosc2_allocator* schunk_allocator(blosc2_sheader* sheader) {
+  return SCHUNK_ALLOCATOR(sheader);
+}
+
+
 /* Encode filters in a 16 bit int type */
 uint16_t encode_filters(blosc2_sparams* params) {
   int i;
@@ -48,23 +191,89 @@ uint16_t encode_filters(blosc2_sparams* params) {
 }
 
 
-/* Decode filters.  The returned array must be freed after use.  */
-uint8_t* decode_filters(uint16_t enc_filters) {
+/* Decode filters into `filters` (BLOSC_MAX_FILTERS items).  */
+void decode_filters(uint16_t enc_filters, uint8_t* filters) {
   int i;
-  uint8_t* filters = malloc(BLOSC_MAX_FILTERS);
 
   /* Decode the BLOSC_MAX_FILTERS filters (3-bit encoded) in 16 bit */
   for (i = 0; i < BLOSC_MAX_FILTERS; i++) {
     filters[i] = (uint8_t)(enc_filters & 0x3);
     enc_filters >>= 3;
   }
-  return filters;
+}
+
+
+/* Create a context for compressing buffers with the codec and the filters
+   of a super-chunk.  The delta filter is only applied if `schunk` is
+   passed.  The context memory comes from `allocator` (the global one if
+   NULL). */
+static blosc_context* create_cctx(int compcode, int clevel, uint16_t filters,
+                                  size_t typesize, blosc2_sheader* schunk,
+                                  int nthreads, blosc2_threadpool* pool,
+                                  const blosc2_allocator* allocator) {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  uint8_t dec_filters[BLOSC_MAX_FILTERS];
+
+  decode_filters(filters, dec_filters);
+  cparams.filtercode = (dec_filters[0] == BLOSC_DELTA) ?
+                       dec_filters[1] : dec_filters[0];
+  cparams.compcode = (uint8_t)compcode;
+  cparams.clevel = (uint8_t)clevel;
+  /* Like blosc_compress(), large typesizes are handled as a stream of bytes */
+  cparams.typesize = (uint8_t)((typesize > BLOSC_MAX_TYPESIZE) ? 1 : typesize);
+  cparams.nthreads = (uint8_t)nthreads;
+  cparams.schunk = schunk;
+  cparams.threadpool = pool;
+  cparams.allocator = allocator;
+  return blosc2_create_cctx(&cparams);
+}
+
+
+/* Take a context for decompressing the chunks of a super-chunk.  It has
+   to be given back with release_dctx(). */
+static blosc_context* acquire_dctx(blosc2_sheader* sheader) {
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  schunk_state* state = SCHUNK_STATE(sheader);
+  blosc_context* dctx = NULL;
+
+  if (state != NULL) {
+    dctx = BLOSC_ATOMIC_XCHGPTR(&state->dctx, NULL);
+    dparams.threadpool = get_pool(state);
+    dparams.nthreads = (uint8_t)((dparams.threadpool != NULL) ?
+                                 state->nthreads : 1);
+    dparams.block_cache_nblocks = state->block_cache_nblocks;
+    dparams.allocator = &state->allocator;
+  }
+  if (dctx == NULL) {
+    dparams.schunk = sheader;
+    dctx = blosc2_create_dctx(&dparams);
+  }
+  return dctx;
+}
+
+
+/* Give back a context taken with acquire_dctx() */
+static void release_dctx(blosc2_sheader* sheader, blosc_context* dctx) {
+  schunk_state* state = SCHUNK_STATE(sheader);
+
+  if (state != NULL) {
+    /* Keep it as the spare one (there is one at most) */
+    dctx = BLOSC_ATOMIC_XCHGPTR(&state->dctx, dctx);
+  }
+  if (dctx != NULL) {
+    blosc2_free_ctx(dctx);
+  }
 }
 
 
 /* Create a new super-chunk */
 blosc2_sheader* blosc2_new_schunk(blosc2_sparams* sparams) {
-  blosc2_sheader* sheader = calloc(1, sizeof(blosc2_sheader));
+  blosc2_allocator allocator;
+  blosc2_sheader* sheader;
+
+  blosc_get_allocator(&allocator);
+  sheader = blosc_malloc(&allocator, sizeof(blosc2_sheader));
+  memset(sheader, 0, sizeof(blosc2_sheader));
 
   sheader->version = 0;     /* pre-first version */
   sheader->filters = encode_filters(sparams);
@@ -73,23 +282,244 @@ blosc2_sheader* blosc2_new_schunk(blosc2_sparams* sparams) {
   sheader->clevel = sparams->clevel;
   sheader->cbytes = sizeof(blosc2_sheader);
   /* The rest of the structure will remain zeroed */
+  new_state(sheader, sparams->nthreads ? sparams->nthreads :
+                                          blosc_get_nthreads(), &allocator)
+      ->block_cache_nblocks = sparams->block_cache_nblocks;
 
   return sheader;
 }
 
 
-/* Append an existing chunk into a super-chunk. */
+/* Write the header of a super-chunk file */
+static int write_file_header(blosc2_sheader* sheader) {
+  schunk_file* sfile = SCHUNK_FILE(sheader);
+  uint8_t header[PACKED_HEADER_LENGTH];
+
+  memset(header, 0, PACKED_HEADER_LENGTH);
+  memcpy(header, sheader, 16);    /* copy until nchunks */
+  *(int64_t*)(header + 16) = sheader->nchunks;
+  *(int64_t*)(header + 24) = sfile->nbytes;
+  *(int64_t*)(header + 32) = sfile->data_end + sheader->nchunks * sizeof(int64_t);
+  *(int64_t*)(header + 40) = sfile->filters_offset;
+  *(int64_t*)(header + 72) = sfile->data_end;
+  if (fseek64(sfile->fp, 0) != 0 ||
+      fwrite(header, 1, PACKED_HEADER_LENGTH, sfile->fp) != PACKED_HEADER_LENGTH) {
+    return -1;
+  }
+  return 0;
+}
+
+
+/* Create a new super-chunk whose chunks are appended to a file */
+blosc2_sheader* blosc2_new_schunk_file(blosc2_sparams* sparams,
+                                       const char* path) {
+  blosc2_sheader* sheader;
+  schunk_file* sfile;
+  FILE* fp = fopen(path, "w+b");
+
+  if (fp == NULL) {
+    fprintf(stderr, "Cannot create the super-chunk file '%s'\n", path);
+    return NULL;
+  }
+  sheader = blosc2_new_schunk(sparams);
+  sfile = blosc_malloc(SCHUNK_ALLOCATOR(sheader), sizeof(schunk_file));
+  memset(sfile, 0, sizeof(schunk_file));
+  sfile->fp = fp;
+  sfile->data_end = PACKED_HEADER_LENGTH;
+  sfile->nbytes = PACKED_HEADER_LENGTH;
+  get_state(sheader)->file = sfile;
+  if (write_file_header(sheader) < 0 || fflush(fp) != 0) {
+    fprintf(stderr, "Cannot write to the super-chunk file '%s'\n", path);
+    blosc2_destroy_schunk(sheader);
+    return NULL;
+  }
+  return sheader;
+}
+
+
+/* Open a super-chunk file.  Only the header, the filters chunk and the
+   offsets of the data chunks are read. */
+blosc2_sheader* blosc2_open_schunk_file(const char* path) {
+  uint8_t header[PACKED_HEADER_LENGTH];
+  blosc2_allocator allocator;
+  blosc2_sheader* sheader;
+  schunk_file* sfile;
+  int64_t nchunks, filters_offset;
+  int32_t cbytes;
+  FILE* fp = fopen(path, "r+b");
+
+  if (fp == NULL) {
+    fprintf(stderr, "Cannot open the super-chunk file '%s'\n", path);
+    return NULL;
+  }
+  if (fread(header, 1, PACKED_HEADER_LENGTH, fp) != PACKED_HEADER_LENGTH) {
+    fprintf(stderr, "Cannot read the header of the super-chunk file '%s'\n", path);
+    fclose(fp);
+    return NULL;
+  }
+
+  blosc_get_allocator(&allocator);
+  sheader = blosc_malloc(&allocator, sizeof(blosc2_sheader));
+  memset(sheader, 0, sizeof(blosc2_sheader));
+  memcpy(sheader, header, 40);    /* copy until cbytes */
+  sfile = blosc_malloc(&allocator, sizeof(schunk_file));
+  memset(sfile, 0, sizeof(schunk_file));
+  sfile->fp = fp;
+  new_state(sheader, blosc_get_nthreads(), &allocator)->file = sfile;
+  nchunks = sheader->nchunks;
+  filters_offset = *(int64_t*)(header + 40);
+  sfile->filters_offset = filters_offset;
+  sfile->data_end = *(int64_t*)(header + 72);
+  /* The sizes in the header are the ones of the packed super-chunk */
+  sfile->nbytes = sheader->nbytes;
+  sheader->nbytes -= PACKED_HEADER_LENGTH + nchunks * (int64_t)sizeof(int64_t);
+
+  /* The filters chunk is needed for decompressing */
+  if (filters_offset != 0) {
+    if (fseek64(fp, filters_offset + 12) != 0 ||
+        fread(&cbytes, sizeof(int32_t), 1, fp) != 1) {
+      goto error;
+    }
+    sheader->filters_chunk = blosc_malloc(&allocator, (size_t)cbytes);
+    if (fseek64(fp, filters_offset) != 0 ||
+        fread(sheader->filters_chunk, 1, (size_t)cbytes, fp) != (size_t)cbytes) {
+      goto error;
+    }
+    sheader->nbytes -= *(int32_t*)(sheader->filters_chunk + 4);
+  }
+
+  /* And the offsets of the data chunks */
+  sfile->maxchunks = (nchunks > 64) ? nchunks : 64;
+  sfile->offsets = blosc_malloc(&allocator,
+                                (size_t)sfile->maxchunks * sizeof(int64_t));
+  if (fseek64(fp, sfile->data_end) != 0 ||
+      fread(sfile->offsets, sizeof(int64_t), (size_t)nchunks, fp) != (size_t)nchunks) {
+    goto error;
+  }
+  if (*(int64_t*)(header + 80) != 0) {
+    /* A packed super-chunk with room reserved: the data chunks end before
+       the room, not at the offsets */
+    if (nchunks > 0) {
+      if (fseek64(fp, sfile->offsets[nchunks - 1] + 12) != 0 ||
+          fread(&cbytes, sizeof(int32_t), 1, fp) != 1) {
+        goto error;
+      }
+      sfile->data_end = sfile->offsets[nchunks - 1] + cbytes;
+    }
+    else if (filters_offset != 0) {
+      sfile->data_end = filters_offset + *(int32_t*)(sheader->filters_chunk + 12);
+    }
+    else {
+      sfile->data_end = PACKED_HEADER_LENGTH;
+    }
+  }
+  sheader->cbytes = sfile->data_end;
+  return sheader;
+
+  error:
+  fprintf(stderr, "The super-chunk file '%s' is corrupted\n", path);
+  blosc2_destroy_schunk(sheader);
+  return NULL;
+}
+
+
+/* Write `chunk` at the end of the data of a super-chunk file.  Its offset
+   is only kept in memory until the file is synced. */
+static int append_file_chunk(blosc2_sheader* sheader, void* chunk) {
+  schunk_file* sfile = SCHUNK_FILE(sheader);
+  int64_t nchunks = sheader->nchunks;
+  int32_t nbytes = *(int32_t*)((uint8_t*)chunk + 4);
+  int32_t cbytes = *(int32_t*)((uint8_t*)chunk + 12);
+
+  if (nchunks == sfile->maxchunks) {
+    sfile->maxchunks = (sfile->maxchunks > 0) ? 2 * sfile->maxchunks : 64;
+    sfile->offsets = blosc_realloc(SCHUNK_ALLOCATOR(sheader), sfile->offsets,
+                                   (size_t)sfile->maxchunks * sizeof(int64_t));
+  }
+  sfile->offsets[nchunks] = sfile->data_end;
+  sfile->dirty = 1;
+  if (fseek64(sfile->fp, sfile->data_end) != 0 ||
+      fwrite(chunk, 1, (size_t)cbytes, sfile->fp) != (size_t)cbytes) {
+    return -1;
+  }
+  sfile->data_end += cbytes;
+  sfile->nbytes += nbytes + sizeof(int64_t);
+  sheader->nchunks = nchunks + 1;
+  sheader->nbytes += nbytes;
+  sheader->cbytes += cbytes;
+  return 0;
+}
+
+
+/* Write the offsets of the data chunks and the header of a super-chunk
+   file, so that it is a valid packed super-chunk. */
+int blosc2_sync_schunk_file(blosc2_sheader* sheader) {
+  schunk_file* sfile = SCHUNK_FILE(sheader);
+  size_t nchunks = (size_t)sheader->nchunks;
+
+  if (sfile == NULL) {
+    fprintf(stderr, "The super-chunk is not backed by a file\n");
+    return -1;
+  }
+  if (!sfile->dirty) {
+    return 0;
+  }
+  if (fseek64(sfile->fp, sfile->data_end) != 0 ||
+      fwrite(sfile->offsets, sizeof(int64_t), nchunks, sfile->fp) != nchunks ||
+      write_file_header(sheader) < 0 || fflush(sfile->fp) != 0) {
+    fprintf(stderr, "Cannot write the offsets to the super-chunk file\n");
+    return -1;
+  }
+  sfile->dirty = 0;
+  return 0;
+}
+
+
+/* Append an existing chunk into a super-chunk.  The super-chunk takes
+   the ownership of `chunk`. */
 size_t append_chunk(blosc2_sheader* sheader, void* chunk) {
   int64_t nchunks = sheader->nchunks;
   /* The uncompressed and compressed sizes start at byte 4 and 12 */
   int32_t nbytes = *(int32_t*)((uint8_t*)chunk + 4);
   int32_t cbytes = *(int32_t*)((uint8_t*)chunk + 12);
+  schunk_state* state;
+  uint8_t** data;
+  int rc;
+
+  if (SCHUNK_FILE(sheader) != NULL) {
+    /* The chunk goes to disk */
+    rc = append_file_chunk(sheader, chunk);
+    blosc_free(SCHUNK_ALLOCATOR(sheader), chunk);
+    if (rc < 0) {
+      fprintf(stderr, "Cannot append a chunk to the super-chunk file\n");
+      return (size_t)rc;
+    }
+    return (size_t)sheader->nchunks;
+  }
 
-  /* Make space for appending a new chunk and do it */
-  sheader->data = realloc(sheader->data, (nchunks + 1) * sizeof(void*));
+  /* Make space for appending a new chunk.  The array of chunk pointers
+     is not reallocated in place, because readers in other threads may be
+     using it: a larger one is published and the old one is retired. */
+  state = get_state(sheader);
+  if (nchunks == state->maxchunks) {
+    if (state->nretired == MAX_RETIRED) {
+      fprintf(stderr, "Too many chunks in super-chunk\n");
+      blosc_free(&state->allocator, chunk);
+      return (size_t)-1;
+    }
+    state->maxchunks = (state->maxchunks > 0) ? 2 * state->maxchunks : 16;
+    data = blosc_malloc(&state->allocator,
+                        (size_t)state->maxchunks * sizeof(void*));
+    if (sheader->data != NULL) {
+      memcpy(data, sheader->data, (size_t)nchunks * sizeof(void*));
+      state->retired[state->nretired++] = sheader->data;
+    }
+    BLOSC_ATOMIC_STOREPTR(&sheader->data, data);
+  }
+  /* The chunk is visible for readers once the number of chunks is updated */
   sheader->data[nchunks] = chunk;
+  BLOSC_ATOMIC_STORE64(&sheader->nchunks, nchunks + 1);
   /* Update counters */
-  sheader->nchunks = nchunks + 1;
   sheader->nbytes += nbytes;
   sheader->cbytes += cbytes + sizeof(void*);
   /* printf("Compression chunk #%lld: %d -> %d (%.1fx)\n", */
@@ -103,69 +533,113 @@ size_t append_chunk(blosc2_sheader* sheader, void* chunk) {
 int blosc2_set_delta_ref(blosc2_sheader* sheader, size_t typesize, size_t nbytes, void* ref) {
   int cbytes;
   void* filters_chunk;
-  uint8_t* dec_filters = decode_filters(sheader->filters);
-  int clevel = sheader->clevel;
-  int doshuffle = 0;
+  uint8_t dec_filters[BLOSC_MAX_FILTERS];
+  blosc_context* cctx;
+
+  decode_filters(sheader->filters, dec_filters);
 
   if (dec_filters[0] == BLOSC_DELTA) {
-    doshuffle = dec_filters[1];
+    if (SCHUNK_FILE(sheader) != NULL && sheader->nchunks > 0) {
+      /* The filters chunk goes before the data chunks in the file */
+      fprintf(stderr, "The delta reference of a super-chunk file cannot be "
+                      "set after appending chunks\n");
+      return -1;
+    }
     if (sheader->filters_chunk != NULL) {
       sheader->cbytes -= *(uint32_t*)(sheader->filters_chunk + 4);
-      free(sheader->filters_chunk);
+      blosc_free(SCHUNK_ALLOCATOR(sheader), sheader->filters_chunk);
     }
   }
   else {
     printf("You cannot set a delta reference if delta filter is not set\n");
     return(-1);
   }
-  free(dec_filters);
 
-  filters_chunk = malloc(nbytes + BLOSC_MAX_OVERHEAD);
-  cbytes = blosc_compress(clevel, doshuffle, typesize, nbytes, ref, filters_chunk,
-                          nbytes + BLOSC_MAX_OVERHEAD);
+  /* The reference itself is not delta encoded */
+  cctx = create_cctx(sheader->compressor, sheader->clevel, sheader->filters,
+                     typesize, NULL, 1, NULL, SCHUNK_ALLOCATOR(sheader));
+  if (cctx == NULL) {
+    return -1;
+  }
+  filters_chunk = blosc_malloc(SCHUNK_ALLOCATOR(sheader),
+                               nbytes + BLOSC_MAX_OVERHEAD);
+  cbytes = blosc2_compress_ctx(cctx, nbytes, ref, filters_chunk,
+                               nbytes + BLOSC_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
   if (cbytes < 0) {
-    free(filters_chunk);
+    blosc_free(SCHUNK_ALLOCATOR(sheader), filters_chunk);
     return cbytes;
   }
   sheader->filters_chunk = filters_chunk;
   sheader->cbytes += cbytes;
+  if (SCHUNK_FILE(sheader) != NULL) {
+    schunk_file* sfile = SCHUNK_FILE(sheader);
+
+    sfile->filters_offset = PACKED_HEADER_LENGTH;
+    sfile->data_end = PACKED_HEADER_LENGTH + cbytes;
+    sfile->nbytes = PACKED_HEADER_LENGTH + nbytes;
+    if (fseek64(sfile->fp, PACKED_HEADER_LENGTH) != 0 ||
+        fwrite(filters_chunk, 1, (size_t)cbytes, sfile->fp) != (size_t)cbytes ||
+        write_file_header(sheader) < 0 || fflush(sfile->fp) != 0) {
+      fprintf(stderr, "Cannot write the delta reference to the super-chunk file\n");
+      return -1;
+    }
+  }
   return cbytes;
 }
 
 
+/* Get the context for compressing buffers with `typesize` for a
+   super-chunk.  It is kept for the next buffers with the same typesize. */
+static blosc_context* get_cctx(blosc2_sheader* sheader, size_t typesize) {
+  schunk_state* state = get_state(sheader);
+  blosc2_threadpool* pool;
+
+  if (state->cctx != NULL && state->cctx_typesize != typesize) {
+    blosc2_free_ctx(state->cctx);
+    state->cctx = NULL;
+  }
+  if (state->cctx == NULL) {
+    pool = get_pool(state);
+    state->cctx = create_cctx(sheader->compressor, sheader->clevel,
+                              sheader->filters, typesize, sheader,
+                              (pool != NULL) ? state->nthreads : 1, pool,
+                              &state->allocator);
+    state->cctx_typesize = typesize;
+  }
+  return state->cctx;
+}
+
+
 /* Append a data buffer to a super-chunk. */
 size_t blosc2_append_buffer(blosc2_sheader* sheader, size_t typesize,
                             size_t nbytes, void* src) {
   int cbytes;
-  void* chunk = malloc(nbytes + BLOSC_MAX_OVERHEAD);
-  uint8_t* dec_filters = decode_filters(sheader->filters);
-  int clevel = sheader->clevel;
-  char* compname;
-  int doshuffle, ret;
+  void* chunk;
+  uint8_t dec_filters[BLOSC_MAX_FILTERS];
+  blosc_context* cctx;
+  int ret;
+
+  decode_filters(sheader->filters, dec_filters);
 
   /* Apply filters prior to compress */
-  if (dec_filters[0] == BLOSC_DELTA) {
-    doshuffle = dec_filters[1];
-    if (sheader->filters_chunk == NULL) {
-      ret = blosc2_set_delta_ref(sheader, typesize, nbytes, src);
-      if (ret < 0) {
-        return((size_t)ret);
-      }
+  if (dec_filters[0] == BLOSC_DELTA && sheader->filters_chunk == NULL) {
+    ret = blosc2_set_delta_ref(sheader, typesize, nbytes, src);
+    if (ret < 0) {
+      return((size_t)ret);
     }
   }
-  else {
-    doshuffle = dec_filters[0];
-  }
-  free(dec_filters);
 
   /* Compress the src buffer using super-chunk defaults */
-  blosc_compcode_to_compname(sheader->compressor, &compname);
-  blosc_set_compressor(compname);
-  blosc_set_schunk(sheader);
-  cbytes = blosc_compress(clevel, doshuffle, typesize, nbytes, src, chunk,
-                          nbytes + BLOSC_MAX_OVERHEAD);
+  cctx = get_cctx(sheader, typesize);
+  if (cctx == NULL) {
+    return (size_t)-1;
+  }
+  chunk = blosc_malloc(SCHUNK_ALLOCATOR(sheader), nbytes + BLOSC_MAX_OVERHEAD);
+  cbytes = blosc2_compress_ctx(cctx, nbytes, src, chunk,
+                               nbytes + BLOSC_MAX_OVERHEAD);
   if (cbytes < 0) {
-    free(chunk);
+    blosc_free(SCHUNK_ALLOCATOR(sheader), chunk);
     return cbytes;
   }
 
@@ -174,14 +648,109 @@ size_t blosc2_append_buffer(blosc2_sheader* sheader, size_t typesize,
 }
 
 
+/* Append many data buffers to a super-chunk, compressing them in parallel. */
+size_t blosc2_append_buffers(blosc2_sheader* sheader, size_t typesize,
+                             int32_t nbuffers,
+                             const void* const* srcs, const size_t* sizes) {
+  const blosc2_allocator* allocator;
+  blosc_context* cctx;
+  uint8_t dec_filters[BLOSC_MAX_FILTERS];
+  void** chunks;
+  size_t* destsizes;
+  int* cbytes;
+  int32_t i;
+  int rc;
+
+  if (nbuffers <= 0) {
+    return (size_t)sheader->nchunks;
+  }
+
+  decode_filters(sheader->filters, dec_filters);
+
+  /* Apply filters prior to compress */
+  if (dec_filters[0] == BLOSC_DELTA && sheader->filters_chunk == NULL) {
+    rc = blosc2_set_delta_ref(sheader, typesize, sizes[0], (void*)srcs[0]);
+    if (rc < 0) {
+      return (size_t)rc;
+    }
+  }
+
+  /* Compress the buffers using super-chunk defaults.  The blocks of all the
+     buffers are handed out to the threads of the super-chunk as a single
+     job. */
+  cctx = get_cctx(sheader, typesize);
+  if (cctx == NULL) {
+    return (size_t)-1;
+  }
+
+  allocator = SCHUNK_ALLOCATOR(sheader);
+  chunks = blosc_malloc(allocator, nbuffers * sizeof(void*));
+  destsizes = blosc_malloc(allocator, nbuffers * sizeof(size_t));
+  cbytes = blosc_malloc(allocator, nbuffers * sizeof(int));
+  for (i = 0; i < nbuffers; i++) {
+    destsizes[i] = sizes[i] + BLOSC_MAX_OVERHEAD;
+    chunks[i] = blosc_malloc(allocator, destsizes[i]);
+  }
+  rc = blosc2_compress_batch(cctx, nbuffers, srcs, sizes, chunks, destsizes,
+                             cbytes);
+
+  /* Append the chunks in order (the super-chunk takes them over) */
+  for (i = 0; i < nbuffers; i++) {
+    if (rc < 0) {
+      blosc_free(allocator, chunks[i]);
+    }
+    else if ((int64_t)append_chunk(sheader, chunks[i]) < 0) {
+      rc = -1;
+    }
+  }
+
+  blosc_free(allocator, chunks);
+  blosc_free(allocator, destsizes);
+  blosc_free(allocator, cbytes);
+  return (rc < 0) ? (size_t)rc : (size_t)sheader->nchunks;
+}
+
+
+/* Read the chunk `nchunk` of a super-chunk file into its buffer for
+   reading chunks.  Returns NULL if this fails. */
+static uint8_t* read_file_chunk(blosc2_sheader* sheader, int64_t nchunk) {
+  schunk_file* sfile = SCHUNK_FILE(sheader);
+  uint8_t header[BLOSC_MIN_HEADER_LENGTH];
+  int32_t cbytes;
+
+  if (fseek64(sfile->fp, sfile->offsets[nchunk]) != 0 ||
+      fread(header, 1, BLOSC_MIN_HEADER_LENGTH, sfile->fp) != BLOSC_MIN_HEADER_LENGTH) {
+    fprintf(stderr, "Cannot read chunk %ld of the super-chunk file\n", (long)nchunk);
+    return NULL;
+  }
+  cbytes = *(int32_t*)(header + 12);
+  if (cbytes > sfile->chunk_size) {
+    blosc_free(SCHUNK_ALLOCATOR(sheader), sfile->chunk);
+    sfile->chunk = blosc_malloc(SCHUNK_ALLOCATOR(sheader), (size_t)cbytes);
+    sfile->chunk_size = cbytes;
+  }
+  memcpy(sfile->chunk, header, BLOSC_MIN_HEADER_LENGTH);
+  if (fread(sfile->chunk + BLOSC_MIN_HEADER_LENGTH, 1,
+            (size_t)(cbytes - BLOSC_MIN_HEADER_LENGTH), sfile->fp) !=
+      (size_t)(cbytes - BLOSC_MIN_HEADER_LENGTH)) {
+    fprintf(stderr, "Cannot read chunk %ld of the super-chunk file\n", (long)nchunk);
+    return NULL;
+  }
+  return sfile->chunk;
+}
+
+
 /* Decompress and return a chunk that is part of a super-chunk. */
 int blosc2_decompress_chunk(blosc2_sheader* sheader, int64_t nchunk,
     void* dest, int nbytes) {
-  int64_t nchunks = sheader->nchunks;
+  /* The number of chunks goes first: the chunk pointers read after it
+     are always as new (see append_chunk()) */
+  int64_t nchunks = BLOSC_ATOMIC_LOAD64(&sheader->nchunks);
+  uint8_t** data = BLOSC_ATOMIC_LOADPTR(&sheader->data);
   void* src;
+  blosc_context* dctx;
   int chunksize;
   int nbytes_;
-  uint8_t* filters = decode_filters(sheader->filters);
 
   if (nchunk >= nchunks) {
     printf("specified nchunk ('%ld') exceeds the number of chunks "
@@ -190,7 +759,15 @@ int blosc2_decompress_chunk(blosc2_sheader* sheader, int64_t nchunk,
   }
 
   /* Grab the address of the chunk */
-  src = sheader->data[nchunk];
+  if (SCHUNK_FILE(sheader) != NULL) {
+    src = read_file_chunk(sheader, nchunk);
+    if (src == NULL) {
+      return -1;
+    }
+  }
+  else {
+    src = data[nchunk];
+  }
   /* Create a buffer for destination */
   nbytes_ = *(int32_t*)((uint8_t*)src + 4);
 
@@ -199,37 +776,146 @@ int blosc2_decompress_chunk(blosc2_sheader* sheader, int64_t nchunk,
     return -11;
   }
 
-  /* Put the super-chunk address in the global context for Blosc1 */
-  blosc_set_schunk(sheader);
-
   /* And decompress the chunk */
-  chunksize = blosc_decompress(src, dest, (size_t)nbytes);
-
-  free(filters);
+  dctx = acquire_dctx(sheader);
+  if (dctx == NULL) {
+    return -1;
+  }
+  chunksize = blosc2_decompress_ctx(dctx, src, dest, (size_t)nbytes);
+  release_dctx(sheader, dctx);
 
   return chunksize;
 }
 
 
+/* Decompress `count` consecutive chunks of a super-chunk, starting at
+   `first`, into the contiguous buffer `dest`. */
+int64_t blosc2_decompress_chunks(blosc2_sheader* sheader, int64_t first,
+                                 int64_t count, void* dest, int64_t nbytes) {
+  int64_t nchunks = BLOSC_ATOMIC_LOAD64(&sheader->nchunks);
+  uint8_t** data = BLOSC_ATOMIC_LOADPTR(&sheader->data);
+  const void* srcs[DECOMPRESS_CHUNKS_BATCH];
+  void* dests[DECOMPRESS_CHUNKS_BATCH];
+  size_t destsizes[DECOMPRESS_CHUNKS_BATCH];
+  int results[DECOMPRESS_CHUNKS_BATCH];
+  blosc_context* dctx;
+  int64_t nchunk, total = 0;
+  int32_t nbuffers, i;
+  int nbytes_, rc = 0;
+
+  if (first < 0 || count < 0 || first + count > nchunks) {
+    printf("specified chunks ('%ld' to '%ld') exceed the number of chunks "
+           "('%ld') in super-chunk\n", (long)first, (long)(first + count),
+           (long)nchunks);
+    return -10;
+  }
+
+  if (SCHUNK_FILE(sheader) != NULL) {
+    /* The chunks of files are read (and decompressed) one by one */
+    for (nchunk = first; nchunk < first + count; nchunk++) {
+      if (nbytes - total > INT32_MAX) {
+        nbytes_ = INT32_MAX;
+      }
+      else {
+        nbytes_ = (int)(nbytes - total);
+      }
+      rc = blosc2_decompress_chunk(sheader, nchunk, (uint8_t*)dest + total,
+                                   nbytes_);
+      if (rc < 0) {
+        return rc;
+      }
+      total += rc;
+    }
+    return total;
+  }
+
+  dctx = acquire_dctx(sheader);
+  if (dctx == NULL) {
+    return -1;
+  }
+  /* The blocks of all the chunks in a batch are handed out to the
+     threads as a single job */
+  for (nchunk = first; nchunk < first + count; nchunk += nbuffers) {
+    nbuffers = (int32_t)((first + count - nchunk < DECOMPRESS_CHUNKS_BATCH) ?
+                         first + count - nchunk : DECOMPRESS_CHUNKS_BATCH);
+    for (i = 0; i < nbuffers; i++) {
+      srcs[i] = data[nchunk + i];
+      nbytes_ = *(int32_t*)(data[nchunk + i] + 4);
+      if (nbytes - total < nbytes_) {
+        printf("Buffer size is too small for the decompressed buffers\n");
+        rc = -11;
+        break;
+      }
+      dests[i] = (uint8_t*)dest + total;
+      destsizes[i] = (size_t)nbytes_;
+      total += nbytes_;
+    }
+    if (rc < 0) {
+      break;
+    }
+    rc = blosc2_decompress_batch(dctx, nbuffers, srcs, dests, destsizes,
+                                 results);
+    if (rc < 0) {
+      break;
+    }
+  }
+  release_dctx(sheader, dctx);
+
+  return (rc < 0) ? rc : total;
+}
+
+
 /* Free all memory from a super-chunk. */
 int blosc2_destroy_schunk(blosc2_sheader* sheader) {
+  /* The state goes before the header, so keep a copy of its allocator */
+  blosc2_allocator allocator;
   int i;
 
+  if (SCHUNK_STATE(sheader) != NULL) {
+    allocator = SCHUNK_STATE(sheader)->allocator;
+  }
+  else {
+    blosc_get_allocator(&allocator);
+  }
   if (sheader->filters_chunk != NULL)
-    free(sheader->filters_chunk);
+    blosc_free(&allocator, sheader->filters_chunk);
   if (sheader->codec_chunk != NULL)
-    free(sheader->codec_chunk);
+    blosc_free(&allocator, sheader->codec_chunk);
   if (sheader->metadata_chunk != NULL)
-    free(sheader->metadata_chunk);
+    blosc_free(&allocator, sheader->metadata_chunk);
   if (sheader->userdata_chunk != NULL)
-    free(sheader->userdata_chunk);
+    blosc_free(&allocator, sheader->userdata_chunk);
   if (sheader->data != NULL) {
     for (i = 0; i < sheader->nchunks; i++) {
-      free(sheader->data[i]);
+      blosc_free(&allocator, sheader->data[i]);
     }
-    free(sheader->data);
+    blosc_free(&allocator, sheader->data);
+  }
+  if (SCHUNK_FILE(sheader) != NULL) {
+    blosc2_sync_schunk_file(sheader);
+    fclose(SCHUNK_FILE(sheader)->fp);
+    blosc_free(&allocator, SCHUNK_FILE(sheader)->offsets);
+    blosc_free(&allocator, SCHUNK_FILE(sheader)->chunk);
+    blosc_free(&allocator, SCHUNK_FILE(sheader));
   }
-  free(sheader);
+  if (SCHUNK_STATE(sheader) != NULL) {
+    schunk_state* state = SCHUNK_STATE(sheader);
+
+    for (i = 0; i < state->nretired; i++) {
+      blosc_free(&allocator, state->retired[i]);
+    }
+    if (state->cctx != NULL) {
+      blosc2_free_ctx(state->cctx);
+    }
+    if (state->dctx != NULL) {
+      blosc2_free_ctx(state->dctx);
+    }
+    if (state->pool != NULL) {
+      blosc_release_shared_pool(state->pool);
+    }
+    blosc_free(&allocator, state);
+  }
+  blosc_free(&allocator, sheader);
 
   /* The super-chunk is destroyed, so remove the internal reference to it */
   blosc_set_schunk(NULL);
@@ -239,10 +925,18 @@ int blosc2_destroy_schunk(blosc2_sheader* sheader) {
 
 
 /* Compute the final length of a packed super-chunk */
-int64_t blosc2_get_packed_length(blosc2_sheader* sheader) {
+/* The length of the packed super-chunk with the first `nchunks` chunks
+   in `data` */
+static int64_t packed_length(blosc2_sheader* sheader, int64_t nchunks,
+                             uint8_t** data) {
   int i;
   int64_t length = sizeof(blosc2_sheader);
 
+  if (SCHUNK_FILE(sheader) != NULL) {
+    /* The file is packed already */
+    return SCHUNK_FILE(sheader)->data_end + nchunks * (int64_t)sizeof(int64_t);
+  }
+
   if (sheader->filters_chunk != NULL)
     length += *(int32_t*)(sheader->filters_chunk + 12);
   if (sheader->codec_chunk != NULL)
@@ -251,15 +945,22 @@ int64_t blosc2_get_packed_length(blosc2_sheader* sheader) {
     length += *(int32_t*)(sheader->metadata_chunk + 12);
   if (sheader->userdata_chunk != NULL)
     length += *(int32_t*)(sheader->userdata_chunk + 12);
-  if (sheader->data != NULL) {
-    for (i = 0; i < sheader->nchunks; i++) {
+  if (data != NULL) {
+    for (i = 0; i < nchunks; i++) {
       length += sizeof(int64_t);
-      length += *(int32_t*)(sheader->data[i] + 12);
+      length += *(int32_t*)(data[i] + 12);
     }
   }
   return length;
 }
 
+int64_t blosc2_get_packed_length(blosc2_sheader* sheader) {
+  int64_t nchunks = BLOSC_ATOMIC_LOAD64(&sheader->nchunks);
+  uint8_t** data = BLOSC_ATOMIC_LOADPTR(&sheader->data);
+
+  return packed_length(sheader, nchunks, data);
+}
+
 /* Copy a chunk into a packed super-chunk */
 void pack_copy_chunk(void* chunk, void* packed, int offset, int64_t* cbytes, int64_t* nbytes) {
   int32_t cbytes_, nbytes_;
@@ -283,7 +984,9 @@ void pack_copy_chunk(void* chunk, void* packed, int offset, int64_t* cbytes, int
 void* blosc2_pack_schunk(blosc2_sheader* sheader) {
   int64_t cbytes = sizeof(blosc2_sheader);
   int64_t nbytes = sizeof(blosc2_sheader);
-  int64_t nchunks = sheader->nchunks;
+  /* Chunks appended by other threads while packing are left out */
+  int64_t nchunks = BLOSC_ATOMIC_LOAD64(&sheader->nchunks);
+  uint8_t** data = BLOSC_ATOMIC_LOADPTR(&sheader->data);
   void* packed;
   void* data_chunk;
   uint64_t* data_pointers;
@@ -292,11 +995,24 @@ void* blosc2_pack_schunk(blosc2_sheader* sheader) {
   int64_t packed_len;
   int i;
 
-  packed_len = blosc2_get_packed_length(sheader);
-  packed = malloc((size_t)packed_len);
+  packed_len = packed_length(sheader, nchunks, data);
+  packed = blosc_malloc(NULL, (size_t)packed_len);
+
+  if (SCHUNK_FILE(sheader) != NULL) {
+    /* The file is packed already (once synced), so just read it */
+    if (blosc2_sync_schunk_file(sheader) < 0 || fseek64(SCHUNK_FILE(sheader)->fp, 0) != 0 ||
+        fread(packed, 1, (size_t)packed_len, SCHUNK_FILE(sheader)->fp) !=
+        (size_t)packed_len) {
+      blosc_free(NULL, packed);
+      return NULL;
+    }
+    return packed;
+  }
 
   /* Fill the header */
   memcpy(packed, sheader, 40);    /* copy until cbytes */
+  /* No capacity reserved (see blosc2_packed_reserve()) */
+  memset((uint8_t*)packed + 80, 0, 16);
 
   /* Fill the ancillary chunks info */
   pack_copy_chunk(sheader->filters_chunk,  packed, 40, &cbytes, &nbytes);
@@ -310,9 +1026,9 @@ void* blosc2_pack_schunk(blosc2_sheader* sheader) {
   *(uint64_t*)((uint8_t*)packed + 72) = packed_len - data_offsets_len;
 
   /* And fill the actual data chunks */
-  if (sheader->data != NULL) {
+  if (data != NULL) {
     for (i = 0; i < nchunks; i++) {
-      data_chunk = sheader->data[i];
+      data_chunk = data[i];
       chunk_nbytes = *(int32_t*)((uint8_t*)data_chunk + 4);
       chunk_cbytes = *(int32_t*)((uint8_t*)data_chunk + 12);
       memcpy((uint8_t*)packed + cbytes, data_chunk, (size_t)chunk_cbytes);
@@ -336,7 +1052,8 @@ void* blosc2_pack_schunk(blosc2_sheader* sheader) {
 
 /* Copy a chunk into a packed super-chunk */
 void* unpack_copy_chunk(uint8_t* packed, int offset,
-    blosc2_sheader* sheader, int64_t *nbytes, int64_t *cbytes) {
+    blosc2_sheader* sheader, int64_t *nbytes, int64_t *cbytes,
+    const blosc2_allocator* allocator) {
   int32_t nbytes_, cbytes_;
   uint8_t *chunk, *dst_chunk = NULL;
 
@@ -345,7 +1062,7 @@ void* unpack_copy_chunk(uint8_t* packed, int offset,
     nbytes_ = *(int32_t*)(chunk + 4);
     cbytes_ = *(int32_t*)(chunk + 12);
     /* Create a copy of the chunk */
-    dst_chunk = malloc((size_t)cbytes_);
+    dst_chunk = blosc_malloc(allocator, (size_t)cbytes_);
     memcpy(dst_chunk, chunk, (size_t)cbytes_);
     /* Update counters */
     sheader->nbytes += nbytes_;
@@ -359,7 +1076,8 @@ void* unpack_copy_chunk(uint8_t* packed, int offset,
 
 /* Unpack a packed super-chunk */
 blosc2_sheader* blosc2_unpack_schunk(void* packed) {
-  blosc2_sheader* sheader = calloc(1, sizeof(blosc2_sheader));
+  blosc2_allocator allocator;
+  blosc2_sheader* sheader;
   int64_t nbytes = sizeof(blosc2_sheader);
   int64_t cbytes = sizeof(blosc2_sheader);
   uint8_t* data_chunk;
@@ -369,19 +1087,27 @@ blosc2_sheader* blosc2_unpack_schunk(void* packed) {
   int32_t chunk_size;
   int i;
 
+  blosc_get_allocator(&allocator);
+  sheader = blosc_malloc(&allocator, sizeof(blosc2_sheader));
+  memset(sheader, 0, sizeof(blosc2_sheader));
+
   /* Fill the header */
   memcpy(sheader, packed, 40); /* Copy until cbytes */
 
   /* Fill the ancillary chunks info */
-  sheader->filters_chunk = unpack_copy_chunk(packed, 40, sheader, &nbytes, &cbytes);
-  sheader->codec_chunk = unpack_copy_chunk(packed, 48, sheader, &nbytes, &cbytes);
-  sheader->metadata_chunk = unpack_copy_chunk(packed, 56, sheader, &nbytes, &cbytes);
-  sheader->userdata_chunk = unpack_copy_chunk(packed, 64, sheader, &nbytes, &cbytes);
+  sheader->filters_chunk = unpack_copy_chunk(packed, 40, sheader, &nbytes, &cbytes,
+                                             &allocator);
+  sheader->codec_chunk = unpack_copy_chunk(packed, 48, sheader, &nbytes, &cbytes,
+                                             &allocator);
+  sheader->metadata_chunk = unpack_copy_chunk(packed, 56, sheader, &nbytes, &cbytes,
+                                             &allocator);
+  sheader->userdata_chunk = unpack_copy_chunk(packed, 64, sheader, &nbytes, &cbytes,
+                                             &allocator);
 
   /* Finally, fill the data pointers section */
   data = (int64_t*)((uint8_t*)packed + *(int64_t*)((uint8_t*)packed + 72));
   nchunks = *(int64_t*)((uint8_t*)packed + 16);
-  sheader->data = malloc(nchunks * sizeof(void*));
+  sheader->data = blosc_malloc(&allocator, nchunks * sizeof(void*));
   nbytes += nchunks * sizeof(int64_t);
   cbytes += nchunks * sizeof(int64_t);
 
@@ -390,7 +1116,7 @@ blosc2_sheader* blosc2_unpack_schunk(void* packed) {
     for (i = 0; i < nchunks; i++) {
       data_chunk = (uint8_t*)packed + data[i];
       chunk_size = *(int32_t*)(data_chunk + 12);
-      new_chunk = malloc((size_t)chunk_size);
+      new_chunk = blosc_malloc(&allocator, (size_t)chunk_size);
       memcpy(new_chunk, data_chunk, (size_t)chunk_size);
       sheader->data[i] = new_chunk;
       cbytes += chunk_size;
@@ -402,11 +1128,127 @@ blosc2_sheader* blosc2_unpack_schunk(void* packed) {
 
   assert(*(int64_t*)((uint8_t*)packed + 24) == nbytes);
   assert(*(int64_t*)((uint8_t*)packed + 32) == cbytes);
+  new_state(sheader, blosc_get_nthreads(), &allocator);
 
   return sheader;
 }
 
 
+/* The end of the data chunks in a *packed* super-chunk.  This is where
+   the data chunk offsets are, unless there is room reserved for chunks. */
+static int64_t packed_data_end(uint8_t* packed) {
+  int64_t nchunks = *(int64_t*)(packed + 16);
+  int64_t* data = (int64_t*)(packed + *(int64_t*)(packed + 72));
+  int64_t data_end = sizeof(blosc2_sheader);
+  int64_t offset;
+  int i;
+
+  if (nchunks > 0) {
+    return data[nchunks - 1] + *(int32_t*)(packed + data[nchunks - 1] + 12);
+  }
+  /* Only the ancillary chunks */
+  for (i = 0; i < 4; i++) {
+    offset = *(int64_t*)(packed + 40 + 8 * i);
+    if (offset != 0 && offset + *(int32_t*)(packed + offset + 12) > data_end) {
+      data_end = offset + *(int32_t*)(packed + offset + 12);
+    }
+  }
+  return data_end;
+}
+
+
+/* Make room in a *packed* super-chunk for `maxchunks` chunks in total,
+   and for data chunks until `data_capacity`.  The data chunk offsets go
+   at the end of the buffer, after the room for data chunks. */
+static void* packed_grow(void* packed, int64_t maxchunks, int64_t data_capacity) {
+  int64_t nchunks = *(int64_t*)((uint8_t*)packed + 16);
+  int64_t data_offsets = *(int64_t*)((uint8_t*)packed + 72);
+  int64_t capacity = data_capacity + maxchunks * (int64_t)sizeof(int64_t);
+
+  packed = blosc_realloc(NULL, packed, (size_t)capacity);
+  memmove((uint8_t*)packed + data_capacity, (uint8_t*)packed + data_offsets,
+          (size_t)(nchunks * sizeof(int64_t)));
+  *(int64_t*)((uint8_t*)packed + 72) = data_capacity;
+  *(int64_t*)((uint8_t*)packed + 80) = capacity;
+  *(int64_t*)((uint8_t*)packed + 88) = maxchunks;
+  return packed;
+}
+
+
+/* Reserve room in a *packed* super-chunk for appending chunks */
+void* blosc2_packed_reserve(void* packed, int64_t nchunks, int64_t cbytes) {
+  int64_t nchunks_ = *(int64_t*)((uint8_t*)packed + 16);
+  int64_t data_offsets = *(int64_t*)((uint8_t*)packed + 72);
+  int64_t maxchunks = *(int64_t*)((uint8_t*)packed + 88);
+  int64_t data_end = packed_data_end(packed);
+
+  if (*(int64_t*)((uint8_t*)packed + 80) == 0) {
+    /* No room reserved yet */
+    maxchunks = nchunks_;
+  }
+  if (nchunks_ + nchunks <= maxchunks && data_end + cbytes <= data_offsets) {
+    return packed;
+  }
+  if (nchunks_ + nchunks > maxchunks) {
+    maxchunks = nchunks_ + nchunks;
+  }
+  if (data_end + cbytes > data_offsets) {
+    data_offsets = data_end + cbytes;
+  }
+  return packed_grow(packed, maxchunks, data_offsets);
+}
+
+
+/* Release the room reserved in a *packed* super-chunk */
+void* blosc2_packed_shrink(void* packed) {
+  int64_t nchunks = *(int64_t*)((uint8_t*)packed + 16);
+  int64_t data_offsets = *(int64_t*)((uint8_t*)packed + 72);
+  int64_t data_end;
+
+  if (*(int64_t*)((uint8_t*)packed + 80) == 0) {
+    return packed;
+  }
+  data_end = packed_data_end(packed);
+  memmove((uint8_t*)packed + data_end, (uint8_t*)packed + data_offsets,
+          (size_t)(nchunks * sizeof(int64_t)));
+  *(int64_t*)((uint8_t*)packed + 72) = data_end;
+  memset((uint8_t*)packed + 80, 0, 16);
+  assert(data_end + nchunks * (int64_t)sizeof(int64_t) ==
+         *(int64_t*)((uint8_t*)packed + 32));
+  return blosc_realloc(NULL, packed, (size_t)(data_end + nchunks * sizeof(int64_t)));
+}
+
+
+/* Append a chunk into a *packed* super-chunk with room reserved.  The
+   room is doubled when it runs out, so appends are amortized O(1). */
+static void* packed_append_chunk_reserved(void* packed, void* chunk) {
+  int64_t nchunks = *(int64_t*)((uint8_t*)packed + 16);
+  int64_t data_offsets = *(int64_t*)((uint8_t*)packed + 72);
+  int64_t maxchunks = *(int64_t*)((uint8_t*)packed + 88);
+  int64_t data_end = packed_data_end(packed);
+  int32_t nbytes = *(int32_t*)((uint8_t*)chunk + 4);
+  int32_t cbytes = *(int32_t*)((uint8_t*)chunk + 12);
+
+  if (nchunks == maxchunks || data_end + cbytes > data_offsets) {
+    if (nchunks == maxchunks) {
+      maxchunks = (maxchunks > 0) ? 2 * maxchunks : 16;
+    }
+    if (data_end + cbytes > data_offsets) {
+      data_offsets = 2 * (data_end + cbytes);
+    }
+    packed = packed_grow(packed, maxchunks, data_offsets);
+  }
+
+  memcpy((uint8_t*)packed + data_end, chunk, (size_t)cbytes);
+  ((int64_t*)((uint8_t*)packed + data_offsets))[nchunks] = data_end;
+  *(int64_t*)((uint8_t*)packed + 16) += 1;
+  *(int64_t*)((uint8_t*)packed + 24) += nbytes + sizeof(int64_t);
+  *(int64_t*)((uint8_t*)packed + 32) += cbytes + sizeof(int64_t);
+
+  return packed;
+}
+
+
 /* Append an existing chunk into a *packed* super-chunk. */
 void* packed_append_chunk(void* packed, void* chunk) {
   int64_t nchunks = *(int64_t*)((uint8_t*)packed + 16);
@@ -420,8 +1262,12 @@ void* packed_append_chunk(void* packed, void* chunk) {
   uint8_t* data;
   uint8_t* new_data;
 
+  if (*(int64_t*)((uint8_t*)packed + 80) != 0) {
+    return packed_append_chunk_reserved(packed, chunk);
+  }
+
   /* Make space for the new chunk and copy it */
-  packed = realloc(packed, packed_len + cbytes + sizeof(int64_t));
+  packed = blosc_realloc(NULL, packed, packed_len + cbytes + sizeof(int64_t));
   data = (uint8_t*)packed + data_offsets;
   new_data = data + cbytes;
   /* Move the data offsets to the end */
@@ -446,48 +1292,54 @@ void* blosc2_packed_append_buffer(void* packed, size_t typesize, size_t nbytes,
   int cname = *(int16_t*)((uint8_t*)packed + 4);
   int clevel = *(int16_t*)((uint8_t*)packed + 6);
   void* filters_chunk = (uint8_t*)packed + *(uint64_t*)((uint8_t*)packed + 40);
-  uint8_t* filters = decode_filters(*(uint16_t*)((uint8_t*)packed + 8));
+  uint8_t filters[BLOSC_MAX_FILTERS];
   int cbytes;
-  void* chunk = malloc(nbytes + BLOSC_MAX_OVERHEAD);
-  void* dest = malloc(nbytes);
-  char* compname;
-  int doshuffle;
+  void* chunk = blosc_malloc(NULL, nbytes + BLOSC_MAX_OVERHEAD);
+  void* dest = blosc_malloc(NULL, nbytes);
   void* new_packed;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context* dctx;
+  blosc_context* cctx;
+
+  decode_filters(*(uint16_t*)((uint8_t*)packed + 8), filters);
 
   /* Apply filters prior to compress */
   if (filters[0] == BLOSC_DELTA) {
-    doshuffle = filters[1];
     if (filters_chunk == NULL) {
       /* For packed super-buffers, the filters schunk should exist */
       return NULL;
     }
-    delta_encoder8(filters_chunk, 0, (int)nbytes, src, dest);
+    dctx = blosc2_create_dctx(&dparams);
+    delta_encoder8(dctx, filters_chunk, 0, (int)nbytes, src, dest);
+    blosc2_free_ctx(dctx);
     /* memcpy(dest, src, nbytes); */
     src = dest;
   }
+
+  /* Compress the src buffer using super-chunk defaults (the delta is
+     encoded already) */
+  cctx = create_cctx(cname, clevel, *(uint16_t*)((uint8_t*)packed + 8),
+                     typesize, NULL, 1, NULL, NULL);
+  if (cctx == NULL) {
+    cbytes = -1;
+  }
   else {
-    doshuffle = filters[0];
+    cbytes = blosc2_compress_ctx(cctx, nbytes, src, chunk,
+                                 nbytes + BLOSC_MAX_OVERHEAD);
+    blosc2_free_ctx(cctx);
   }
-
-  /* Compress the src buffer using super-chunk defaults */
-  blosc_compcode_to_compname(cname, &compname);
-  blosc_set_compressor(compname);
-  cbytes = blosc_compress(clevel, doshuffle, typesize, nbytes, src, chunk,
-                          nbytes + BLOSC_MAX_OVERHEAD);
   if (cbytes < 0) {
-    free(chunk);
-    free(dest);
-    free(filters);
+    blosc_free(NULL, chunk);
+    blosc_free(NULL, dest);
     return NULL;
   }
 
-  /* We don't need dest and filters anymore */
-  free(dest);
-  free(filters);
+  /* We don't need dest anymore */
+  blosc_free(NULL, dest);
 
   /* Append the chunk and free it */
   new_packed = packed_append_chunk(packed, chunk);
-  free(chunk);
+  blosc_free(NULL, chunk);
 
   return new_packed;
 }
@@ -496,37 +1348,166 @@ void* blosc2_packed_append_buffer(void* packed, size_t typesize, size_t nbytes,
 /* Decompress and return a chunk that is part of a *packed* super-chunk. */
 int blosc2_packed_decompress_chunk(void* packed, int nchunk, void** dest) {
   int64_t nchunks = *(int64_t*)((uint8_t*)packed + 16);
-  uint8_t* filters = decode_filters(*(uint16_t*)((uint8_t*)packed + 8));
-  uint8_t* filters_chunk = (uint8_t*)packed + *(uint64_t*)((uint8_t*)packed + 40);
   int64_t* data = (int64_t*)((uint8_t*)packed + *(int64_t*)((uint8_t*)packed + 72));
-  void* src;
-  int chunksize;
   int32_t nbytes;
+  int chunksize;
 
   if (nchunk >= nchunks) {
     return -10;
   }
 
-  /* Grab the address of the chunk */
-  src = (uint8_t*)packed + data[nchunk];
   /* Create a buffer for destination */
-  nbytes = *(int32_t*)((uint8_t*)src + 4);
-  *dest = malloc((size_t)nbytes);
+  nbytes = *(int32_t*)((uint8_t*)packed + data[nchunk] + 4);
+  *dest = blosc_malloc(NULL, (size_t)nbytes);
 
-  /* And decompress it */
-  chunksize = blosc_decompress(src, *dest, (size_t)nbytes);
+  chunksize = blosc2_packed_decompress_chunk_into(packed, nchunk, *dest,
+                                                  (size_t)nbytes);
   if (chunksize < 0) {
-    return chunksize;
+    blosc_free(NULL, *dest);
+    *dest = NULL;
   }
-  if (chunksize != nbytes) {
+  return chunksize;
+}
+
+
+/* Decompress a chunk of a *packed* super-chunk into `dest`. */
+int blosc2_packed_decompress_chunk_into(void* packed, int nchunk, void* dest,
+                                        size_t nbytes) {
+  int64_t nchunks = *(int64_t*)((uint8_t*)packed + 16);
+  uint8_t filters[BLOSC_MAX_FILTERS];
+  uint8_t* filters_chunk = (uint8_t*)packed + *(uint64_t*)((uint8_t*)packed + 40);
+  int64_t* data = (int64_t*)((uint8_t*)packed + *(int64_t*)((uint8_t*)packed + 72));
+  void* src;
+  int chunksize;
+  int32_t nbytes_;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context* dctx;
+  uint8_t* dref;
+
+  decode_filters(*(uint16_t*)((uint8_t*)packed + 8), filters);
+
+  if (nchunk < 0 || nchunk >= nchunks) {
+    return -10;
+  }
+
+  /* Grab the address of the chunk */
+  src = (uint8_t*)packed + data[nchunk];
+  nbytes_ = *(int32_t*)((uint8_t*)src + 4);
+  if (nbytes < (size_t)nbytes_) {
     return -11;
   }
 
+  /* And decompress it (the delta is decoded afterwards) */
+  dctx = blosc2_create_dctx(&dparams);
+  if (dctx == NULL) {
+    return -1;
+  }
+  chunksize = blosc2_decompress_ctx(dctx, src, dest, nbytes);
+  if (chunksize >= 0 && chunksize != nbytes_) {
+    chunksize = -11;
+  }
+
   /* Apply filters after de-compress */
-  if (filters[0] == BLOSC_DELTA) {
-    delta_decoder8(filters_chunk, 0, nbytes, *dest);
+  if (chunksize >= 0 && filters[0] == BLOSC_DELTA) {
+    dref = blosc_malloc(NULL, (size_t)nbytes_);
+    delta_decoder8(dctx, filters_chunk, 0, nbytes_, dest, dref);
+    blosc_free(NULL, dref);
   }
+  blosc2_free_ctx(dctx);
 
-  free(filters);
   return chunksize;
 }
+
+
+/* Map the packed super-chunk in the file at `path` in memory */
+void* blosc2_map_packed_schunk(const char* path, int sequential,
+                               int64_t* length) {
+  void* packed;
+  int64_t length_, nchunks, data_offsets, capacity;
+#if defined(_WIN32)
+  HANDLE file, mapping;
+  LARGE_INTEGER size;
+
+  file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                     sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_ATTRIBUTE_NORMAL,
+                     NULL);
+  if (file == INVALID_HANDLE_VALUE) {
+    fprintf(stderr, "Cannot open the packed super-chunk '%s'\n", path);
+    return NULL;
+  }
+  if (!GetFileSizeEx(file, &size) || size.QuadPart < PACKED_HEADER_LENGTH) {
+    fprintf(stderr, "'%s' is not a packed super-chunk\n", path);
+    CloseHandle(file);
+    return NULL;
+  }
+  length_ = size.QuadPart;
+  mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  packed = (mapping != NULL) ?
+           MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+  /* The view keeps the mapping alive */
+  if (mapping != NULL) {
+    CloseHandle(mapping);
+  }
+  CloseHandle(file);
+  if (packed == NULL) {
+    fprintf(stderr, "Cannot map the packed super-chunk '%s'\n", path);
+    return NULL;
+  }
+#else
+  struct stat st;
+  int fd = open(path, O_RDONLY);
+
+  if (fd < 0) {
+    fprintf(stderr, "Cannot open the packed super-chunk '%s'\n", path);
+    return NULL;
+  }
+  if (fstat(fd, &st) < 0 || st.st_size < PACKED_HEADER_LENGTH) {
+    fprintf(stderr, "'%s' is not a packed super-chunk\n", path);
+    close(fd);
+    return NULL;
+  }
+  length_ = (int64_t)st.st_size;
+  packed = mmap(NULL, (size_t)length_, PROT_READ, MAP_SHARED, fd, 0);
+  /* The mapping keeps the file alive */
+  close(fd);
+  if (packed == MAP_FAILED) {
+    fprintf(stderr, "Cannot map the packed super-chunk '%s'\n", path);
+    return NULL;
+  }
+#if defined(MADV_SEQUENTIAL)
+  if (sequential) {
+    /* Let the kernel read ahead aggressively for scans */
+    madvise(packed, (size_t)length_, MADV_SEQUENTIAL);
+  }
+#endif
+#endif
+
+  /* The file may be larger than the packed super-chunk (e.g. a super-chunk
+     file being appended), but never smaller.  With room reserved (see
+     blosc2_packed_reserve()), the index of chunk offsets is past cbytes. */
+  nchunks = *(int64_t*)((uint8_t*)packed + 16);
+  data_offsets = *(int64_t*)((uint8_t*)packed + 72);
+  capacity = *(int64_t*)((uint8_t*)packed + 80);
+  if (*(int64_t*)((uint8_t*)packed + 32) > length_ || capacity > length_ ||
+      nchunks < 0 || data_offsets < PACKED_HEADER_LENGTH ||
+      data_offsets > length_ ||
+      nchunks > (length_ - data_offsets) / (int64_t)sizeof(int64_t)) {
+    fprintf(stderr, "The packed super-chunk '%s' is truncated\n", path);
+    blosc2_unmap_packed_schunk(packed, length_);
+    return NULL;
+  }
+  if (length != NULL) {
+    *length = length_;
+  }
+  return packed;
+}
+
+
+/* Unmap a packed super-chunk mapped with blosc2_map_packed_schunk() */
+int blosc2_unmap_packed_schunk(void* packed, int64_t length) {
+#if defined(_WIN32)
+  return UnmapViewOfFile(packed) ? 0 : -1;
+#else
+  return munmap(packed, (size_t)length);
+#endif
+}
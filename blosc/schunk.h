@@ -11,6 +11,10 @@
 
 #include "blosc.h"
 
-uint8_t* decode_filters(uint16_t enc_filters);
+void decode_filters(uint16_t enc_filters, uint8_t* filters);
+
+size_t append_chunk(blosc2_sheader* sheader, void* chunk);
+
+const blosc2_allocator* schunk_allocator(blosc2_sheader* sheader);
 
 #endif //BLOSC_SCHUNK_H
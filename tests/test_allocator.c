@@ -0,0 +1,257 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for user-defined allocators.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+void *src, *dest, *dest2;
+size_t size = 1000 * 1000;                 /* must be divisible by 4 */
+
+/* Counters for an allocator */
+typedef struct {
+  int nmallocs;
+  int nreallocs;
+  int nfrees;
+  int badalign;
+} counters;
+
+
+/* All the blocks come from blosc_test_malloc(), so that they can be freed
+   in the same way whether they asked for an alignment or not */
+static void* count_malloc(size_t size, size_t alignment, void* user_data) {
+  counters* c = (counters*)user_data;
+  void* block;
+
+  c->nmallocs++;
+  if (alignment < sizeof(void*)) {
+    alignment = sizeof(void*);
+  }
+  /* The size must be a multiple of the alignment for aligned_alloc() */
+  size = (size + alignment - 1) / alignment * alignment;
+  block = blosc_test_malloc(alignment, size);
+  if (((uintptr_t)block % alignment) != 0) {
+    c->badalign++;
+  }
+  return block;
+}
+
+static void* count_realloc(void* ptr, size_t size, size_t alignment,
+                           void* user_data) {
+  counters* c = (counters*)user_data;
+
+  if (ptr == NULL) {
+    return count_malloc(size, alignment, user_data);
+  }
+  c->nreallocs++;
+#if defined(_WIN32)
+  return _aligned_realloc(ptr, size, sizeof(void*));
+#else
+  return realloc(ptr, size);
+#endif  /* _WIN32 */
+}
+
+static void count_free(void* ptr, void* user_data) {
+  ((counters*)user_data)->nfrees++;
+  blosc_test_free(ptr);
+}
+
+
+/* Check that a per-context allocator is used for all the memory */
+static char *test_context_allocator() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc2_allocator allocator;
+  counters c;
+  blosc_context *cctx, *dctx;
+  int i, cbytes, nbytes;
+
+  memset(&c, 0, sizeof(c));
+  allocator.malloc_fn = count_malloc;
+  allocator.realloc_fn = count_realloc;
+  allocator.free_fn = count_free;
+  allocator.user_data = &c;
+
+  for (i = 1; i <= 4; i += 3) {
+    cparams.typesize = 4;
+    cparams.nthreads = (uint8_t)i;
+    cparams.allocator = &allocator;
+    dparams.nthreads = (uint8_t)i;
+    dparams.allocator = &allocator;
+    cctx = blosc2_create_cctx(&cparams);
+    dctx = blosc2_create_dctx(&dparams);
+    cbytes = blosc2_compress_ctx(cctx, size, src, dest, size + 16);
+    mu_assert("ERROR: cbytes is not correct", cbytes > 0 && cbytes < (int)size);
+    nbytes = blosc2_decompress_ctx(dctx, dest, dest2, size);
+    mu_assert("ERROR: nbytes incorrect", nbytes == (int)size);
+    mu_assert("ERROR: roundtrip failed", memcmp(src, dest2, size) == 0);
+    blosc2_free_ctx(cctx);
+    blosc2_free_ctx(dctx);
+  }
+
+  mu_assert("ERROR: the allocator has not been used", c.nmallocs > 0);
+  mu_assert("ERROR: the alignment hint is not honored", c.badalign == 0);
+  mu_assert("ERROR: leaks or double frees", c.nmallocs == c.nfrees);
+
+  return 0;
+}
+
+
+/* Check that the global allocator is used by super-chunks */
+static char *test_global_allocator() {
+  blosc2_allocator allocator;
+  blosc2_sparams sparams;
+  blosc2_sheader* schunk;
+  counters c;
+  void* packed;
+  void* chunk;
+  int dsize;
+
+  /* Incomplete allocators are rejected */
+  memset(&allocator, 0, sizeof(allocator));
+  mu_assert("ERROR: incomplete allocator is accepted",
+            blosc2_set_allocator(&allocator) < 0);
+
+  memset(&c, 0, sizeof(c));
+  allocator.malloc_fn = count_malloc;
+  allocator.realloc_fn = count_realloc;
+  allocator.free_fn = count_free;
+  allocator.user_data = &c;
+  mu_assert("ERROR: cannot set the allocator",
+            blosc2_set_allocator(&allocator) == 0);
+
+  memset(&sparams, 0, sizeof(sparams));
+  sparams.filters[0] = BLOSC_SHUFFLE;
+  sparams.compressor = BLOSC_BLOSCLZ;
+  sparams.clevel = 5;
+  schunk = blosc2_new_schunk(&sparams);
+  mu_assert("ERROR: cannot append",
+            blosc2_append_buffer(schunk, 4, size, src) == 1);
+  packed = blosc2_pack_schunk(schunk);
+  mu_assert("ERROR: cannot pack", packed != NULL);
+  packed = blosc2_packed_append_buffer(packed, 4, size, src);
+  mu_assert("ERROR: cannot append to packed", packed != NULL);
+  dsize = blosc2_packed_decompress_chunk(packed, 1, &chunk);
+  mu_assert("ERROR: decompression error", dsize == (int)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, chunk, size) == 0);
+  mu_assert("ERROR: the realloc function has not been used", c.nreallocs > 0);
+
+  blosc2_destroy_schunk(schunk);
+  blosc_test_free(chunk);
+  c.nfrees++;
+  blosc_test_free(packed);
+  c.nfrees++;
+  blosc2_set_allocator(NULL);
+
+  mu_assert("ERROR: the allocator has not been used", c.nmallocs > 0);
+  mu_assert("ERROR: leaks or double frees", c.nmallocs == c.nfrees);
+
+  return 0;
+}
+
+
+/* Check that super-chunks keep the allocator they were created with */
+static char *test_schunk_allocator() {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_allocator allocator, other;
+  blosc2_sheader* schunk;
+  void* packed;
+  counters c, c2;
+  int i;
+
+  memset(&c, 0, sizeof(c));
+  allocator.malloc_fn = count_malloc;
+  allocator.realloc_fn = count_realloc;
+  allocator.free_fn = count_free;
+  allocator.user_data = &c;
+  memset(&c2, 0, sizeof(c2));
+  other = allocator;
+  other.user_data = &c2;
+
+  blosc2_set_allocator(&allocator);
+  sparams.compressor = BLOSC_BLOSCLZ;
+  schunk = blosc2_new_schunk(&sparams);
+  blosc2_set_allocator(NULL);
+  packed = blosc2_pack_schunk(schunk);
+  free(packed);
+
+  /* The arrays of chunk pointers are grown with the allocator too */
+  blosc2_set_allocator(&other);
+  for (i = 0; i < 20; i++) {
+    mu_assert("ERROR: cannot append",
+              blosc2_append_buffer(schunk, 4, size, src) == (size_t)i + 1);
+  }
+  blosc2_destroy_schunk(schunk);
+  blosc2_set_allocator(NULL);
+  mu_assert("ERROR: the allocator of the super-chunk has not been used",
+            c.nmallocs > 20);
+  mu_assert("ERROR: leaks or double frees", c.nmallocs == c.nfrees);
+  mu_assert("ERROR: the new allocator has been used for the super-chunk",
+            c2.nmallocs == 0 && c2.nfrees == 0);
+
+  /* Unpacked super-chunks too */
+  blosc2_set_allocator(&allocator);
+  schunk = blosc2_new_schunk(&sparams);
+  blosc2_append_buffer(schunk, 4, size, src);
+  packed = blosc2_pack_schunk(schunk);
+  blosc2_destroy_schunk(schunk);
+  schunk = blosc2_unpack_schunk(packed);
+  blosc2_set_allocator(&other);
+  blosc2_append_buffer(schunk, 4, size, src);
+  blosc2_destroy_schunk(schunk);
+  blosc2_set_allocator(NULL);
+  blosc_test_free(packed);
+  c.nfrees++;
+  mu_assert("ERROR: leaks or double frees", c.nmallocs == c.nfrees);
+  mu_assert("ERROR: the new allocator has been used for the super-chunk",
+            c2.nmallocs == 0 && c2.nfrees == 0);
+
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_context_allocator);
+  mu_run_test(test_global_allocator);
+  mu_run_test(test_schunk_allocator);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  int result;
+  size_t i;
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + 16);
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  _src = (int32_t *)src;
+  for (i=0; i < (size/4); i++) {
+    _src[i] = (int32_t)i;
+  }
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+  blosc_destroy();
+
+  return result;
+}
@@ -85,6 +85,52 @@ static char *test_blocksize() {
   return 0;
 }
 
+static char *test_blocksize_info() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_blocksize_info info;
+  blosc_context* cctx;
+  size_t nbytes_, cbytes_, blocksize;
+  int nblocks_shuffle;
+  int csize;
+
+  cparams.typesize = (uint8_t)typesize;
+  cparams.clevel = 9;
+  cctx = blosc2_create_cctx(&cparams);
+  csize = blosc2_get_blocksize_info(cctx, size, &info);
+  mu_assert("ERROR: blocksize_info failed", csize == info.blocksize);
+  mu_assert("ERROR: l1_size incorrect", info.l1_size > 0);
+  mu_assert("ERROR: blocksize incorrect",
+            info.blocksize > 0 && info.blocksize % typesize == 0);
+  if (info.l2_size > 0 && info.blocksize > info.l1_size) {
+    mu_assert("ERROR: the blocks in use do not fit in L2",
+              info.blocksize * info.nblocks_in_use <= info.l2_size);
+  }
+  nblocks_shuffle = info.nblocks_in_use;
+
+  /* The decision is the one used for compressing */
+  csize = blosc2_compress_ctx(cctx, size, src, dest2, size);
+  mu_assert("ERROR: compression failed", csize > 0);
+  blosc_cbuffer_sizes(dest2, &nbytes_, &cbytes_, &blocksize);
+  mu_assert("ERROR: blocksize differs", blocksize == (size_t)info.blocksize);
+  blosc2_free_ctx(cctx);
+
+  /* bitshuffle needs more temporaries */
+  cparams.filtercode = BLOSC_BITSHUFFLE;
+  cctx = blosc2_create_cctx(&cparams);
+  blosc2_get_blocksize_info(cctx, size, &info);
+  mu_assert("ERROR: nblocks_in_use incorrect",
+            info.nblocks_in_use > nblocks_shuffle);
+  blosc2_free_ctx(cctx);
+
+  /* A forced blocksize is kept */
+  cparams.blocksize = 4096;
+  cctx = blosc2_create_cctx(&cparams);
+  mu_assert("ERROR: forced blocksize incorrect",
+            blosc2_get_blocksize_info(cctx, size, &info) == 4096);
+  blosc2_free_ctx(cctx);
+  return 0;
+}
+
 
 static char* all_tests() {
   mu_run_test(test_cbuffer_sizes);
@@ -93,6 +139,7 @@ static char* all_tests() {
   mu_run_test(test_cbuffer_complib);
   mu_run_test(test_nthreads);
   mu_run_test(test_blocksize);
+  mu_run_test(test_blocksize_info);
   return 0;
 }
 
@@ -0,0 +1,156 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for appending many buffers to super-chunks in one call.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define NBUFFERS 40
+#define MAXITEMS (50 * 1000)
+#define NITEMS (NBUFFERS * MAXITEMS)
+
+/* Global vars */
+int32_t *src, *dest;
+const void* srcs[NBUFFERS];
+size_t sizes[NBUFFERS];
+
+
+static blosc2_sheader* new_schunk(int delta, int nthreads) {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+
+  sparams.compressor = BLOSC_LZ4;
+  sparams.nthreads = (uint8_t)nthreads;
+  if (delta) {
+    sparams.filters[0] = BLOSC_DELTA;
+    sparams.filters[1] = BLOSC_SHUFFLE;
+  }
+  schunk = blosc2_new_schunk(&sparams);
+  if (delta) {
+    blosc2_set_delta_ref(schunk, sizeof(int32_t), MAXITEMS * sizeof(int32_t),
+                         src);
+  }
+  return schunk;
+}
+
+/* Decompress the chunks of `schunk` from `first` on and compare them with
+   the buffers */
+static int check_chunks(blosc2_sheader* schunk, int first) {
+  int i, nbytes;
+
+  for (i = 0; i < NBUFFERS; i++) {
+    nbytes = blosc2_decompress_chunk(schunk, first + i, dest,
+                                     MAXITEMS * sizeof(int32_t));
+    if (nbytes != (int)sizes[i] || memcmp(dest, srcs[i], sizes[i]) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static char *run_append(int delta, int nthreads) {
+  blosc2_sheader *schunk, *expected;
+  int i;
+
+  schunk = new_schunk(delta, nthreads);
+  expected = new_schunk(delta, 1);
+  for (i = 0; i < NBUFFERS; i++) {
+    blosc2_append_buffer(expected, sizeof(int32_t), sizes[i], (void*)srcs[i]);
+  }
+
+  mu_assert("ERROR: append failed",
+            (int64_t)blosc2_append_buffers(schunk, sizeof(int32_t),
+                                           NBUFFERS, srcs, sizes) == NBUFFERS);
+  mu_assert("ERROR: append failed",
+            (int64_t)blosc2_append_buffers(schunk, sizeof(int32_t),
+                                           NBUFFERS, srcs, sizes) == 2 * NBUFFERS);
+  mu_assert("ERROR: empty append failed",
+            (int64_t)blosc2_append_buffers(schunk, sizeof(int32_t),
+                                           0, srcs, sizes) == 2 * NBUFFERS);
+  mu_assert("ERROR: wrong nbytes", schunk->nbytes == 2 * expected->nbytes);
+  mu_assert("ERROR: chunks differ", check_chunks(schunk, 0));
+  mu_assert("ERROR: chunks differ", check_chunks(schunk, NBUFFERS));
+  mu_assert("ERROR: chunks differ from blosc2_append_buffer()",
+            check_chunks(expected, 0));
+
+  blosc2_destroy_schunk(schunk);
+  blosc2_destroy_schunk(expected);
+  return 0;
+}
+
+static char *test_serial() {
+  return run_append(0, 1);
+}
+
+static char *test_threads() {
+  return run_append(0, 4);
+}
+
+static char *test_delta_threads() {
+  return run_append(1, 4);
+}
+
+static char *test_delta_ref() {
+  /* The delta reference is set from the first buffer if missing */
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+
+  sparams.nthreads = 2;
+  sparams.filters[0] = BLOSC_DELTA;
+  sparams.filters[1] = BLOSC_SHUFFLE;
+  schunk = blosc2_new_schunk(&sparams);
+  mu_assert("ERROR: append failed",
+            (int64_t)blosc2_append_buffers(schunk, sizeof(int32_t),
+                                           NBUFFERS, srcs, sizes) == NBUFFERS);
+  mu_assert("ERROR: delta reference not set", schunk->filters_chunk != NULL);
+  mu_assert("ERROR: chunks differ", check_chunks(schunk, 0));
+  blosc2_destroy_schunk(schunk);
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_serial);
+  mu_run_test(test_threads);
+  mu_run_test(test_delta_threads);
+  mu_run_test(test_delta_ref);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int result;
+  int32_t i;
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, MAXITEMS * sizeof(int32_t));
+  blosc_test_fill_sequence(src, NITEMS);
+  /* Buffers of different sizes, some smaller than a block */
+  for (i = 0; i < NBUFFERS; i++) {
+    srcs[i] = src + i * MAXITEMS;
+    sizes[i] = (i % 4 == 0) ? MAXITEMS * sizeof(int32_t) :
+               (size_t)((i * 997) % MAXITEMS + 1) * sizeof(int32_t);
+  }
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_destroy();
+
+  return result;
+}
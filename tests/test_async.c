@@ -0,0 +1,162 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the asynchronous compression/decompression calls.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define NCALLS 4
+
+/* Global vars */
+void *src, *dest[NCALLS], *dest2[NCALLS];
+size_t size = 1000 * 1000;                 /* must be divisible by 4 */
+int callback_result[NCALLS];
+
+
+static void callback(blosc2_async* handle, int result, void* user_data) {
+  callback_result[*(int*)user_data] = result;
+}
+
+
+/* Run several calls concurrently with different contexts */
+static char *run_async(int nthreads, blosc2_threadpool* pool) {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx[NCALLS], *dctx[NCALLS];
+  blosc2_async* handle[NCALLS];
+  int ids[NCALLS];
+  int cbytes[NCALLS];
+  int i, nbytes;
+
+  cparams.typesize = 4;
+  cparams.nthreads = (uint8_t)nthreads;
+  cparams.threadpool = pool;
+  dparams.nthreads = (uint8_t)nthreads;
+  dparams.threadpool = pool;
+  for (i = 0; i < NCALLS; i++) {
+    ids[i] = i;
+    callback_result[i] = -1;
+    cctx[i] = blosc2_create_cctx(&cparams);
+    dctx[i] = blosc2_create_dctx(&dparams);
+  }
+
+  for (i = 0; i < NCALLS; i++) {
+    handle[i] = blosc2_compress_ctx_async(cctx[i], size, src, dest[i],
+                                          size + 16, callback, &ids[i]);
+    mu_assert("ERROR: cannot queue compression", handle[i] != NULL);
+  }
+  /* Check polling on the last one before waiting */
+  while (!blosc2_async_poll(handle[NCALLS - 1])) { }
+  for (i = 0; i < NCALLS; i++) {
+    cbytes[i] = blosc2_async_wait(handle[i]);
+    mu_assert("ERROR: cbytes is not correct",
+              cbytes[i] > 0 && cbytes[i] < (int)size);
+    mu_assert("ERROR: callback result is not correct",
+              callback_result[i] == cbytes[i]);
+  }
+
+  for (i = 0; i < NCALLS; i++) {
+    memset(dest2[i], 0, size);
+    handle[i] = blosc2_decompress_ctx_async(dctx[i], dest[i], dest2[i], size,
+                                            NULL, NULL);
+    mu_assert("ERROR: cannot queue decompression", handle[i] != NULL);
+  }
+  for (i = 0; i < NCALLS; i++) {
+    nbytes = blosc2_async_wait(handle[i]);
+    mu_assert("ERROR: nbytes incorrect", nbytes == (int)size);
+    mu_assert("ERROR: roundtrip failed", memcmp(src, dest2[i], size) == 0);
+  }
+
+  for (i = 0; i < NCALLS; i++) {
+    blosc2_free_ctx(cctx[i]);
+    blosc2_free_ctx(dctx[i]);
+  }
+
+  return 0;
+}
+
+
+static char *test_serial() {
+  return run_async(1, NULL);
+}
+
+static char *test_private_threads() {
+  return run_async(3, NULL);
+}
+
+static char *test_shared_pool() {
+  blosc2_threadpool* pool = blosc2_create_threadpool(2);
+  char* result = run_async(3, pool);
+
+  blosc2_free_threadpool(pool);
+  return result;
+}
+
+/* Check that the error codes are returned */
+static char *test_error() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  blosc2_async* handle;
+
+  cparams.typesize = 4;
+  cctx = blosc2_create_cctx(&cparams);
+  mu_assert("ERROR: a compression context cannot decompress",
+            blosc2_decompress_ctx_async(cctx, dest[0], dest2[0], size,
+                                        NULL, NULL) == NULL);
+  /* Not enough room for the header */
+  handle = blosc2_compress_ctx_async(cctx, size, src, dest[0], 8, NULL, NULL);
+  mu_assert("ERROR: cannot queue compression", handle != NULL);
+  mu_assert("ERROR: should not fit in destination",
+            blosc2_async_wait(handle) == 0);
+  blosc2_free_ctx(cctx);
+
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_serial);
+  mu_run_test(test_private_threads);
+  mu_run_test(test_shared_pool);
+  mu_run_test(test_error);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  int result;
+  size_t i;
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  for (i = 0; i < NCALLS; i++) {
+    dest[i] = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + 16);
+    dest2[i] = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  }
+  _src = (int32_t *)src;
+  for (i=0; i < (size/4); i++) {
+    _src[i] = (int32_t)i;
+  }
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  for (i = 0; i < NCALLS; i++) {
+    blosc_test_free(dest[i]);
+    blosc_test_free(dest2[i]);
+  }
+
+  return result;
+}
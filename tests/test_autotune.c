@@ -0,0 +1,272 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the autotuning of compression params (BLOSC_AUTO).
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+/* Global vars */
+void *src, *random_src, *dest, *dest2;
+size_t size = 4 * 1000 * 1000;             /* must be divisible by 4 */
+
+
+/* Compress with `cctx` and check the roundtrip */
+static char *roundtrip(blosc_context* cctx, const void* data, int* cbytes) {
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context* dctx = blosc2_create_dctx(&dparams);
+  int nbytes;
+
+  *cbytes = blosc2_compress_ctx(cctx, size, data, dest, size + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: cbytes is not correct",
+            *cbytes > 0 && *cbytes <= (int)size + BLOSC_MAX_OVERHEAD);
+  memset(dest2, 0, size);
+  nbytes = blosc2_decompress_ctx(dctx, dest, dest2, size);
+  mu_assert("ERROR: nbytes incorrect", nbytes == (int)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(data, dest2, size) == 0);
+  blosc2_free_ctx(dctx);
+
+  return 0;
+}
+
+
+/* The chosen params should compress regular data well */
+static char *test_auto() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  char* result;
+  int i, cbytes;
+
+  cparams.typesize = 4;
+  cparams.compcode = BLOSC_AUTO;
+  cctx = blosc2_create_cctx(&cparams);
+  /* The first call tunes the params and the rest reuse them */
+  for (i = 0; i < 3; i++) {
+    result = roundtrip(cctx, src, &cbytes);
+    if (result != 0) {
+      return result;
+    }
+    mu_assert("ERROR: the chosen params do not compress",
+              cbytes < (int)size / 10);
+    mu_assert("ERROR: the codec in the header is not valid",
+              blosc_cbuffer_complib(dest) != NULL);
+  }
+  blosc2_free_ctx(cctx);
+
+  return 0;
+}
+
+
+/* Weighting the ratio only should compress at least as well as the
+   default params */
+static char *test_ratio_weight() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  char* result;
+  int cbytes, cbytes_default;
+
+  cparams.typesize = 4;
+  cctx = blosc2_create_cctx(&cparams);
+  result = roundtrip(cctx, src, &cbytes_default);
+  blosc2_free_ctx(cctx);
+  if (result != 0) {
+    return result;
+  }
+
+  cparams.compcode = BLOSC_AUTO;
+  cparams.tune_ratio_weight = 1.;
+  cctx = blosc2_create_cctx(&cparams);
+  result = roundtrip(cctx, src, &cbytes);
+  blosc2_free_ctx(cctx);
+  if (result != 0) {
+    return result;
+  }
+  mu_assert("ERROR: the ratio is worse than with the default params",
+            cbytes <= cbytes_default + cbytes_default / 20);
+
+  return 0;
+}
+
+
+/* Weighting the speed only should not compress better than weighting
+   the ratio only */
+static char *test_speed_weight() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  char* result;
+  int cbytes_ratio, cbytes_speed;
+
+  cparams.typesize = 4;
+  cparams.compcode = BLOSC_AUTO;
+  cparams.tune_ratio_weight = 1.;
+  cctx = blosc2_create_cctx(&cparams);
+  result = roundtrip(cctx, src, &cbytes_ratio);
+  blosc2_free_ctx(cctx);
+  if (result != 0) {
+    return result;
+  }
+
+  cparams.tune_ratio_weight = 0.;
+  cctx = blosc2_create_cctx(&cparams);
+  mu_assert("ERROR: a zero weight is not accepted", cctx != NULL);
+  result = roundtrip(cctx, src, &cbytes_speed);
+  blosc2_free_ctx(cctx);
+  if (result != 0) {
+    return result;
+  }
+  mu_assert("ERROR: the speed weight compresses better than the ratio one",
+            cbytes_ratio <= cbytes_speed + cbytes_speed / 20);
+
+  return 0;
+}
+
+
+/* Weights out of range should be rejected */
+static char *test_invalid_weight() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+
+  cparams.compcode = BLOSC_AUTO;
+  cparams.tune_ratio_weight = 1.5;
+  mu_assert("ERROR: a weight greater than 1 is accepted",
+            blosc2_create_cctx(&cparams) == NULL);
+  cparams.tune_ratio_weight = NAN;
+  mu_assert("ERROR: a NaN weight is accepted",
+            blosc2_create_cctx(&cparams) == NULL);
+
+  return 0;
+}
+
+
+/* A change in the data statistics should be handled */
+static char *test_drift() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  char* result;
+  int i, cbytes;
+
+  cparams.typesize = 4;
+  cparams.compcode = BLOSC_AUTO;
+  cparams.nthreads = 2;
+  cctx = blosc2_create_cctx(&cparams);
+  for (i = 0; i < 4; i++) {
+    result = roundtrip(cctx, (i % 2) ? random_src : src, &cbytes);
+    if (result != 0) {
+      return result;
+    }
+  }
+  blosc2_free_ctx(cctx);
+
+  return 0;
+}
+
+
+/* A blocksize passed by the user is kept */
+static char *test_forced_blocksize() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  size_t nbytes, cbytes_, blocksize;
+  char* result;
+  int cbytes;
+
+  cparams.typesize = 4;
+  cparams.compcode = BLOSC_AUTO;
+  cparams.blocksize = 64 * 1024;
+  cctx = blosc2_create_cctx(&cparams);
+  result = roundtrip(cctx, src, &cbytes);
+  blosc2_free_ctx(cctx);
+  if (result != 0) {
+    return result;
+  }
+  blosc_cbuffer_sizes(dest, &nbytes, &cbytes_, &blocksize);
+  mu_assert("ERROR: the blocksize has changed", blocksize == 64 * 1024);
+
+  return 0;
+}
+
+
+/* The batch calls tune the params once for all the buffers */
+static char *test_batch() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  const void* srcs[2];
+  void* dests[2];
+  size_t sizes[2], destsizes[2];
+  int cbytes[2];
+  int nbytes;
+
+  cparams.typesize = 4;
+  cparams.compcode = BLOSC_AUTO;
+  cparams.nthreads = 2;
+  cctx = blosc2_create_cctx(&cparams);
+  srcs[0] = src;
+  srcs[1] = (uint8_t*)src + size / 2;
+  sizes[0] = sizes[1] = size / 2;
+  dests[0] = dest;
+  dests[1] = (uint8_t*)dest + size / 2 + BLOSC_MAX_OVERHEAD;
+  destsizes[0] = destsizes[1] = size / 2 + BLOSC_MAX_OVERHEAD;
+  mu_assert("ERROR: batch compression failed",
+            blosc2_compress_batch(cctx, 2, srcs, sizes, dests, destsizes,
+                                  cbytes) == 0);
+  blosc2_free_ctx(cctx);
+
+  memset(dest2, 0, size);
+  nbytes = blosc_decompress(dests[0], dest2, size / 2);
+  mu_assert("ERROR: nbytes incorrect", nbytes == (int)size / 2);
+  nbytes = blosc_decompress(dests[1], (uint8_t*)dest2 + size / 2, size / 2);
+  mu_assert("ERROR: nbytes incorrect", nbytes == (int)size / 2);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest2, size) == 0);
+
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_auto);
+  mu_run_test(test_ratio_weight);
+  mu_run_test(test_speed_weight);
+  mu_run_test(test_invalid_weight);
+  mu_run_test(test_drift);
+  mu_run_test(test_forced_blocksize);
+  mu_run_test(test_batch);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  int result;
+  size_t i;
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  random_src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_MAX_OVERHEAD);
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  _src = (int32_t *)src;
+  for (i=0; i < (size/4); i++) {
+    _src[i] = (int32_t)i;
+  }
+  blosc_test_fill_random(random_src, size);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(random_src);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+  blosc_destroy();
+
+  return result;
+}
@@ -0,0 +1,218 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the batch compression/decompression calls.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define NBUFFERS 50
+#define MAXSIZE (100 * 1000)
+
+/* Global vars */
+void *src, *dest[NBUFFERS], *dest2[NBUFFERS];
+const void* srcs[NBUFFERS];
+size_t sizes[NBUFFERS], destsizes[NBUFFERS];
+
+
+/* Compress and decompress a batch and compare against the single calls */
+static char *run_batch(int nthreads, blosc2_threadpool* pool) {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx, *dctx;
+  int cbytes[NBUFFERS], nbytes[NBUFFERS];
+  const void* csrcs[NBUFFERS];
+  void* cdests[NBUFFERS];
+  size_t dsizes[NBUFFERS];
+  int index[NBUFFERS];
+  void* single = blosc_test_malloc(32, MAXSIZE + BLOSC_MAX_OVERHEAD);
+  int i, n, csize;
+
+  cparams.typesize = 4;
+  cparams.nthreads = (uint8_t)nthreads;
+  cparams.threadpool = pool;
+  dparams.nthreads = (uint8_t)nthreads;
+  dparams.threadpool = pool;
+  cctx = blosc2_create_cctx(&cparams);
+  dctx = blosc2_create_dctx(&dparams);
+
+  mu_assert("ERROR: batch compression failed",
+            blosc2_compress_batch(cctx, NBUFFERS, srcs, sizes,
+                                  (void* const*)dest, destsizes, cbytes) == 0);
+  for (i = 0; i < NBUFFERS; i++) {
+    csize = blosc_compress(5, BLOSC_SHUFFLE, 4, sizes[i], srcs[i], single,
+                           destsizes[i]);
+    mu_assert("ERROR: cbytes differ from single call", cbytes[i] == csize);
+    if (nthreads == 1) {
+      /* Threads may store the blocks in a different order */
+      mu_assert("ERROR: compressed buffers differ",
+                memcmp(dest[i], single, (size_t)csize) == 0);
+    }
+  }
+
+  /* Buffers that did not fit cannot be decompressed */
+  for (i = 0, n = 0; i < NBUFFERS; i++) {
+    if (cbytes[i] > 0) {
+      csrcs[n] = dest[i];
+      cdests[n] = dest2[i];
+      dsizes[n] = sizes[i];
+      index[n++] = i;
+      memset(dest2[i], 0, MAXSIZE);
+    }
+  }
+  mu_assert("ERROR: batch decompression failed",
+            blosc2_decompress_batch(dctx, n, csrcs, cdests, dsizes,
+                                    nbytes) == 0);
+  for (i = 0; i < n; i++) {
+    mu_assert("ERROR: nbytes incorrect", nbytes[i] == (int)dsizes[i]);
+    mu_assert("ERROR: roundtrip failed",
+              memcmp(srcs[index[i]], cdests[i], dsizes[i]) == 0);
+  }
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  blosc_test_free(single);
+
+  return 0;
+}
+
+
+/* Set the sizes of the buffers; some of them may not fit in dest */
+static void set_sizes(void) {
+  int i;
+
+  for (i = 0; i < NBUFFERS; i++) {
+    sizes[i] = (size_t)(1 + (i * 7919) % MAXSIZE);
+    srcs[i] = (uint8_t*)src + (i * 4) % 1024;
+    destsizes[i] = (i % 10 == 9) ? sizes[i] / 4 : sizes[i] + BLOSC_MAX_OVERHEAD;
+  }
+}
+
+static char *test_serial() {
+  set_sizes();
+  return run_batch(1, NULL);
+}
+
+static char *test_private_threads() {
+  set_sizes();
+  return run_batch(4, NULL);
+}
+
+static char *test_shared_pool() {
+  blosc2_threadpool* pool = blosc2_create_threadpool(3);
+  char* result;
+
+  set_sizes();
+  result = run_batch(4, pool);
+  blosc2_free_threadpool(pool);
+  return result;
+}
+
+/* Check that errors are reported per buffer */
+static char *test_errors() {
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context* dctx;
+  int cbytes, nbytes[2];
+  size_t dsizes[2];
+  const void* csrcs[2];
+
+  cbytes = blosc_compress(5, BLOSC_SHUFFLE, 4, MAXSIZE, src, dest[0],
+                          MAXSIZE + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: compression failed", cbytes > 0);
+  csrcs[0] = csrcs[1] = dest[0];
+  dsizes[0] = MAXSIZE;
+  dsizes[1] = MAXSIZE / 2;    /* not enough room */
+  dparams.nthreads = 2;
+  dctx = blosc2_create_dctx(&dparams);
+  mu_assert("ERROR: error is not reported",
+            blosc2_decompress_batch(dctx, 2, csrcs, (void* const*)dest2,
+                                    dsizes, nbytes) < 0);
+  mu_assert("ERROR: first buffer should succeed", nbytes[0] == MAXSIZE);
+  mu_assert("ERROR: second buffer should fail", nbytes[1] < 0);
+  blosc2_free_ctx(dctx);
+
+  return 0;
+}
+
+/* Check that a single call after a batch uses its own context */
+static char *test_single_after_batch() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  int cbytes[2], csize;
+  size_t bsizes[2], dsizes[2];
+  const void* bsrcs[2];
+
+  cparams.typesize = 4;
+  cparams.nthreads = 4;
+  cctx = blosc2_create_cctx(&cparams);
+  bsrcs[0] = bsrcs[1] = src;
+  bsizes[0] = bsizes[1] = MAXSIZE;
+  dsizes[0] = dsizes[1] = MAXSIZE + BLOSC_MAX_OVERHEAD;
+  mu_assert("ERROR: batch compression failed",
+            blosc2_compress_batch(cctx, 2, bsrcs, bsizes, (void* const*)dest,
+                                  dsizes, cbytes) == 0);
+  /* A single block is compressed serially */
+  csize = blosc2_compress_ctx(cctx, 4000, src, dest[2],
+                              MAXSIZE + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: compression failed", csize > 0 && csize < 4000);
+  mu_assert("ERROR: decompression failed",
+            blosc_decompress(dest[2], dest2[2], MAXSIZE) == 4000);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest2[2], 4000) == 0);
+  blosc2_free_ctx(cctx);
+
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_serial);
+  mu_run_test(test_private_threads);
+  mu_run_test(test_shared_pool);
+  mu_run_test(test_errors);
+  mu_run_test(test_single_after_batch);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  int result;
+  size_t i;
+
+  blosc_init();
+  blosc_set_nthreads(1);
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, MAXSIZE + 1024);
+  for (i = 0; i < NBUFFERS; i++) {
+    dest[i] = blosc_test_malloc(BUFFER_ALIGN_SIZE, MAXSIZE + BLOSC_MAX_OVERHEAD);
+    dest2[i] = blosc_test_malloc(BUFFER_ALIGN_SIZE, MAXSIZE);
+  }
+  /* Large buffers get some uncompressible data at the end */
+  _src = (int32_t *)src;
+  for (i = 0; i < MAXSIZE / 8; i++) {
+    _src[i] = (int32_t)(i % 1000);
+  }
+  blosc_test_fill_random((uint8_t*)src + MAXSIZE / 2, MAXSIZE / 2 + 1024);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  for (i = 0; i < NBUFFERS; i++) {
+    blosc_test_free(dest[i]);
+    blosc_test_free(dest2[i]);
+  }
+  blosc_destroy();
+
+  return result;
+}
@@ -0,0 +1,261 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for the cache of decompressed blocks in contexts.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define NITEMS (8 * 4096)
+#define BLOCKSIZE (16 * 1024)    /* 4096 items; 8 blocks */
+#define ITEMS_PER_BLOCK (BLOCKSIZE / 4)
+
+/* Global vars */
+int32_t *src, *items;
+void *dest;
+
+
+static blosc_context* create_dctx(int nthreads, int nblocks) {
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+
+  dparams.nthreads = (uint8_t)nthreads;
+  dparams.block_cache_nblocks = nblocks;
+  return blosc2_create_dctx(&dparams);
+}
+
+/* Get an item of a block and check it */
+static int get_block(blosc_context* dctx, int nblock) {
+  int32_t item;
+  int start = nblock * ITEMS_PER_BLOCK + 7;
+
+  if (blosc2_getitem_ctx(dctx, dest, start, 1, &item) != 4) {
+    return 0;
+  }
+  return item == src[start];
+}
+
+static char *test_hits() {
+  blosc2_block_cache_stats stats;
+  blosc_context* dctx = create_dctx(1, 16);
+  int i;
+
+  for (i = 0; i < 10; i++) {
+    mu_assert("ERROR: getitem failed", get_block(dctx, 3));
+  }
+  mu_assert("ERROR: stats failed",
+            blosc2_get_block_cache_stats(dctx, &stats) == 0);
+  mu_assert("ERROR: misses incorrect", stats.misses == 1);
+  mu_assert("ERROR: hits incorrect", stats.hits == 9);
+  mu_assert("ERROR: nblocks incorrect", stats.nblocks == 1);
+
+  /* A range over several blocks gets the cached one and adds the others */
+  mu_assert("ERROR: getitem failed",
+            blosc2_getitem_ctx(dctx, dest, 100, NITEMS - 200, items) ==
+            (NITEMS - 200) * 4);
+  mu_assert("ERROR: getitem items are not correct",
+            memcmp(items, src + 100, (NITEMS - 200) * 4) == 0);
+  blosc2_get_block_cache_stats(dctx, &stats);
+  mu_assert("ERROR: hits incorrect", stats.hits == 10);
+  mu_assert("ERROR: nblocks incorrect", stats.nblocks == 8);
+
+  /* Regular decompression is served from the cache too */
+  memset(items, 0, NITEMS * 4);
+  mu_assert("ERROR: decompression failed",
+            blosc2_decompress_ctx(dctx, dest, items, NITEMS * 4) == NITEMS * 4);
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(items, src, NITEMS * 4) == 0);
+  blosc2_get_block_cache_stats(dctx, &stats);
+  mu_assert("ERROR: hits incorrect", stats.hits == 18);
+
+  blosc2_clear_block_cache(dctx);
+  blosc2_get_block_cache_stats(dctx, &stats);
+  mu_assert("ERROR: cache not cleared", stats.nblocks == 0);
+  mu_assert("ERROR: getitem failed", get_block(dctx, 3));
+  blosc2_get_block_cache_stats(dctx, &stats);
+  mu_assert("ERROR: misses incorrect", stats.misses == 9);
+
+  blosc2_free_ctx(dctx);
+  return 0;
+}
+
+static char *test_lru() {
+  blosc2_block_cache_stats stats;
+  blosc_context* dctx = create_dctx(1, 4);
+  int i;
+
+  for (i = 0; i < 4; i++) {
+    mu_assert("ERROR: getitem failed", get_block(dctx, i));
+  }
+  mu_assert("ERROR: getitem failed", get_block(dctx, 0));
+  /* This evicts block 1, the least recently used */
+  mu_assert("ERROR: getitem failed", get_block(dctx, 4));
+  blosc2_get_block_cache_stats(dctx, &stats);
+  mu_assert("ERROR: cache is not bounded", stats.nblocks == 4);
+  mu_assert("ERROR: hits incorrect", stats.hits == 1);
+
+  mu_assert("ERROR: getitem failed", get_block(dctx, 0));
+  blosc2_get_block_cache_stats(dctx, &stats);
+  mu_assert("ERROR: block 0 should be cached", stats.hits == 2);
+  mu_assert("ERROR: getitem failed", get_block(dctx, 1));
+  blosc2_get_block_cache_stats(dctx, &stats);
+  mu_assert("ERROR: block 1 should be evicted", stats.hits == 2);
+
+  blosc2_free_ctx(dctx);
+  return 0;
+}
+
+static char *test_threads() {
+  blosc2_block_cache_stats stats;
+  blosc_context* dctx = create_dctx(4, 8);
+  int starts[] = {10, 5000, 9000, 20000};
+  int nitems[] = {10000, 10, 20000, 30};
+  int i;
+
+  for (i = 0; i < 3; i++) {
+    memset(items, 0, NITEMS * 4);
+    mu_assert("ERROR: getitem failed",
+              blosc2_getitem_ctx(dctx, dest, 1, NITEMS - 1, items) ==
+              (NITEMS - 1) * 4);
+    mu_assert("ERROR: getitem items are not correct",
+              memcmp(items, src + 1, (NITEMS - 1) * 4) == 0);
+    mu_assert("ERROR: getitems failed",
+              blosc2_getitems_ctx(dctx, dest, starts, nitems, 4, items) ==
+              30040 * 4);
+    mu_assert("ERROR: getitems items are not correct",
+              memcmp(items + 10010, src + 9000, 20000 * 4) == 0);
+  }
+  blosc2_get_block_cache_stats(dctx, &stats);
+  mu_assert("ERROR: misses incorrect", stats.misses == 8);
+
+  blosc2_free_ctx(dctx);
+  return 0;
+}
+
+static char *test_no_cache() {
+  blosc2_block_cache_stats stats;
+  blosc_context* dctx = create_dctx(1, 0);
+
+  mu_assert("ERROR: getitem failed", get_block(dctx, 2));
+  mu_assert("ERROR: stats without cache",
+            blosc2_get_block_cache_stats(dctx, &stats) < 0);
+  blosc2_free_ctx(dctx);
+  return 0;
+}
+
+/* A buffer reused for another chunk of the same size does not hit the
+   blocks of the previous one */
+static char *test_reused_buffer() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  blosc_context* dctx = create_dctx(1, 8);
+  int32_t *data, item;
+  void* buffer;
+  int i, cbytes[2];
+
+  data = malloc(NITEMS * sizeof(int32_t));
+  buffer = malloc(NITEMS * sizeof(int32_t) + BLOSC_MAX_OVERHEAD);
+  cparams.typesize = sizeof(int32_t);
+  cparams.blocksize = BLOCKSIZE;
+  cctx = blosc2_create_cctx(&cparams);
+  for (i = 0; i < 2; i++) {
+    /* Constant chunks have the same sizes everywhere */
+    memset(data, i + 1, NITEMS * sizeof(int32_t));
+    cbytes[i] = blosc2_compress_ctx(cctx, NITEMS * sizeof(int32_t), data,
+                                    buffer,
+                                    NITEMS * sizeof(int32_t) + BLOSC_MAX_OVERHEAD);
+    mu_assert("ERROR: getitem failed",
+              blosc2_getitem_ctx(dctx, buffer, 5, 1, &item) == 4);
+    mu_assert("ERROR: stale block from the previous chunk", item == data[5]);
+  }
+  mu_assert("ERROR: the chunks should have the same size",
+            cbytes[0] == cbytes[1]);
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  free(data);
+  free(buffer);
+  return 0;
+}
+
+/* Super-chunks read their chunks through a cache */
+static char *test_schunk() {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  int i, nchunk;
+
+  sparams.compressor = BLOSC_LZ4;
+  sparams.filters[0] = BLOSC_DELTA;
+  sparams.filters[1] = BLOSC_SHUFFLE;
+  sparams.nthreads = 2;
+  sparams.block_cache_nblocks = 16;
+  schunk = blosc2_new_schunk(&sparams);
+  blosc2_set_delta_ref(schunk, sizeof(int32_t), NITEMS * sizeof(int32_t), src);
+  for (i = 0; i < 4; i++) {
+    blosc2_append_buffer(schunk, sizeof(int32_t), NITEMS * sizeof(int32_t),
+                         src);
+  }
+  for (i = 0; i < 8; i++) {
+    nchunk = (i * 3) % 4;
+    memset(items, 0, NITEMS * sizeof(int32_t));
+    mu_assert("ERROR: chunk decompression failed",
+              blosc2_decompress_chunk(schunk, nchunk, items,
+                                      NITEMS * sizeof(int32_t)) ==
+              NITEMS * sizeof(int32_t));
+    mu_assert("ERROR: decompressed chunk differs",
+              memcmp(items, src, NITEMS * sizeof(int32_t)) == 0);
+  }
+  blosc2_destroy_schunk(schunk);
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_hits);
+  mu_run_test(test_lru);
+  mu_run_test(test_threads);
+  mu_run_test(test_no_cache);
+  mu_run_test(test_reused_buffer);
+  mu_run_test(test_schunk);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  int result;
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  items = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE,
+                           NITEMS * sizeof(int32_t) + BLOSC_MAX_OVERHEAD);
+  blosc_test_fill_sequence(src, NITEMS);
+  cparams.typesize = sizeof(int32_t);
+  cparams.blocksize = BLOCKSIZE;
+  cctx = blosc2_create_cctx(&cparams);
+  blosc2_compress_ctx(cctx, NITEMS * sizeof(int32_t), src, dest,
+                      NITEMS * sizeof(int32_t) + BLOSC_MAX_OVERHEAD);
+  blosc2_free_ctx(cctx);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(items);
+  blosc_test_free(dest);
+  blosc_destroy();
+
+  return result;
+}
@@ -107,6 +107,37 @@ static void blosc_test_fill_random(void* const ptr, const size_t size) {
   }
 }
 
+/** Fills a buffer of `nitems` 32-bit integers with a compressible
+    sequence. */
+static void blosc_test_fill_sequence(int32_t* const ptr, const size_t nitems) {
+  size_t k;
+  for (k = 0; k < nitems; k++) {
+    ptr[k] = (int32_t)(k * 3 + (k % 7));
+  }
+}
+
+/*
+  Test suites.
+*/
+
+/** Runs the test suite `all_tests` of the program `name` and prints its
+    outcome.  Returns the exit status for the program. */
+static int blosc_test_run_suite(const char* const name, char* (*all_tests)(void)) {
+  char* result;
+
+  printf("STARTING TESTS for %s", name);
+  result = all_tests();
+  if (result != 0) {
+    printf(" (%s)\n", result);
+  }
+  else {
+    printf(" ALL TESTS PASSED");
+  }
+  printf("\tTests run: %d\n", tests_run);
+
+  return result != 0;
+}
+
 /*
   Argument parsing.
 */
@@ -0,0 +1,292 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for compression streams.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define NITEMS (300 * 1000 + 5)
+#define CHUNKSIZE (256 * 1024 + 12)
+#define MAXCHUNKS 64
+
+/* Global vars */
+int32_t *src, *dest;
+void* chunks[MAXCHUNKS];
+int nchunks;
+
+
+/* Keep a copy of the chunks coming out of a stream */
+static int keep_chunk(const void* chunk, int32_t cbytes, void* user_data) {
+  size_t nbytes, cbytes_, blocksize;
+
+  if (nchunks == MAXCHUNKS) {
+    return -1;
+  }
+  blosc_cbuffer_sizes(chunk, &nbytes, &cbytes_, &blocksize);
+  if ((int32_t)cbytes_ != cbytes || *(int*)user_data != 42) {
+    return -2;
+  }
+  chunks[nchunks] = malloc((size_t)cbytes);
+  memcpy(chunks[nchunks], chunk, (size_t)cbytes);
+  nchunks++;
+  return 0;
+}
+
+static int reject_chunk(const void* chunk, int32_t cbytes, void* user_data) {
+  return -7;
+}
+
+static void free_chunks(void) {
+  int i;
+
+  for (i = 0; i < nchunks; i++) {
+    free(chunks[i]);
+  }
+  nchunks = 0;
+}
+
+/* Decompress the kept chunks one after the other into `dest` */
+static int decompress_chunks(void) {
+  uint8_t* _dest = (uint8_t*)dest;
+  int i, nbytes, ntbytes = 0;
+
+  for (i = 0; i < nchunks; i++) {
+    nbytes = blosc_decompress(chunks[i], _dest + ntbytes,
+                              NITEMS * sizeof(int32_t) - ntbytes);
+    if (nbytes < 0) {
+      return nbytes;
+    }
+    ntbytes += nbytes;
+  }
+  return ntbytes;
+}
+
+/* Write `nbytes` of `src` in pieces of random sizes (up to `maxpiece`) */
+static int write_pieces(blosc2_cstream* stream, size_t nbytes, int maxpiece) {
+  uint8_t* _src = (uint8_t*)src;
+  size_t pos = 0, n;
+  int rc, nchunks_ = 0;
+
+  while (pos < nbytes) {
+    n = (size_t)(rand() % maxpiece + 1);
+    if (n > nbytes - pos) {
+      n = nbytes - pos;
+    }
+    rc = blosc2_cstream_write(stream, _src + pos, n);
+    if (rc < 0) {
+      return rc;
+    }
+    nchunks_ += rc;
+    pos += n;
+  }
+  return nchunks_;
+}
+
+static char *run_stream(int clevel, int filtercode, int maxpiece) {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  blosc2_cstream* stream;
+  int user_data = 42;
+  int rc, nchunks_;
+
+  cparams.typesize = sizeof(int32_t);
+  cparams.clevel = (uint8_t)clevel;
+  cparams.filtercode = (uint8_t)filtercode;
+  cctx = blosc2_create_cctx(&cparams);
+  stream = blosc2_create_cstream(cctx, CHUNKSIZE, keep_chunk, &user_data);
+  mu_assert("ERROR: stream not created", stream != NULL);
+
+  nchunks_ = write_pieces(stream, NITEMS * sizeof(int32_t), maxpiece);
+  mu_assert("ERROR: stream write failed", nchunks_ >= 0);
+  mu_assert("ERROR: full chunks not emitted",
+            nchunks_ == (int)(NITEMS * sizeof(int32_t) / CHUNKSIZE));
+  rc = blosc2_cstream_end(stream);
+  mu_assert("ERROR: the last chunk not emitted", rc == 1);
+  mu_assert("ERROR: wrong number of chunks", nchunks == nchunks_ + 1);
+
+  memset(dest, 0, NITEMS * sizeof(int32_t));
+  mu_assert("ERROR: decompression failed",
+            decompress_chunks() == NITEMS * (int)sizeof(int32_t));
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(src, dest, NITEMS * sizeof(int32_t)) == 0);
+
+  free_chunks();
+  blosc2_free_ctx(cctx);
+  return 0;
+}
+
+static char *test_small_pieces() {
+  return run_stream(5, BLOSC_SHUFFLE, 1000);
+}
+
+static char *test_large_pieces() {
+  char* result;
+
+  result = run_stream(5, BLOSC_BITSHUFFLE, 300 * 1000);
+  if (result != 0) {
+    return result;
+  }
+  return run_stream(9, BLOSC_NOSHUFFLE, 100 * 1000);
+}
+
+static char *test_memcpyed() {
+  return run_stream(0, BLOSC_SHUFFLE, 5000);
+}
+
+static char *test_incompressible() {
+  int32_t* saved = src;
+  char* result;
+  int32_t i;
+
+  src = malloc(NITEMS * sizeof(int32_t));
+  for (i = 0; i < NITEMS; i++) {
+    src[i] = rand();
+  }
+  result = run_stream(9, BLOSC_SHUFFLE, 20000);
+  free(src);
+  src = saved;
+  return result;
+}
+
+static char *test_flush() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  blosc2_cstream* stream;
+  size_t nbytes, cbytes, blocksize;
+  int user_data = 42;
+
+  cparams.typesize = sizeof(int32_t);
+  cctx = blosc2_create_cctx(&cparams);
+  stream = blosc2_create_cstream(cctx, CHUNKSIZE, keep_chunk, &user_data);
+
+  /* Nothing is pending */
+  mu_assert("ERROR: empty flush", blosc2_cstream_flush(stream) == 0);
+  /* Flushes in the middle of a block and at a block boundary */
+  mu_assert("ERROR: write failed", write_pieces(stream, 1000, 100) == 0);
+  mu_assert("ERROR: flush failed", blosc2_cstream_flush(stream) == 1);
+  blosc2_cstream_write(stream, (uint8_t*)src + 1000, 64 * 1024 - 1000);
+  mu_assert("ERROR: flush failed", blosc2_cstream_flush(stream) == 1);
+  blosc2_cstream_write(stream, (uint8_t*)src + 64 * 1024,
+                       NITEMS * sizeof(int32_t) - 64 * 1024);
+  blosc2_cstream_end(stream);
+
+  blosc_cbuffer_sizes(chunks[0], &nbytes, &cbytes, &blocksize);
+  mu_assert("ERROR: first chunk size", nbytes == 1000);
+  blosc_cbuffer_sizes(chunks[1], &nbytes, &cbytes, &blocksize);
+  mu_assert("ERROR: second chunk size", nbytes == 64 * 1024 - 1000);
+  mu_assert("ERROR: decompression failed",
+            decompress_chunks() == NITEMS * (int)sizeof(int32_t));
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(src, dest, NITEMS * sizeof(int32_t)) == 0);
+
+  /* Errors in the output are passed along */
+  stream = blosc2_create_cstream(cctx, CHUNKSIZE, reject_chunk, NULL);
+  mu_assert("ERROR: output error not reported",
+            blosc2_cstream_write(stream, src, CHUNKSIZE) == -7);
+  blosc2_cstream_end(stream);
+
+  free_chunks();
+  blosc2_free_ctx(cctx);
+  return 0;
+}
+
+static char *run_schunk(int delta) {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  blosc_context* cctx;
+  blosc2_cstream* stream;
+  uint8_t* _dest = (uint8_t*)dest;
+  int i, nbytes, ntbytes = 0;
+
+  sparams.compressor = BLOSC_BLOSCLZ;
+  if (delta) {
+    sparams.filters[0] = BLOSC_DELTA;
+    sparams.filters[1] = BLOSC_SHUFFLE;
+  }
+  schunk = blosc2_new_schunk(&sparams);
+
+  cparams.typesize = sizeof(int32_t);
+  cparams.schunk = schunk;
+  cctx = blosc2_create_cctx(&cparams);
+  if (delta) {
+    /* The delta reference must be set first */
+    mu_assert("ERROR: missing delta reference not detected",
+              blosc2_create_cstream(cctx, CHUNKSIZE, NULL, NULL) == NULL);
+    blosc2_set_delta_ref(schunk, sizeof(int32_t), CHUNKSIZE, src);
+  }
+  stream = blosc2_create_cstream(cctx, CHUNKSIZE, NULL, NULL);
+  mu_assert("ERROR: stream not created", stream != NULL);
+  mu_assert("ERROR: stream write failed",
+            write_pieces(stream, NITEMS * sizeof(int32_t), 50000) >= 0);
+  blosc2_cstream_end(stream);
+
+  mu_assert("ERROR: wrong number of chunks",
+            schunk->nchunks == NITEMS * sizeof(int32_t) / CHUNKSIZE + 1);
+  mu_assert("ERROR: wrong nbytes in super-chunk",
+            schunk->nbytes == NITEMS * sizeof(int32_t));
+  for (i = 0; i < schunk->nchunks; i++) {
+    nbytes = blosc2_decompress_chunk(schunk, i, _dest + ntbytes,
+                                     NITEMS * sizeof(int32_t) - ntbytes);
+    mu_assert("ERROR: chunk decompression failed", nbytes > 0);
+    ntbytes += nbytes;
+  }
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(src, dest, NITEMS * sizeof(int32_t)) == 0);
+
+  blosc2_free_ctx(cctx);
+  blosc2_destroy_schunk(schunk);
+  return 0;
+}
+
+static char *test_schunk() {
+  return run_schunk(0);
+}
+
+static char *test_schunk_delta() {
+  return run_schunk(1);
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_small_pieces);
+  mu_run_test(test_large_pieces);
+  mu_run_test(test_memcpyed);
+  mu_run_test(test_incompressible);
+  mu_run_test(test_flush);
+  mu_run_test(test_schunk);
+  mu_run_test(test_schunk_delta);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int result;
+
+  blosc_init();
+  srand(1);
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  blosc_test_fill_sequence(src, NITEMS);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_destroy();
+
+  return result;
+}
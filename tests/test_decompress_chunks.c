@@ -0,0 +1,158 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for decompressing ranges of chunks of super-chunks.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define CHUNKITEMS (20 * 1000)
+#define NCHUNKS 600
+#define NITEMS (CHUNKITEMS * NCHUNKS)
+
+/* Global vars */
+int32_t *src, *dest;
+
+
+/* Append the source data to `schunk` as chunks of different sizes, and
+   get the offsets (in items) where each chunk starts.  Returns 0 if a
+   chunk does not compress well. */
+static int fill_schunk(blosc2_sheader* schunk, int64_t* offsets) {
+  int64_t offset = 0, cbytes;
+  int i, nitems;
+
+  for (i = 0; i < NCHUNKS; i++) {
+    /* Some chunks are smaller than a block (the first one has 1 item) */
+    nitems = (i % 5 == 0) ? (i * 37) % 1000 + 1 : CHUNKITEMS;
+    offsets[i] = offset;
+    cbytes = schunk->cbytes;
+    blosc2_append_buffer(schunk, sizeof(int32_t), nitems * sizeof(int32_t),
+                         src + offset);
+    if (nitems == CHUNKITEMS &&
+        (schunk->cbytes - cbytes) * 10 > nitems * (int64_t)sizeof(int32_t)) {
+      return 0;
+    }
+    offset += nitems;
+  }
+  offsets[NCHUNKS] = offset;
+  return 1;
+}
+
+static char *run_chunks(int delta, int nthreads, const char* path) {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  int64_t offsets[NCHUNKS + 1];
+  int64_t nbytes;
+  int first, count;
+
+  sparams.compressor = BLOSC_LZ4;
+  sparams.nthreads = (uint8_t)nthreads;
+  if (delta) {
+    sparams.filters[0] = BLOSC_DELTA;
+    sparams.filters[1] = BLOSC_SHUFFLE;
+  }
+  if (path != NULL) {
+    schunk = blosc2_new_schunk_file(&sparams, path);
+  }
+  else {
+    schunk = blosc2_new_schunk(&sparams);
+  }
+  if (delta) {
+    blosc2_set_delta_ref(schunk, sizeof(int32_t), CHUNKITEMS * sizeof(int32_t),
+                         src);
+  }
+  /* The blocksize of the tiny chunks does not stick for the next ones */
+  mu_assert("ERROR: chunks are not compressed well",
+            fill_schunk(schunk, offsets));
+
+  /* All the chunks */
+  nbytes = offsets[NCHUNKS] * sizeof(int32_t);
+  mu_assert("ERROR: wrong decompressed size",
+            blosc2_decompress_chunks(schunk, 0, NCHUNKS, dest,
+                                     NITEMS * sizeof(int32_t)) == nbytes);
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(dest, src, (size_t)nbytes) == 0);
+
+  /* Some ranges */
+  for (first = 0; first < NCHUNKS; first += 97) {
+    count = (first * 7) % (NCHUNKS - first) + 1;
+    nbytes = (offsets[first + count] - offsets[first]) * sizeof(int32_t);
+    memset(dest, 0, NITEMS * sizeof(int32_t));
+    mu_assert("ERROR: wrong decompressed size of range",
+              blosc2_decompress_chunks(schunk, first, count, dest, nbytes) ==
+              nbytes);
+    mu_assert("ERROR: decompressed range differs",
+              memcmp(dest, src + offsets[first], (size_t)nbytes) == 0);
+  }
+
+  /* Errors */
+  mu_assert("ERROR: empty range is not empty",
+            blosc2_decompress_chunks(schunk, NCHUNKS, 0, dest, 0) == 0);
+  mu_assert("ERROR: range out of bounds not detected",
+            blosc2_decompress_chunks(schunk, NCHUNKS - 1, 2, dest,
+                                     NITEMS * sizeof(int32_t)) < 0);
+  mu_assert("ERROR: small buffer not detected",
+            blosc2_decompress_chunks(schunk, 0, NCHUNKS, dest,
+                                     offsets[NCHUNKS] * sizeof(int32_t) - 1) < 0);
+
+  blosc2_destroy_schunk(schunk);
+  if (path != NULL) {
+    remove(path);
+  }
+  return 0;
+}
+
+static char *test_serial() {
+  return run_chunks(0, 1, NULL);
+}
+
+static char *test_threads() {
+  return run_chunks(0, 4, NULL);
+}
+
+static char *test_delta_threads() {
+  return run_chunks(1, 4, NULL);
+}
+
+static char *test_file() {
+  return run_chunks(1, 2, "test_decompress_chunks.b2frame");
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_serial);
+  mu_run_test(test_threads);
+  mu_run_test(test_delta_threads);
+  mu_run_test(test_file);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int result;
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  blosc_test_fill_sequence(src, NITEMS);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_destroy();
+
+  return result;
+}
@@ -0,0 +1,287 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for streaming decompression.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <stdio.h>
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define NITEMS (500 * 1000 + 3)
+#define CHUNKITEMS (64 * 1000)
+#define MAXPACKED (NITEMS * sizeof(int32_t) * 2)
+
+/* Global vars */
+int32_t *src, *dest;
+uint8_t* input;
+
+/* An input in memory that is read in pieces of random sizes */
+typedef struct {
+  uint8_t* data;
+  int64_t nbytes;
+  int64_t pos;
+  int maxpiece;
+} memory_input;
+
+/* The output of a streaming decompression */
+typedef struct {
+  uint8_t* data;
+  int64_t nbytes;
+  int64_t maxbytes;
+  int32_t maxblock;
+} memory_output;
+
+
+static int64_t read_memory(void* buf, int64_t nbytes, void* user_data) {
+  memory_input* in = (memory_input*)user_data;
+  int64_t n = rand() % in->maxpiece + 1;
+
+  if (n > nbytes) {
+    n = nbytes;
+  }
+  if (n > in->nbytes - in->pos) {
+    n = in->nbytes - in->pos;
+  }
+  memcpy(buf, in->data + in->pos, (size_t)n);
+  in->pos += n;
+  return n;
+}
+
+static int write_memory(const void* data, int32_t nbytes, void* user_data) {
+  memory_output* out = (memory_output*)user_data;
+
+  if (out->nbytes + nbytes > out->maxbytes) {
+    return -3;
+  }
+  memcpy(out->data + out->nbytes, data, (size_t)nbytes);
+  out->nbytes += nbytes;
+  if (nbytes > out->maxblock) {
+    out->maxblock = nbytes;
+  }
+  return 0;
+}
+
+static int write_file(const void* chunk, int32_t cbytes, void* user_data) {
+  return (fwrite(chunk, 1, (size_t)cbytes, (FILE*)user_data) ==
+          (size_t)cbytes) ? 0 : -1;
+}
+
+/* Compress `src` in chunks (with `nthreads`) one after the other in
+   `input`.  Returns the size of the input. */
+static int64_t compress_chunks(int clevel, int nthreads) {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+  int64_t nbytes = 0;
+  int32_t i, n;
+
+  cparams.typesize = sizeof(int32_t);
+  cparams.clevel = (uint8_t)clevel;
+  cparams.nthreads = (uint8_t)nthreads;
+  cparams.blocksize = 8 * 1024;
+  cctx = blosc2_create_cctx(&cparams);
+  for (i = 0; i < NITEMS; i += CHUNKITEMS) {
+    n = (NITEMS - i < CHUNKITEMS) ? NITEMS - i : CHUNKITEMS;
+    nbytes += blosc2_compress_ctx(cctx, n * sizeof(int32_t), src + i,
+                                  input + nbytes,
+                                  n * sizeof(int32_t) + BLOSC_MAX_OVERHEAD);
+  }
+  blosc2_free_ctx(cctx);
+  return nbytes;
+}
+
+static char *run_stream(int clevel, int nthreads, int maxpiece) {
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context* dctx = blosc2_create_dctx(&dparams);
+  memory_input in = {input, 0, 0, maxpiece};
+  memory_output out = {(uint8_t*)dest, 0, NITEMS * sizeof(int32_t), 0};
+  int64_t nbytes;
+
+  in.nbytes = compress_chunks(clevel, nthreads);
+  memset(dest, 0, NITEMS * sizeof(int32_t));
+  nbytes = blosc2_decompress_stream(dctx, read_memory, &in, write_memory, &out);
+  mu_assert("ERROR: stream decompression failed",
+            nbytes == NITEMS * sizeof(int32_t));
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(src, dest, NITEMS * sizeof(int32_t)) == 0);
+  mu_assert("ERROR: output is not incremental", out.maxblock <= 8 * 1024);
+
+  /* An input ending in the middle of a chunk is an error */
+  in.nbytes -= 10;
+  in.pos = 0;
+  out.nbytes = 0;
+  mu_assert("ERROR: truncated input not detected",
+            blosc2_decompress_stream(dctx, read_memory, &in, write_memory,
+                                     &out) < 0);
+  blosc2_free_ctx(dctx);
+  return 0;
+}
+
+static char *test_serial_chunks() {
+  return run_stream(5, 1, 1000);
+}
+
+static char *test_threaded_chunks() {
+  /* Blocks may be out of order in the chunks */
+  return run_stream(5, 4, 5000);
+}
+
+static char *test_memcpyed() {
+  return run_stream(0, 1, 3000);
+}
+
+static char *test_fd() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx, *dctx;
+  blosc2_cstream* stream;
+  memory_output out = {(uint8_t*)dest, 0, NITEMS * sizeof(int32_t), 0};
+  FILE* f = tmpfile();
+  int fd;
+
+  mu_assert("ERROR: cannot create a temporary file", f != NULL);
+  cparams.typesize = sizeof(int32_t);
+  cctx = blosc2_create_cctx(&cparams);
+  stream = blosc2_create_cstream(cctx, 100 * 1000, write_file, f);
+  blosc2_cstream_write(stream, src, NITEMS * sizeof(int32_t));
+  blosc2_cstream_end(stream);
+  blosc2_free_ctx(cctx);
+  fflush(f);
+  rewind(f);
+
+  fd = fileno(f);
+  dctx = blosc2_create_dctx(&dparams);
+  memset(dest, 0, NITEMS * sizeof(int32_t));
+  mu_assert("ERROR: stream decompression failed",
+            blosc2_decompress_stream(dctx, blosc2_dstream_read_fd, &fd,
+                                     write_memory, &out) ==
+            NITEMS * sizeof(int32_t));
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(src, dest, NITEMS * sizeof(int32_t)) == 0);
+  blosc2_free_ctx(dctx);
+  fclose(f);
+  return 0;
+}
+
+static char *test_output_error() {
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context* dctx = blosc2_create_dctx(&dparams);
+  memory_input in = {input, 0, 0, 100000};
+  memory_output out = {(uint8_t*)dest, 0, 100000, 0};
+
+  in.nbytes = compress_chunks(5, 1);
+  mu_assert("ERROR: output error not passed along",
+            blosc2_decompress_stream(dctx, read_memory, &in, write_memory,
+                                     &out) == -3);
+  blosc2_free_ctx(dctx);
+  return 0;
+}
+
+static char *run_packed(int delta) {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  blosc_context* dctx;
+  memory_input in = {NULL, 0, 0, 4000};
+  memory_output out = {(uint8_t*)dest, 0, NITEMS * sizeof(int32_t), 0};
+  uint8_t* expected = malloc(NITEMS * sizeof(int32_t));
+  void* packed;
+  void* chunk;
+  int32_t i, n, nchunk = 0, nbytes;
+  int64_t pos = 0;
+
+  sparams.compressor = BLOSC_BLOSCLZ;
+  if (delta) {
+    sparams.filters[0] = BLOSC_DELTA;
+    sparams.filters[1] = BLOSC_SHUFFLE;
+  }
+  schunk = blosc2_new_schunk(&sparams);
+  if (delta) {
+    blosc2_set_delta_ref(schunk, sizeof(int32_t), CHUNKITEMS * sizeof(int32_t),
+                         src);
+  }
+  packed = blosc2_pack_schunk(schunk);
+  blosc2_destroy_schunk(schunk);
+  for (i = 0; i < NITEMS; i += CHUNKITEMS) {
+    n = (NITEMS - i < CHUNKITEMS) ? NITEMS - i : CHUNKITEMS;
+    packed = blosc2_packed_append_buffer(packed, sizeof(int32_t),
+                                         n * sizeof(int32_t), src + i);
+    /* What the regular API gives for the chunk */
+    nbytes = blosc2_packed_decompress_chunk(packed, nchunk++, &chunk);
+    mu_assert("ERROR: packed chunk decompression failed", nbytes > 0);
+    memcpy(expected + pos, chunk, (size_t)nbytes);
+    pos += nbytes;
+    free(chunk);
+  }
+
+  in.data = packed;
+  in.nbytes = *(int64_t*)((uint8_t*)packed + 32);
+  dctx = blosc2_create_dctx(&dparams);
+  memset(dest, 0, NITEMS * sizeof(int32_t));
+  mu_assert("ERROR: packed stream decompression failed",
+            blosc2_decompress_packed_stream(dctx, read_memory, &in,
+                                            write_memory, &out) == pos);
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(expected, dest, (size_t)pos) == 0);
+  if (!delta) {
+    mu_assert("ERROR: decompressed data differs from source",
+              memcmp(src, dest, NITEMS * sizeof(int32_t)) == 0);
+  }
+
+  blosc2_free_ctx(dctx);
+  free(packed);
+  free(expected);
+  return 0;
+}
+
+static char *test_packed() {
+  return run_packed(0);
+}
+
+static char *test_packed_delta() {
+  return run_packed(1);
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_serial_chunks);
+  mu_run_test(test_threaded_chunks);
+  mu_run_test(test_memcpyed);
+  mu_run_test(test_fd);
+  mu_run_test(test_output_error);
+  mu_run_test(test_packed);
+  mu_run_test(test_packed_delta);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int result;
+
+  blosc_init();
+  srand(1);
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  input = blosc_test_malloc(BUFFER_ALIGN_SIZE, MAXPACKED);
+  blosc_test_fill_sequence(src, NITEMS);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(input);
+  blosc_destroy();
+
+  return result;
+}
@@ -0,0 +1,198 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for buffers with extended (64-bit) headers.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+#include "../blosc/blosc-private.h"
+
+int tests_run = 0;
+
+/* Global vars */
+void *src, *dest, *dest2;
+size_t size = 1000 * 1000;                 /* must be divisible by 4 */
+
+
+/* Compress with an extended header and decompress in different ways */
+static char *run_roundtrip(int nthreads, int clevel) {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx, *dctx;
+  size_t nbytes_, cbytes_, blocksize_;
+  int64_t cbytes, nbytes;
+  int32_t items[10];
+  int i;
+
+  cparams.typesize = 4;
+  cparams.clevel = (uint8_t)clevel;
+  cparams.nthreads = (uint8_t)nthreads;
+  dparams.nthreads = (uint8_t)nthreads;
+  cctx = blosc2_create_cctx(&cparams);
+  dctx = blosc2_create_dctx(&dparams);
+
+  cbytes = blosc2_compress_ctx64(cctx, size, src, dest,
+                                 size + BLOSC_EXTENDED_MAX_OVERHEAD);
+  mu_assert("ERROR: cbytes is not correct",
+            cbytes > 0 && cbytes <= (int64_t)size + BLOSC_EXTENDED_MAX_OVERHEAD);
+  mu_assert("ERROR: the header is not extended",
+            ((uint8_t*)dest)[0] == BLOSC_VERSION_FORMAT_64);
+  blosc_cbuffer_sizes(dest, &nbytes_, &cbytes_, &blocksize_);
+  mu_assert("ERROR: nbytes in header is not correct", nbytes_ == size);
+  mu_assert("ERROR: cbytes in header is not correct", cbytes_ == (size_t)cbytes);
+
+  memset(dest2, 0, size);
+  nbytes = blosc2_decompress_ctx64(dctx, dest, dest2, size);
+  mu_assert("ERROR: nbytes incorrect", nbytes == (int64_t)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest2, size) == 0);
+
+  /* The regular functions can cope with extended headers too */
+  memset(dest2, 0, size);
+  nbytes = blosc2_decompress_ctx(dctx, dest, dest2, size);
+  mu_assert("ERROR: nbytes incorrect", nbytes == (int64_t)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest2, size) == 0);
+  nbytes = blosc_decompress(dest, dest2, size);
+  mu_assert("ERROR: nbytes incorrect", nbytes == (int64_t)size);
+
+  /* Get some items across blocks */
+  nbytes = blosc_getitem(dest, (int)(size / 4 - 5000), 10, items);
+  mu_assert("ERROR: getitem nbytes incorrect", nbytes == 40);
+  for (i = 0; i < 10; i++) {
+    mu_assert("ERROR: getitem is not correct",
+              items[i] == ((int32_t*)src)[size / 4 - 5000 + i]);
+  }
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+
+  return 0;
+}
+
+static char *test_serial() {
+  return run_roundtrip(1, 5);
+}
+
+static char *test_threads() {
+  return run_roundtrip(4, 5);
+}
+
+static char *test_memcpyed() {
+  return run_roundtrip(1, 0);
+}
+
+static char *test_memcpyed_threads() {
+  return run_roundtrip(4, 0);
+}
+
+/* Check that the regular API refuses large buffers */
+static char *test_limits() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc_context* cctx;
+
+  cctx = blosc2_create_cctx(&cparams);
+  mu_assert("ERROR: large buffers should be refused",
+            blosc2_compress_ctx(cctx, (size_t)BLOSC_MAX_BUFFERSIZE + 1,
+                                src, dest, size) < 0);
+  blosc2_free_ctx(cctx);
+
+  return 0;
+}
+
+/* Check that the items past INT_MAX of a large buffer can be fetched */
+static char *test_getitem64() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx, *dctx;
+  int64_t nbig = (int64_t)INT_MAX + 1024 * 1024;
+  int64_t start = (int64_t)INT_MAX + 1000;
+  size_t cdestsize = 64 * 1024 * 1024;
+  uint8_t *big, *cdest, items[16];
+  int i;
+
+  if (sizeof(size_t) < 8) {
+    return 0;
+  }
+  /* The zeroed pages are not touched by the compressor */
+  big = calloc((size_t)nbig, 1);
+  cdest = malloc(cdestsize);
+  if (big == NULL || cdest == NULL) {
+    free(big);
+    free(cdest);
+    return 0;
+  }
+  for (i = 0; i < 16; i++) {
+    big[start + i] = (uint8_t)(i + 1);
+  }
+  cparams.typesize = 1;
+  cparams.nthreads = 4;
+  dparams.nthreads = 4;
+  cctx = blosc2_create_cctx(&cparams);
+  dctx = blosc2_create_dctx(&dparams);
+  mu_assert("ERROR: large buffer compression failed",
+            blosc2_compress_ctx64(cctx, (size_t)nbig, big, cdest,
+                                  cdestsize) > 0);
+  free(big);
+
+  mu_assert("ERROR: getitem nbytes incorrect",
+            blosc2_getitem_ctx64(dctx, cdest, start - 8, 16, items) == 16);
+  for (i = 0; i < 16; i++) {
+    mu_assert("ERROR: getitem is not correct",
+              items[i] == ((i < 8) ? 0 : i - 7));
+  }
+  mu_assert("ERROR: getitem out of bounds not detected",
+            blosc2_getitem_ctx64(dctx, cdest, nbig - 8, 16, items) < 0);
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  free(cdest);
+
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_serial);
+  mu_run_test(test_threads);
+  mu_run_test(test_memcpyed);
+  mu_run_test(test_memcpyed_threads);
+  mu_run_test(test_limits);
+  mu_run_test(test_getitem64);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  int result;
+  size_t i;
+
+  blosc_init();
+  blosc_set_force_extended(1);
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + BLOSC_EXTENDED_MAX_OVERHEAD);
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  _src = (int32_t *)src;
+  for (i=0; i < (size/4); i++) {
+    _src[i] = (int32_t)i;
+  }
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_set_force_extended(0);
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+  blosc_destroy();
+
+  return result;
+}
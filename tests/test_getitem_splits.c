@@ -0,0 +1,126 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for getitem on unshuffled buffers with split blocks.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define NBYTES (1000 * 1000 + 48)   /* the last block is a leftover */
+#define BLOCKSIZE (64 * 1024)
+
+/* Global vars */
+uint8_t *src, *items;
+void *dest;
+
+
+/* Compress `src` with `typesize` and fetch many ranges of items */
+static char *run_getitem(int typesize, int filtercode, int nthreads) {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx, *dctx;
+  int nitems = NBYTES / typesize;
+  int i, start, n, nbytes, csize;
+
+  cparams.compcode = BLOSC_BLOSCLZ;
+  cparams.typesize = (int32_t)typesize;
+  cparams.filtercode = (uint8_t)filtercode;
+  cparams.blocksize = BLOCKSIZE;
+  cctx = blosc2_create_cctx(&cparams);
+  csize = blosc2_compress_ctx(cctx, (size_t)nitems * typesize, src, dest,
+                              NBYTES + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: compression failed", csize > 0);
+  blosc2_free_ctx(cctx);
+
+  dparams.nthreads = (uint8_t)nthreads;
+  dctx = blosc2_create_dctx(&dparams);
+  for (i = 0; i < 500; i++) {
+    /* Single items, ranges inside a split and ranges crossing splits */
+    n = (i % 3 == 0) ? 1 : rand() % (2 * BLOCKSIZE / typesize);
+    start = rand() % (nitems - n + 1);
+    memset(items, 0, (size_t)n * typesize);
+    nbytes = blosc2_getitem_ctx(dctx, dest, start, n, items);
+    mu_assert("ERROR: getitem nbytes incorrect", nbytes == n * typesize);
+    mu_assert("ERROR: getitem items are not correct",
+              memcmp(items, src + (size_t)start * typesize, (size_t)nbytes) == 0);
+  }
+
+  /* The last item of the last split of a block and the leftover block */
+  start = BLOCKSIZE / typesize - 1;
+  nbytes = blosc2_getitem_ctx(dctx, dest, start, 1, items);
+  mu_assert("ERROR: last item of a block is not correct",
+            memcmp(items, src + (size_t)start * typesize, (size_t)nbytes) == 0);
+  start = nitems - 3;
+  nbytes = blosc2_getitem_ctx(dctx, dest, start, 3, items);
+  mu_assert("ERROR: leftover items are not correct",
+            memcmp(items, src + (size_t)start * typesize, (size_t)nbytes) == 0);
+  blosc2_free_ctx(dctx);
+
+  return 0;
+}
+
+static char *test_noshuffle() {
+  char* result;
+  int typesizes[] = {2, 4, 8, 16};
+  int i;
+
+  for (i = 0; i < (int)(sizeof(typesizes) / sizeof(int)); i++) {
+    result = run_getitem(typesizes[i], BLOSC_NOSHUFFLE, 1);
+    if (result != 0) {
+      return result;
+    }
+  }
+  return 0;
+}
+
+static char *test_noshuffle_threads() {
+  return run_getitem(8, BLOSC_NOSHUFFLE, 4);
+}
+
+static char *test_shuffle() {
+  return run_getitem(8, BLOSC_SHUFFLE, 1);
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_noshuffle);
+  mu_run_test(test_noshuffle_threads);
+  mu_run_test(test_shuffle);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int result;
+  int32_t i;
+
+  blosc_init();
+  srand(1);
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NBYTES);
+  items = blosc_test_malloc(BUFFER_ALIGN_SIZE, NBYTES);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, NBYTES + BLOSC_MAX_OVERHEAD);
+  for (i = 0; i < NBYTES; i++) {
+    src[i] = (uint8_t)((i / 64) * 3 + (i % 7));
+  }
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(items);
+  blosc_test_free(dest);
+  blosc_destroy();
+
+  return result;
+}
@@ -0,0 +1,136 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for getitem in contexts with several threads.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define NITEMS (100 * 1000 + 17)   /* the last block is a leftover */
+#define BLOCKSIZE (16 * 1024)
+
+/* Global vars */
+int32_t *src, *items;
+void *dest;
+
+
+/* Compress `src` and fetch a few ranges of items with getitem */
+static char *run_getitem(int nthreads, blosc2_threadpool* pool,
+                         int filtercode, int clevel) {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx, *dctx;
+  int starts[] = {0, 5, 4096, 4000, 12345, 0, NITEMS - 10, 50000};
+  int nitems[] = {NITEMS, 10, 4096, 8192, 60000, 0, 10, 1};
+  int i, nbytes, csize;
+
+  cparams.typesize = sizeof(int32_t);
+  cparams.filtercode = (uint8_t)filtercode;
+  cparams.clevel = (int8_t)clevel;
+  cparams.blocksize = BLOCKSIZE;
+  cctx = blosc2_create_cctx(&cparams);
+  csize = blosc2_compress_ctx(cctx, NITEMS * sizeof(int32_t), src, dest,
+                              NITEMS * sizeof(int32_t) + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: compression failed", csize > 0);
+  blosc2_free_ctx(cctx);
+
+  dparams.nthreads = (uint8_t)nthreads;
+  dparams.threadpool = pool;
+  dctx = blosc2_create_dctx(&dparams);
+  for (i = 0; i < (int)(sizeof(starts) / sizeof(int)); i++) {
+    memset(items, 0, NITEMS * sizeof(int32_t));
+    nbytes = blosc2_getitem_ctx(dctx, dest, starts[i], nitems[i], items);
+    mu_assert("ERROR: getitem nbytes incorrect",
+              nbytes == nitems[i] * (int)sizeof(int32_t));
+    mu_assert("ERROR: getitem items are not correct",
+              memcmp(items, src + starts[i], (size_t)nbytes) == 0);
+  }
+
+  /* Out of bounds */
+  mu_assert("ERROR: out of bounds not detected",
+            blosc2_getitem_ctx(dctx, dest, NITEMS - 5, 10, items) < 0);
+
+  /* The context can be used for regular decompression afterwards */
+  memset(items, 0, NITEMS * sizeof(int32_t));
+  nbytes = blosc2_decompress_ctx(dctx, dest, items, NITEMS * sizeof(int32_t));
+  mu_assert("ERROR: decompression failed",
+            nbytes == NITEMS * (int)sizeof(int32_t));
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(items, src, (size_t)nbytes) == 0);
+  blosc2_free_ctx(dctx);
+
+  return 0;
+}
+
+static char *test_serial() {
+  return run_getitem(1, NULL, BLOSC_SHUFFLE, 5);
+}
+
+static char *test_private_threads() {
+  char* result;
+
+  result = run_getitem(4, NULL, BLOSC_SHUFFLE, 5);
+  if (result != 0) {
+    return result;
+  }
+  result = run_getitem(4, NULL, BLOSC_BITSHUFFLE, 9);
+  if (result != 0) {
+    return result;
+  }
+  return run_getitem(4, NULL, BLOSC_NOSHUFFLE, 1);
+}
+
+static char *test_shared_pool() {
+  blosc2_threadpool* pool = blosc2_create_threadpool(3);
+  char* result;
+
+  result = run_getitem(4, pool, BLOSC_SHUFFLE, 5);
+  blosc2_free_threadpool(pool);
+  return result;
+}
+
+static char *test_memcpyed() {
+  return run_getitem(4, NULL, BLOSC_SHUFFLE, 0);
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_serial);
+  mu_run_test(test_private_threads);
+  mu_run_test(test_shared_pool);
+  mu_run_test(test_memcpyed);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int result;
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  items = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE,
+                           NITEMS * sizeof(int32_t) + BLOSC_MAX_OVERHEAD);
+  blosc_test_fill_sequence(src, NITEMS);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(items);
+  blosc_test_free(dest);
+  blosc_destroy();
+
+  return result;
+}
@@ -0,0 +1,153 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for gathering many ranges of items with blosc2_getitems_ctx().
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define NITEMS (200 * 1000 + 3)   /* the last block is a leftover */
+#define BLOCKSIZE (16 * 1024)
+#define NRANGES 1000
+
+/* Global vars */
+int32_t *src, *items, *expected;
+void *dest;
+int starts[NRANGES], nitems[NRANGES];
+
+
+/* Set random ranges (in random order, some overlapping or empty) */
+static int set_ranges(void) {
+  int i, total = 0;
+
+  for (i = 0; i < NRANGES; i++) {
+    nitems[i] = (i % 50 == 0) ? rand() % 20000 : rand() % 4;
+    starts[i] = rand() % (NITEMS - nitems[i] + 1);
+    total += nitems[i];
+  }
+  return total;
+}
+
+/* Compress `src` and gather the ranges */
+static char *run_getitems(int nthreads, blosc2_threadpool* pool, int clevel) {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx, *dctx;
+  int i, nbytes, csize, total, pos;
+
+  cparams.typesize = sizeof(int32_t);
+  cparams.clevel = (int8_t)clevel;
+  cparams.blocksize = BLOCKSIZE;
+  cctx = blosc2_create_cctx(&cparams);
+  csize = blosc2_compress_ctx(cctx, NITEMS * sizeof(int32_t), src, dest,
+                              NITEMS * sizeof(int32_t) + BLOSC_MAX_OVERHEAD);
+  mu_assert("ERROR: compression failed", csize > 0);
+  blosc2_free_ctx(cctx);
+
+  dparams.nthreads = (uint8_t)nthreads;
+  dparams.threadpool = pool;
+  dctx = blosc2_create_dctx(&dparams);
+
+  total = set_ranges();
+  for (i = 0, pos = 0; i < NRANGES; i++) {
+    memcpy(expected + pos, src + starts[i], nitems[i] * sizeof(int32_t));
+    pos += nitems[i];
+  }
+  memset(items, 0, total * sizeof(int32_t));
+  nbytes = blosc2_getitems_ctx(dctx, dest, starts, nitems, NRANGES, items);
+  mu_assert("ERROR: getitems nbytes incorrect",
+            nbytes == total * (int)sizeof(int32_t));
+  mu_assert("ERROR: getitems items are not correct",
+            memcmp(items, expected, (size_t)nbytes) == 0);
+
+  /* A single range is the same than getitem */
+  starts[0] = 1000;
+  nitems[0] = NITEMS - 1000;
+  nbytes = blosc2_getitems_ctx(dctx, dest, starts, nitems, 1, items);
+  mu_assert("ERROR: single range nbytes incorrect",
+            nbytes == (NITEMS - 1000) * (int)sizeof(int32_t));
+  mu_assert("ERROR: single range items are not correct",
+            memcmp(items, src + 1000, (size_t)nbytes) == 0);
+
+  /* Out of bounds */
+  starts[1] = NITEMS - 5;
+  nitems[1] = 10;
+  mu_assert("ERROR: out of bounds not detected",
+            blosc2_getitems_ctx(dctx, dest, starts, nitems, 2, items) < 0);
+
+  /* The context can be used for regular decompression afterwards */
+  nbytes = blosc2_decompress_ctx(dctx, dest, items, NITEMS * sizeof(int32_t));
+  mu_assert("ERROR: decompression failed",
+            nbytes == NITEMS * (int)sizeof(int32_t));
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(items, src, (size_t)nbytes) == 0);
+  blosc2_free_ctx(dctx);
+
+  return 0;
+}
+
+static char *test_serial() {
+  return run_getitems(1, NULL, 5);
+}
+
+static char *test_private_threads() {
+  return run_getitems(4, NULL, 5);
+}
+
+static char *test_shared_pool() {
+  blosc2_threadpool* pool = blosc2_create_threadpool(3);
+  char* result;
+
+  result = run_getitems(4, pool, 9);
+  blosc2_free_threadpool(pool);
+  return result;
+}
+
+static char *test_memcpyed() {
+  return run_getitems(2, NULL, 0);
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_serial);
+  mu_run_test(test_private_threads);
+  mu_run_test(test_shared_pool);
+  mu_run_test(test_memcpyed);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int result;
+
+  blosc_init();
+  srand(1);
+
+  /* Initialize buffers (the ranges may add up to more than NITEMS) */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  items = blosc_test_malloc(BUFFER_ALIGN_SIZE, 4 * NITEMS * sizeof(int32_t));
+  expected = blosc_test_malloc(BUFFER_ALIGN_SIZE, 4 * NITEMS * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE,
+                           NITEMS * sizeof(int32_t) + BLOSC_MAX_OVERHEAD);
+  blosc_test_fill_sequence(src, NITEMS);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(items);
+  blosc_test_free(expected);
+  blosc_test_free(dest);
+  blosc_destroy();
+
+  return result;
+}
@@ -0,0 +1,147 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for checking that steady-state compression and
+  decompression do not allocate memory.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+#include "../blosc/blosc-private.h"
+
+int tests_run = 0;
+
+#define NCALLS 10
+
+/* Global vars */
+void *src, *dest, *dest2;
+size_t size = 1000 * 1000;                 /* must be divisible by 4 */
+
+
+/* Do NCALLS roundtrips with the contexts and check that only the first
+   one allocates */
+static char *check_roundtrips(blosc_context* cctx, blosc_context* dctx) {
+  int32_t nallocs = 0;
+  int i, cbytes, nbytes;
+
+  for (i = 0; i < NCALLS; i++) {
+    if (i == 1) {
+      nallocs = blosc_get_nallocs();
+    }
+    cbytes = blosc2_compress_ctx(cctx, size, src, dest, size + 16);
+    mu_assert("ERROR: cbytes is not correct", cbytes > 0 && cbytes < (int)size);
+    nbytes = blosc2_decompress_ctx(dctx, dest, dest2, size);
+    mu_assert("ERROR: nbytes incorrect", nbytes == (int)size);
+  }
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest2, size) == 0);
+  mu_assert("ERROR: steady state is allocating memory",
+            blosc_get_nallocs() == nallocs);
+
+  return 0;
+}
+
+
+static char *test_codecs() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx, *dctx;
+  const char* compnames[] = {"blosclz", "lz4", "zstd"};
+  int filtercodes[] = {BLOSC_SHUFFLE, BLOSC_BITSHUFFLE, BLOSC_NOFILTER};
+  char* result;
+  int i, j, compcode;
+
+  for (i = 0; i < 3; i++) {
+    compcode = blosc_compname_to_compcode(compnames[i]);
+    if (compcode < 0) {
+      continue;   /* codec not available */
+    }
+    for (j = 0; j < 3; j++) {
+      cparams.typesize = 4;
+      cparams.compcode = (uint8_t)compcode;
+      cparams.filtercode = (uint8_t)filtercodes[j];
+      cctx = blosc2_create_cctx(&cparams);
+      dctx = blosc2_create_dctx(&dparams);
+      result = check_roundtrips(cctx, dctx);
+      blosc2_free_ctx(cctx);
+      blosc2_free_ctx(dctx);
+      if (result != 0) {
+        return result;
+      }
+    }
+  }
+
+  return 0;
+}
+
+
+/* The delta filter fetches the reference for every block */
+static char *test_delta() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc2_sparams sparams;
+  blosc2_sheader* schunk;
+  blosc_context *cctx, *dctx;
+  char* result;
+
+  memset(&sparams, 0, sizeof(sparams));
+  sparams.filters[0] = BLOSC_DELTA;
+  sparams.filters[1] = BLOSC_SHUFFLE;
+  sparams.compressor = BLOSC_BLOSCLZ;
+  sparams.clevel = 5;
+  schunk = blosc2_new_schunk(&sparams);
+  mu_assert("ERROR: cannot set the delta reference",
+            blosc2_set_delta_ref(schunk, 4, size, src) > 0);
+
+  cparams.typesize = 4;
+  cparams.schunk = schunk;
+  dparams.schunk = schunk;
+  cctx = blosc2_create_cctx(&cparams);
+  dctx = blosc2_create_dctx(&dparams);
+  result = check_roundtrips(cctx, dctx);
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  blosc2_destroy_schunk(schunk);
+
+  return result;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_codecs);
+  mu_run_test(test_delta);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  int result;
+  size_t i;
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + 16);
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  _src = (int32_t *)src;
+  for (i=0; i < (size/4); i++) {
+    _src[i] = (int32_t)i;
+  }
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+  blosc_destroy();
+
+  return result;
+}
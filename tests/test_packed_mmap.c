@@ -0,0 +1,148 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for packed super-chunks mapped in memory.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <stdio.h>
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define CHUNKITEMS (100 * 1000)
+#define NCHUNKS 20
+#define NITEMS (CHUNKITEMS * NCHUNKS)
+#define FILENAME "test_packed_mmap.b2frame"
+
+/* Global vars */
+int32_t *src, *dest;
+
+
+/* Write a packed super-chunk with the chunks of `src` */
+static void write_packed(void) {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunk = blosc2_new_schunk_file(&sparams, FILENAME);
+  int i;
+
+  for (i = 0; i < NCHUNKS; i++) {
+    blosc2_append_buffer(schunk, sizeof(int32_t), CHUNKITEMS * sizeof(int32_t),
+                         src + i * CHUNKITEMS);
+  }
+  blosc2_destroy_schunk(schunk);
+}
+
+static char *run_mapped(int sequential) {
+  void* packed;
+  int64_t length;
+  int i;
+
+  packed = blosc2_map_packed_schunk(FILENAME, sequential, &length);
+  mu_assert("ERROR: packed super-chunk not mapped", packed != NULL);
+  mu_assert("ERROR: wrong length", *(int64_t*)((uint8_t*)packed + 32) == length);
+  mu_assert("ERROR: wrong nchunks", *(int64_t*)((uint8_t*)packed + 16) == NCHUNKS);
+
+  /* Chunks go straight to the caller buffer, in any order */
+  for (i = 0; i < NCHUNKS; i++) {
+    int nchunk = sequential ? i : (i * 7) % NCHUNKS;
+    memset(dest, 0, CHUNKITEMS * sizeof(int32_t));
+    mu_assert("ERROR: chunk decompression failed",
+              blosc2_packed_decompress_chunk_into(packed, nchunk, dest,
+                                                  CHUNKITEMS * sizeof(int32_t)) ==
+              CHUNKITEMS * sizeof(int32_t));
+    mu_assert("ERROR: decompressed data differs",
+              memcmp(dest, src + nchunk * CHUNKITEMS,
+                     CHUNKITEMS * sizeof(int32_t)) == 0);
+  }
+
+  mu_assert("ERROR: small buffer not detected",
+            blosc2_packed_decompress_chunk_into(packed, 0, dest, 1000) == -11);
+  mu_assert("ERROR: wrong nchunk not detected",
+            blosc2_packed_decompress_chunk_into(packed, NCHUNKS, dest,
+                                                CHUNKITEMS * sizeof(int32_t)) == -10);
+  mu_assert("ERROR: unmap failed", blosc2_unmap_packed_schunk(packed, length) == 0);
+  return 0;
+}
+
+static char *test_random() {
+  return run_mapped(0);
+}
+
+static char *test_sequential() {
+  return run_mapped(1);
+}
+
+static char *test_invalid() {
+  void *packed, *data;
+  int64_t length;
+  FILE* f;
+
+  mu_assert("ERROR: missing file not detected",
+            blosc2_map_packed_schunk("missing/" FILENAME, 0, NULL) == NULL);
+
+  /* A file shorter than the packed super-chunk in it */
+  packed = blosc2_map_packed_schunk(FILENAME, 0, &length);
+  data = malloc((size_t)length);
+  memcpy(data, packed, (size_t)length);
+  blosc2_unmap_packed_schunk(packed, length);
+  f = fopen(FILENAME, "wb");
+  fwrite(data, 1, (size_t)length - 100, f);
+  fclose(f);
+  mu_assert("ERROR: truncated file not detected",
+            blosc2_map_packed_schunk(FILENAME, 0, NULL) == NULL);
+
+  /* A packed super-chunk with room reserved, whose index of chunk offsets
+     lies past its cbytes */
+  data = blosc2_packed_reserve(data, 4, 1000);
+  f = fopen(FILENAME, "wb");
+  fwrite(data, 1, (size_t)*(int64_t*)((uint8_t*)data + 32), f);
+  fclose(f);
+  mu_assert("ERROR: missing index not detected",
+            blosc2_map_packed_schunk(FILENAME, 0, NULL) == NULL);
+
+  /* A file shorter than its header */
+  f = fopen(FILENAME, "wb");
+  fwrite(data, 1, 50, f);
+  fclose(f);
+  mu_assert("ERROR: short file not detected",
+            blosc2_map_packed_schunk(FILENAME, 0, NULL) == NULL);
+  free(data);
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_random);
+  mu_run_test(test_sequential);
+  mu_run_test(test_invalid);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int result;
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, CHUNKITEMS * sizeof(int32_t));
+  blosc_test_fill_sequence(src, NITEMS);
+  write_packed();
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  remove(FILENAME);
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_destroy();
+
+  return result;
+}
@@ -0,0 +1,231 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for packed super-chunks with room reserved for appends.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define CHUNKITEMS (2 * 1000)
+#define NCHUNKS 300
+#define NITEMS (CHUNKITEMS * NCHUNKS)
+
+/* Global vars */
+int32_t *src, *dest;
+
+/* A packed super-chunk in memory that is read by a stream */
+typedef struct {
+  uint8_t* data;
+  int64_t nbytes;
+  int64_t pos;
+} memory_input;
+
+
+static int64_t read_memory(void* buf, int64_t nbytes, void* user_data) {
+  memory_input* in = (memory_input*)user_data;
+
+  if (nbytes > in->nbytes - in->pos) {
+    nbytes = in->nbytes - in->pos;
+  }
+  memcpy(buf, in->data + in->pos, (size_t)nbytes);
+  in->pos += nbytes;
+  return nbytes;
+}
+
+static int discard_output(const void* data, int32_t nbytes, void* user_data) {
+  return 0;
+}
+
+static void* new_packed(int delta) {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  void* packed;
+
+  sparams.compressor = BLOSC_LZ4;
+  if (delta) {
+    sparams.filters[0] = BLOSC_DELTA;
+    sparams.filters[1] = BLOSC_SHUFFLE;
+  }
+  schunk = blosc2_new_schunk(&sparams);
+  if (delta) {
+    blosc2_set_delta_ref(schunk, sizeof(int32_t), CHUNKITEMS * sizeof(int32_t),
+                         src);
+  }
+  packed = blosc2_pack_schunk(schunk);
+  blosc2_destroy_schunk(schunk);
+  return packed;
+}
+
+static void* append_chunks(void* packed, int nchunks) {
+  int i;
+
+  for (i = 0; i < nchunks; i++) {
+    packed = blosc2_packed_append_buffer(packed, sizeof(int32_t),
+                                         CHUNKITEMS * sizeof(int32_t),
+                                         src + i * CHUNKITEMS);
+  }
+  return packed;
+}
+
+static char *run_reserve(int delta) {
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context* dctx;
+  memory_input in = {NULL, 0, 0};
+  void *packed, *plain, *chunk;
+  int64_t capacity, cbytes;
+  int i, ngrowths = 0;
+
+  plain = append_chunks(new_packed(delta), NCHUNKS);
+  cbytes = *(int64_t*)((uint8_t*)plain + 32);
+
+  packed = blosc2_packed_reserve(new_packed(delta), 4, 1000);
+  capacity = *(int64_t*)((uint8_t*)packed + 80);
+  mu_assert("ERROR: capacity not set", capacity > 0);
+  mu_assert("ERROR: maxchunks not set", *(int64_t*)((uint8_t*)packed + 88) == 4);
+  for (i = 0; i < NCHUNKS; i++) {
+    packed = blosc2_packed_append_buffer(packed, sizeof(int32_t),
+                                         CHUNKITEMS * sizeof(int32_t),
+                                         src + i * CHUNKITEMS);
+    mu_assert("ERROR: append failed", packed != NULL);
+    if (*(int64_t*)((uint8_t*)packed + 80) != capacity) {
+      capacity = *(int64_t*)((uint8_t*)packed + 80);
+      ngrowths++;
+    }
+  }
+  mu_assert("ERROR: room does not grow geometrically", ngrowths < 20);
+  mu_assert("ERROR: wrong nchunks",
+            *(int64_t*)((uint8_t*)packed + 16) == NCHUNKS);
+  mu_assert("ERROR: cbytes differs from a plain packed super-chunk",
+            *(int64_t*)((uint8_t*)packed + 32) == cbytes);
+  mu_assert("ERROR: capacity too small", capacity > cbytes);
+
+  /* Chunks are the same as in a plain packed super-chunk */
+  for (i = 0; i < NCHUNKS; i += 7) {
+    mu_assert("ERROR: chunk decompression failed",
+              blosc2_packed_decompress_chunk_into(packed, i, dest,
+                                                  CHUNKITEMS * sizeof(int32_t)) ==
+              CHUNKITEMS * sizeof(int32_t));
+    blosc2_packed_decompress_chunk(plain, i, &chunk);
+    mu_assert("ERROR: decompressed data differs",
+              memcmp(dest, chunk, CHUNKITEMS * sizeof(int32_t)) == 0);
+    if (!delta) {
+      mu_assert("ERROR: decompressed data differs from source",
+                memcmp(dest, src + i * CHUNKITEMS,
+                       CHUNKITEMS * sizeof(int32_t)) == 0);
+    }
+    free(chunk);
+  }
+
+  /* The room is skipped by streams */
+  in.data = packed;
+  in.nbytes = capacity;
+  dctx = blosc2_create_dctx(&dparams);
+  mu_assert("ERROR: stream decompression failed",
+            blosc2_decompress_packed_stream(dctx, read_memory, &in,
+                                            discard_output, NULL) ==
+            NITEMS * sizeof(int32_t));
+  blosc2_free_ctx(dctx);
+
+  /* Reserving room that is there already does nothing */
+  mu_assert("ERROR: reserve moved the buffer",
+            blosc2_packed_reserve(packed, 1, 10) == packed);
+
+  /* Releasing the room gives a plain packed super-chunk */
+  packed = blosc2_packed_shrink(packed);
+  mu_assert("ERROR: capacity not cleared",
+            *(int64_t*)((uint8_t*)packed + 80) == 0);
+  mu_assert("ERROR: shrunk super-chunk differs",
+            memcmp(packed, plain, (size_t)cbytes) == 0);
+  mu_assert("ERROR: shrinking twice moved the buffer",
+            blosc2_packed_shrink(packed) == packed);
+
+  free(packed);
+  free(plain);
+  return 0;
+}
+
+static char *test_reserve() {
+  return run_reserve(0);
+}
+
+static char *test_reserve_delta() {
+  return run_reserve(1);
+}
+
+static char *test_reserve_after() {
+  /* Room can be reserved for packed super-chunks with chunks already */
+  void *packed, *plain;
+  blosc2_sheader* schunk;
+  int64_t cbytes;
+  int i;
+
+  plain = append_chunks(new_packed(0), NCHUNKS);
+  cbytes = *(int64_t*)((uint8_t*)plain + 32);
+  packed = append_chunks(new_packed(0), NCHUNKS / 2);
+  packed = blosc2_packed_reserve(packed, NCHUNKS / 2, cbytes);
+  for (i = NCHUNKS / 2; i < NCHUNKS; i++) {
+    packed = blosc2_packed_append_buffer(packed, sizeof(int32_t),
+                                         CHUNKITEMS * sizeof(int32_t),
+                                         src + i * CHUNKITEMS);
+  }
+  mu_assert("ERROR: room reserved was not enough",
+            *(int64_t*)((uint8_t*)packed + 88) == NCHUNKS);
+
+  /* Unpacking does not need the room to be released */
+  schunk = blosc2_unpack_schunk(packed);
+  for (i = 0; i < NCHUNKS; i++) {
+    mu_assert("ERROR: unpacked chunk decompression failed",
+              blosc2_decompress_chunk(schunk, i, dest,
+                                      CHUNKITEMS * sizeof(int32_t)) ==
+              CHUNKITEMS * sizeof(int32_t));
+    mu_assert("ERROR: unpacked data differs",
+              memcmp(dest, src + i * CHUNKITEMS,
+                     CHUNKITEMS * sizeof(int32_t)) == 0);
+  }
+  blosc2_destroy_schunk(schunk);
+
+  packed = blosc2_packed_shrink(packed);
+  mu_assert("ERROR: shrunk super-chunk differs",
+            memcmp(packed, plain, (size_t)cbytes) == 0);
+  free(packed);
+  free(plain);
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_reserve);
+  mu_run_test(test_reserve_delta);
+  mu_run_test(test_reserve_after);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int result;
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, CHUNKITEMS * sizeof(int32_t));
+  blosc_test_fill_sequence(src, NITEMS);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_destroy();
+
+  return result;
+}
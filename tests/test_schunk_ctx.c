@@ -0,0 +1,261 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for super-chunks with contexts of their own.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <pthread.h>
+#include "test_common.h"
+#include "../blosc/blosc-private.h"
+
+int tests_run = 0;
+
+#define CHUNKITEMS (50 * 1000)
+#define NCHUNKS 100
+#define NSCHUNKS 4
+
+/* The settings of each super-chunk */
+typedef struct {
+  uint8_t compressor;
+  int delta;
+  int nthreads;
+  size_t typesize;
+} schunk_job;
+
+schunk_job jobs[NSCHUNKS] = {
+  {BLOSC_LZ4, 0, 4, sizeof(int32_t)},
+  {BLOSC_BLOSCLZ, 1, 2, sizeof(int32_t)},
+  {BLOSC_ZSTD, 0, 1, sizeof(int64_t)},
+  {BLOSC_LZ4HC, 1, 3, 1},
+};
+
+
+/* The contents of chunk `nchunk` */
+static void fill_chunk(int32_t* chunk, int nchunk, int seed) {
+  int i;
+
+  for (i = 0; i < CHUNKITEMS; i++) {
+    chunk[i] = (nchunk + seed) * CHUNKITEMS + i % (100 + seed);
+  }
+}
+
+/* Fill a super-chunk and read it back */
+static void* run_schunk(void* arg) {
+  schunk_job* job = (schunk_job*)arg;
+  int seed = (int)(job - jobs);
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  int32_t *chunk, *expected;
+  char* error = NULL;
+  int i;
+
+  chunk = malloc(CHUNKITEMS * sizeof(int32_t));
+  expected = malloc(CHUNKITEMS * sizeof(int32_t));
+  sparams.compressor = job->compressor;
+  sparams.nthreads = (uint8_t)job->nthreads;
+  if (job->delta) {
+    sparams.filters[0] = BLOSC_DELTA;
+    sparams.filters[1] = BLOSC_SHUFFLE;
+  }
+  schunk = blosc2_new_schunk(&sparams);
+  for (i = 0; i < NCHUNKS; i++) {
+    fill_chunk(chunk, i, seed);
+    if ((int)blosc2_append_buffer(schunk, job->typesize,
+                                  CHUNKITEMS * sizeof(int32_t), chunk) != i + 1) {
+      error = "ERROR: append failed";
+      goto out;
+    }
+  }
+  for (i = NCHUNKS - 1; i >= 0; i--) {
+    if (blosc2_decompress_chunk(schunk, i, chunk, CHUNKITEMS * sizeof(int32_t)) !=
+        CHUNKITEMS * sizeof(int32_t)) {
+      error = "ERROR: chunk decompression failed";
+      goto out;
+    }
+    fill_chunk(expected, i, seed);
+    if (memcmp(chunk, expected, CHUNKITEMS * sizeof(int32_t)) != 0) {
+      error = "ERROR: decompressed data differs";
+      goto out;
+    }
+  }
+
+  out:
+  blosc2_destroy_schunk(schunk);
+  free(chunk);
+  free(expected);
+  return error;
+}
+
+static char *test_parallel() {
+  pthread_t threads[NSCHUNKS];
+  void* result;
+  char* error = NULL;
+  int i;
+
+  blosc_set_compressor("blosclz");
+  for (i = 0; i < NSCHUNKS; i++) {
+    pthread_create(&threads[i], NULL, run_schunk, &jobs[i]);
+  }
+  for (i = 0; i < NSCHUNKS; i++) {
+    pthread_join(threads[i], &result);
+    if (result != NULL) {
+      error = (char*)result;
+    }
+  }
+  mu_assert(error, error == NULL);
+  mu_assert("ERROR: the global compressor changed",
+            strcmp(blosc_get_compressor(), "blosclz") == 0);
+  return 0;
+}
+
+static char *test_codec() {
+  /* The chunks use the codec of the super-chunk, not the global one */
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  int32_t* chunk;
+
+  chunk = malloc(CHUNKITEMS * sizeof(int32_t));
+  fill_chunk(chunk, 0, 0);
+  blosc_set_compressor("blosclz");
+  sparams.compressor = BLOSC_LZ4;
+  sparams.nthreads = 2;
+  schunk = blosc2_new_schunk(&sparams);
+  blosc2_append_buffer(schunk, sizeof(int32_t), CHUNKITEMS * sizeof(int32_t),
+                       chunk);
+  mu_assert("ERROR: the chunk does not use the codec of the super-chunk",
+            strcmp(blosc_cbuffer_complib(schunk->data[0]), "LZ4") == 0);
+  mu_assert("ERROR: the global compressor changed",
+            strcmp(blosc_get_compressor(), "blosclz") == 0);
+  blosc2_destroy_schunk(schunk);
+  free(chunk);
+  return 0;
+}
+
+static char *test_blocksize() {
+  /* The blocksize of a chunk does not stick for the next ones */
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  int32_t* chunk;
+  int i;
+
+  chunk = malloc(CHUNKITEMS * sizeof(int32_t));
+  for (i = 0; i < CHUNKITEMS; i++) {
+    chunk[i] = i;
+  }
+  sparams.compressor = BLOSC_LZ4;
+  schunk = blosc2_new_schunk(&sparams);
+  blosc2_append_buffer(schunk, sizeof(int32_t), sizeof(int32_t), chunk);
+  blosc2_append_buffer(schunk, sizeof(int32_t), 20000 * sizeof(int32_t), chunk);
+  mu_assert("ERROR: the blocksize of the first chunk was reused",
+            *(int32_t*)(schunk->data[1] + 8) > 1000);
+  mu_assert("ERROR: the second chunk does not compress well",
+            *(int32_t*)(schunk->data[1] + 12) < 1000);
+  blosc2_destroy_schunk(schunk);
+  free(chunk);
+  return 0;
+}
+
+static char *test_global_nthreads() {
+  /* Super-chunks use the global number of threads by default, and they
+     keep it when it changes */
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  int32_t *chunk, *expected;
+
+  chunk = malloc(CHUNKITEMS * sizeof(int32_t));
+  expected = malloc(CHUNKITEMS * sizeof(int32_t));
+  fill_chunk(expected, 0, 0);
+  blosc_set_nthreads(4);
+  schunk = blosc2_new_schunk(&sparams);
+  blosc_set_nthreads(1);
+  blosc2_append_buffer(schunk, sizeof(int32_t), CHUNKITEMS * sizeof(int32_t),
+                       expected);
+  mu_assert("ERROR: chunk decompression failed",
+            blosc2_decompress_chunk(schunk, 0, chunk,
+                                    CHUNKITEMS * sizeof(int32_t)) ==
+            CHUNKITEMS * sizeof(int32_t));
+  mu_assert("ERROR: decompressed data differs",
+            memcmp(chunk, expected, CHUNKITEMS * sizeof(int32_t)) == 0);
+  blosc2_destroy_schunk(schunk);
+  free(chunk);
+  free(expected);
+  return 0;
+}
+
+
+static char *test_shared_pools() {
+  /* Super-chunks with the same number of threads share a pool, which is
+     started by the first (de-)compression */
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader* schunks[NSCHUNKS * 25];
+  int32_t* chunk;
+  int32_t npools = blosc_get_nshared_pools();
+  int i;
+
+  chunk = malloc(CHUNKITEMS * sizeof(int32_t));
+  fill_chunk(chunk, 0, 0);
+  sparams.compressor = BLOSC_LZ4;
+  sparams.nthreads = 4;
+  for (i = 0; i < NSCHUNKS * 25; i++) {
+    schunks[i] = blosc2_new_schunk(&sparams);
+  }
+  mu_assert("ERROR: the pool is started before compressing",
+            blosc_get_nshared_pools() == npools);
+  for (i = 0; i < NSCHUNKS * 25; i++) {
+    blosc2_append_buffer(schunks[i], sizeof(int32_t),
+                         CHUNKITEMS * sizeof(int32_t), chunk);
+  }
+  mu_assert("ERROR: the super-chunks do not share a pool",
+            blosc_get_nshared_pools() == npools + 1);
+
+  mu_assert("ERROR: chunk decompression failed",
+            blosc2_decompress_chunk(schunks[1], 0, chunk,
+                                    CHUNKITEMS * sizeof(int32_t)) ==
+            CHUNKITEMS * sizeof(int32_t));
+
+  /* Other numbers of threads get a pool of their own */
+  blosc2_destroy_schunk(schunks[0]);
+  sparams.nthreads = 2;
+  schunks[0] = blosc2_new_schunk(&sparams);
+  blosc2_append_buffer(schunks[0], sizeof(int32_t),
+                       CHUNKITEMS * sizeof(int32_t), chunk);
+  mu_assert("ERROR: the pool for 2 threads has not been started",
+            blosc_get_nshared_pools() == npools + 2);
+
+  for (i = 0; i < NSCHUNKS * 25; i++) {
+    blosc2_destroy_schunk(schunks[i]);
+  }
+  mu_assert("ERROR: the pools are not stopped with their super-chunks",
+            blosc_get_nshared_pools() == npools);
+  free(chunk);
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_parallel);
+  mu_run_test(test_codec);
+  mu_run_test(test_blocksize);
+  mu_run_test(test_global_nthreads);
+  mu_run_test(test_shared_pools);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int result;
+
+  blosc_init();
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_destroy();
+
+  return result;
+}
@@ -0,0 +1,253 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for super-chunks backed by files.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <stdio.h>
+#include "test_common.h"
+#if !defined(_WIN32)
+  #include <signal.h>
+  #include <sys/resource.h>
+#endif
+
+int tests_run = 0;
+
+#define CHUNKITEMS (200 * 1000)
+#define NCHUNKS 10
+#define NITEMS (CHUNKITEMS * NCHUNKS)
+#define FILENAME "test_schunk_file.b2frame"
+
+/* Global vars */
+int32_t *src, *dest;
+
+
+/* Decompress the chunks of `schunk` and compare them with `src` */
+static int check_chunks(blosc2_sheader* schunk, int nchunks) {
+  int i, nbytes;
+
+  for (i = 0; i < nchunks; i++) {
+    memset(dest, 0, CHUNKITEMS * sizeof(int32_t));
+    nbytes = blosc2_decompress_chunk(schunk, i, dest,
+                                     CHUNKITEMS * sizeof(int32_t));
+    if (nbytes != CHUNKITEMS * sizeof(int32_t) ||
+        memcmp(dest, src + i * CHUNKITEMS, (size_t)nbytes) != 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/* Read the whole file in memory */
+static void* read_file(int64_t* nbytes) {
+  FILE* f = fopen(FILENAME, "rb");
+  void* data;
+
+  fseek(f, 0, SEEK_END);
+  *nbytes = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  data = malloc((size_t)*nbytes);
+  fread(data, 1, (size_t)*nbytes, f);
+  fclose(f);
+  return data;
+}
+
+static char *run_file(int delta) {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_sheader *schunk, *unpacked;
+  void* packed;
+  int64_t packed_len, nbytes, cbytes;
+  int i;
+
+  sparams.compressor = BLOSC_LZ4;
+  if (delta) {
+    sparams.filters[0] = BLOSC_DELTA;
+    sparams.filters[1] = BLOSC_SHUFFLE;
+  }
+  schunk = blosc2_new_schunk_file(&sparams, FILENAME);
+  mu_assert("ERROR: file super-chunk not created", schunk != NULL);
+  if (delta) {
+    blosc2_set_delta_ref(schunk, sizeof(int32_t), CHUNKITEMS * sizeof(int32_t),
+                         src);
+  }
+  for (i = 0; i < NCHUNKS / 2; i++) {
+    mu_assert("ERROR: append failed",
+              blosc2_append_buffer(schunk, sizeof(int32_t),
+                                   CHUNKITEMS * sizeof(int32_t),
+                                   src + i * CHUNKITEMS) == i + 1);
+  }
+  if (delta) {
+    mu_assert("ERROR: late delta reference not detected",
+              blosc2_set_delta_ref(schunk, sizeof(int32_t),
+                                   CHUNKITEMS * sizeof(int32_t), src) < 0);
+  }
+  mu_assert("ERROR: chunks differ", check_chunks(schunk, NCHUNKS / 2));
+  nbytes = schunk->nbytes;
+  cbytes = schunk->cbytes;
+  blosc2_destroy_schunk(schunk);
+
+  /* Reopen and append the rest */
+  schunk = blosc2_open_schunk_file(FILENAME);
+  mu_assert("ERROR: file super-chunk not opened", schunk != NULL);
+  mu_assert("ERROR: wrong nchunks after reopening",
+            schunk->nchunks == NCHUNKS / 2);
+  mu_assert("ERROR: wrong nbytes after reopening", schunk->nbytes == nbytes);
+  mu_assert("ERROR: wrong cbytes after reopening", schunk->cbytes == cbytes);
+  mu_assert("ERROR: chunks differ after reopening",
+            check_chunks(schunk, NCHUNKS / 2));
+  for (i = NCHUNKS / 2; i < NCHUNKS; i++) {
+    mu_assert("ERROR: append failed",
+              blosc2_append_buffer(schunk, sizeof(int32_t),
+                                   CHUNKITEMS * sizeof(int32_t),
+                                   src + i * CHUNKITEMS) == i + 1);
+  }
+  mu_assert("ERROR: wrong nbytes",
+            schunk->nbytes == NITEMS * sizeof(int32_t));
+  mu_assert("ERROR: chunks differ", check_chunks(schunk, NCHUNKS));
+
+  /* The file is a packed super-chunk once synced */
+  mu_assert("ERROR: sync failed", blosc2_sync_schunk_file(schunk) == 0);
+  packed = read_file(&packed_len);
+  mu_assert("ERROR: packed length differs",
+            *(int64_t*)((uint8_t*)packed + 32) == packed_len);
+  for (i = 0; i < NCHUNKS; i++) {
+    void* chunk;
+    mu_assert("ERROR: packed chunk decompression failed",
+              blosc2_packed_decompress_chunk(packed, i, &chunk) ==
+              CHUNKITEMS * sizeof(int32_t));
+    /* The packed functions apply the delta filter on their own */
+    mu_assert("ERROR: packed chunk differs",
+              delta || memcmp(chunk, src + i * CHUNKITEMS,
+                              CHUNKITEMS * sizeof(int32_t)) == 0);
+    free(chunk);
+  }
+  unpacked = blosc2_unpack_schunk(packed);
+  mu_assert("ERROR: unpacked chunks differ", check_chunks(unpacked, NCHUNKS));
+  blosc2_destroy_schunk(unpacked);
+  free(packed);
+
+  packed = blosc2_pack_schunk(schunk);
+  mu_assert("ERROR: packing failed", packed != NULL);
+  unpacked = blosc2_unpack_schunk(packed);
+  mu_assert("ERROR: unpacked chunks differ", check_chunks(unpacked, NCHUNKS));
+  blosc2_destroy_schunk(unpacked);
+  free(packed);
+
+  blosc2_destroy_schunk(schunk);
+  remove(FILENAME);
+  return 0;
+}
+
+static char *test_file() {
+  return run_file(0);
+}
+
+static char *test_file_delta() {
+  return run_file(1);
+}
+
+static char *test_cstream() {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  blosc_context* cctx;
+  blosc2_cstream* stream;
+
+  schunk = blosc2_new_schunk_file(&sparams, FILENAME);
+  cparams.typesize = sizeof(int32_t);
+  cparams.schunk = schunk;
+  cctx = blosc2_create_cctx(&cparams);
+  stream = blosc2_create_cstream(cctx, CHUNKITEMS * sizeof(int32_t), NULL, NULL);
+  mu_assert("ERROR: stream not created", stream != NULL);
+  mu_assert("ERROR: stream write failed",
+            blosc2_cstream_write(stream, src, NITEMS * sizeof(int32_t)) ==
+            NCHUNKS);
+  blosc2_cstream_end(stream);
+  blosc2_free_ctx(cctx);
+  blosc2_destroy_schunk(schunk);
+
+  schunk = blosc2_open_schunk_file(FILENAME);
+  mu_assert("ERROR: wrong nchunks after reopening",
+            schunk->nchunks == NCHUNKS);
+  mu_assert("ERROR: chunks differ", check_chunks(schunk, NCHUNKS));
+  blosc2_destroy_schunk(schunk);
+  remove(FILENAME);
+  return 0;
+}
+
+static char *test_cstream_error() {
+#if !defined(_WIN32)
+  /* Chunks that cannot be written make the stream fail */
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_sheader* schunk;
+  blosc_context* cctx;
+  blosc2_cstream* stream;
+  struct rlimit limit, small_limit;
+  int rc;
+
+  schunk = blosc2_new_schunk_file(&sparams, FILENAME);
+  cparams.typesize = sizeof(int32_t);
+  cparams.schunk = schunk;
+  cctx = blosc2_create_cctx(&cparams);
+  stream = blosc2_create_cstream(cctx, CHUNKITEMS * sizeof(int32_t), NULL, NULL);
+  getrlimit(RLIMIT_FSIZE, &limit);
+  small_limit = limit;
+  small_limit.rlim_cur = 1024;
+  signal(SIGXFSZ, SIG_IGN);
+  setrlimit(RLIMIT_FSIZE, &small_limit);
+  rc = blosc2_cstream_write(stream, src, NITEMS * sizeof(int32_t));
+  setrlimit(RLIMIT_FSIZE, &limit);
+  signal(SIGXFSZ, SIG_DFL);
+  mu_assert("ERROR: failed write not detected", rc < 0);
+  blosc2_cstream_end(stream);
+  blosc2_free_ctx(cctx);
+  blosc2_destroy_schunk(schunk);
+  remove(FILENAME);
+#endif
+  return 0;
+}
+
+static char *test_missing() {
+  mu_assert("ERROR: missing file not detected",
+            blosc2_open_schunk_file("missing/" FILENAME) == NULL);
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_file);
+  mu_run_test(test_file_delta);
+  mu_run_test(test_cstream);
+  mu_run_test(test_cstream_error);
+  mu_run_test(test_missing);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int result;
+
+  blosc_init();
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, NITEMS * sizeof(int32_t));
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, CHUNKITEMS * sizeof(int32_t));
+  blosc_test_fill_sequence(src, NITEMS);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_destroy();
+
+  return result;
+}
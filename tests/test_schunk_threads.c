@@ -0,0 +1,175 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for reading super-chunks while another thread appends.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include <pthread.h>
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define CHUNKITEMS 1000
+#define NCHUNKS 3000
+#define NREADERS 3
+
+/* Global vars */
+blosc2_sheader* schunk;
+volatile int appending;
+
+
+/* The contents of chunk `nchunk` */
+static void fill_chunk(int32_t* chunk, int nchunk) {
+  int i;
+
+  for (i = 0; i < CHUNKITEMS; i++) {
+    chunk[i] = nchunk * CHUNKITEMS + i;
+  }
+}
+
+static void* append_chunks(void* arg) {
+  int32_t chunk[CHUNKITEMS];
+  int i;
+
+  for (i = 0; i < NCHUNKS; i++) {
+    fill_chunk(chunk, i);
+    blosc2_append_buffer(schunk, sizeof(int32_t), sizeof(chunk), chunk);
+  }
+  appending = 0;
+  return NULL;
+}
+
+/* Decompress random chunks among the ones appended so far */
+static void* read_chunks(void* arg) {
+  int32_t chunk[CHUNKITEMS], expected[CHUNKITEMS];
+  int64_t nchunks;
+  int nchunk, nreads = 0;
+  unsigned seed = (unsigned)(size_t)arg;
+
+  while (appending || nreads < 100) {
+    nchunks = *(volatile int64_t*)&schunk->nchunks;
+    if (nchunks == 0) {
+      continue;
+    }
+    /* Mostly the latest chunks, which are the ones being published */
+    seed = seed * 1103515245 + 12345;
+    if (seed & 1) {
+      nchunk = (int)(nchunks - 1 - (seed >> 8) % (nchunks < 4 ? nchunks : 4));
+    }
+    else {
+      nchunk = (int)((seed >> 8) % nchunks);
+    }
+    if (blosc2_decompress_chunk(schunk, nchunk, chunk, sizeof(chunk)) !=
+        sizeof(chunk)) {
+      return (void*)"ERROR: chunk decompression failed";
+    }
+    fill_chunk(expected, nchunk);
+    if (memcmp(chunk, expected, sizeof(chunk)) != 0) {
+      return (void*)"ERROR: decompressed data differs";
+    }
+    nreads++;
+  }
+  return NULL;
+}
+
+static char *run_readers(int delta) {
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  pthread_t writer, readers[NREADERS];
+  void* result;
+  char* error = NULL;
+  int i;
+
+  sparams.compressor = BLOSC_LZ4;
+  if (delta) {
+    sparams.filters[0] = BLOSC_DELTA;
+    sparams.filters[1] = BLOSC_SHUFFLE;
+  }
+  schunk = blosc2_new_schunk(&sparams);
+  appending = 1;
+  pthread_create(&writer, NULL, append_chunks, NULL);
+  for (i = 0; i < NREADERS; i++) {
+    pthread_create(&readers[i], NULL, read_chunks, (void*)(size_t)(i + 1));
+  }
+  pthread_join(writer, NULL);
+  for (i = 0; i < NREADERS; i++) {
+    pthread_join(readers[i], &result);
+    if (result != NULL) {
+      error = (char*)result;
+    }
+  }
+  mu_assert(error, error == NULL);
+  mu_assert("ERROR: wrong number of chunks", schunk->nchunks == NCHUNKS);
+  mu_assert("ERROR: wrong nbytes",
+            schunk->nbytes == (int64_t)NCHUNKS * CHUNKITEMS * sizeof(int32_t));
+
+  blosc2_destroy_schunk(schunk);
+  return 0;
+}
+
+static char *test_readers() {
+  return run_readers(0);
+}
+
+static char *test_readers_delta() {
+  return run_readers(1);
+}
+
+static char *test_unpacked() {
+  /* Appending to unpacked super-chunks (which have no room for chunk
+     pointers) works as well */
+  blosc2_sparams sparams = BLOSC_SPARAMS_DEFAULTS;
+  int32_t chunk[CHUNKITEMS], expected[CHUNKITEMS];
+  void* packed;
+  int i;
+
+  schunk = blosc2_new_schunk(&sparams);
+  for (i = 0; i < 5; i++) {
+    fill_chunk(chunk, i);
+    blosc2_append_buffer(schunk, sizeof(int32_t), sizeof(chunk), chunk);
+  }
+  packed = blosc2_pack_schunk(schunk);
+  blosc2_destroy_schunk(schunk);
+  schunk = blosc2_unpack_schunk(packed);
+  free(packed);
+  for (i = 5; i < 100; i++) {
+    fill_chunk(chunk, i);
+    mu_assert("ERROR: append failed",
+              (int)blosc2_append_buffer(schunk, sizeof(int32_t), sizeof(chunk),
+                                        chunk) == i + 1);
+  }
+  for (i = 0; i < 100; i++) {
+    blosc2_decompress_chunk(schunk, i, chunk, sizeof(chunk));
+    fill_chunk(expected, i);
+    mu_assert("ERROR: decompressed data differs",
+              memcmp(chunk, expected, sizeof(chunk)) == 0);
+  }
+  blosc2_destroy_schunk(schunk);
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_readers);
+  mu_run_test(test_readers_delta);
+  mu_run_test(test_unpacked);
+
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  int result;
+
+  blosc_init();
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc_destroy();
+
+  return result;
+}
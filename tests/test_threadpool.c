@@ -0,0 +1,179 @@
+/*********************************************************************
+  Blosc - Blocked Shuffling and Compression Library
+
+  Unit tests for pools of threads shared among contexts.
+
+  Creation date: 2026-10-16
+  Author: The Blosc Development Team <blosc@blosc.org>
+
+  See LICENSES/BLOSC.txt for details about copyright and rights to use.
+**********************************************************************/
+
+#include "test_common.h"
+
+int tests_run = 0;
+
+#define NCONTEXTS 8
+#define POOL_NTHREADS 3
+
+/* Global vars */
+void *src, *dest, *dest2;
+size_t size = 4 * 1000 * 1000;             /* must be divisible by 4 */
+blosc2_threadpool* pool;
+
+
+/* Check many contexts compressing through the same pool */
+static char *test_many_contexts() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx[NCONTEXTS], *dctx[NCONTEXTS];
+  int i, cbytes, nbytes;
+
+  for (i = 0; i < NCONTEXTS; i++) {
+    /* Use different typesizes so that worker temporaries get resized */
+    cparams.typesize = (uint8_t)(2 << (i % 3));
+    cparams.clevel = 5;
+    cparams.nthreads = (uint8_t)(1 + i % (POOL_NTHREADS + 2));
+    cparams.threadpool = pool;
+    cctx[i] = blosc2_create_cctx(&cparams);
+    dparams.nthreads = (uint8_t)(1 + i % (POOL_NTHREADS + 2));
+    dparams.threadpool = pool;
+    dctx[i] = blosc2_create_dctx(&dparams);
+  }
+
+  for (i = 0; i < NCONTEXTS; i++) {
+    cbytes = blosc2_compress_ctx(cctx[i], size, src, dest, size + 16);
+    mu_assert("ERROR: cbytes is not correct", cbytes > 0 && cbytes < (int)size);
+    memset(dest2, 0, size);
+    nbytes = blosc2_decompress_ctx(dctx[i], dest, dest2, size);
+    mu_assert("ERROR: nbytes incorrect", nbytes == (int)size);
+    mu_assert("ERROR: roundtrip failed", memcmp(src, dest2, size) == 0);
+  }
+
+  for (i = 0; i < NCONTEXTS; i++) {
+    blosc2_free_ctx(cctx[i]);
+    blosc2_free_ctx(dctx[i]);
+  }
+
+  return 0;
+}
+
+
+/* Check that uncompressible buffers are detected through the pool */
+static char *test_uncompressible() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc_context *cctx, *dctx;
+  void* random_src = blosc_test_malloc(32, size);
+  int cbytes, nbytes;
+
+  blosc_test_fill_random(random_src, size);
+  cparams.typesize = 4;
+  cparams.nthreads = POOL_NTHREADS + 1;
+  cparams.threadpool = pool;
+  cctx = blosc2_create_cctx(&cparams);
+  dparams.nthreads = POOL_NTHREADS + 1;
+  dparams.threadpool = pool;
+  dctx = blosc2_create_dctx(&dparams);
+
+  /* Does not fit in a buffer with no room for the overhead */
+  cbytes = blosc2_compress_ctx(cctx, size, random_src, dest, size);
+  mu_assert("ERROR: uncompressible data should return 0", cbytes == 0);
+
+  cbytes = blosc2_compress_ctx(cctx, size, random_src, dest, size + 16);
+  mu_assert("ERROR: cbytes is not correct", cbytes == (int)size + 16);
+  nbytes = blosc2_decompress_ctx(dctx, dest, dest2, size);
+  mu_assert("ERROR: nbytes incorrect", nbytes == (int)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(random_src, dest2, size) == 0);
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  blosc_test_free(random_src);
+
+  return 0;
+}
+
+
+/* Check a pool with the workers pinned to CPUs */
+static char *test_pinned() {
+  blosc2_context_cparams cparams = BLOSC_CPARAMS_DEFAULTS;
+  blosc2_context_dparams dparams = BLOSC_DPARAMS_DEFAULTS;
+  blosc2_threadpool* pinned;
+  blosc_context *cctx, *dctx;
+  int cpus[] = {0};
+  int bad_cpus[] = {0, -1};
+  int cbytes, nbytes;
+
+  mu_assert("ERROR: a pool without CPUs cannot be pinned",
+            blosc2_create_threadpool_pinned(POOL_NTHREADS, NULL, 0) == NULL);
+  mu_assert("ERROR: a pool cannot be pinned to a negative CPU",
+            blosc2_create_threadpool_pinned(POOL_NTHREADS, bad_cpus, 2) == NULL);
+#if defined(__linux__)
+  /* Beyond CPU_SETSIZE */
+  bad_cpus[1] = 1 << 20;
+  mu_assert("ERROR: a pool cannot be pinned to a CPU out of range",
+            blosc2_create_threadpool_pinned(POOL_NTHREADS, bad_cpus, 2) == NULL);
+#endif
+  pinned = blosc2_create_threadpool_pinned(POOL_NTHREADS, cpus, 1);
+  mu_assert("ERROR: cannot create a pinned pool", pinned != NULL);
+
+  cparams.typesize = 4;
+  cparams.nthreads = POOL_NTHREADS + 1;
+  cparams.threadpool = pinned;
+  cctx = blosc2_create_cctx(&cparams);
+  dparams.nthreads = POOL_NTHREADS + 1;
+  dparams.threadpool = pinned;
+  dctx = blosc2_create_dctx(&dparams);
+
+  cbytes = blosc2_compress_ctx(cctx, size, src, dest, size + 16);
+  mu_assert("ERROR: cbytes is not correct", cbytes > 0 && cbytes < (int)size);
+  memset(dest2, 0, size);
+  nbytes = blosc2_decompress_ctx(dctx, dest, dest2, size);
+  mu_assert("ERROR: nbytes incorrect", nbytes == (int)size);
+  mu_assert("ERROR: roundtrip failed", memcmp(src, dest2, size) == 0);
+
+  blosc2_free_ctx(cctx);
+  blosc2_free_ctx(dctx);
+  blosc2_free_threadpool(pinned);
+
+  return 0;
+}
+
+
+static char *all_tests() {
+  mu_run_test(test_many_contexts);
+  mu_run_test(test_uncompressible);
+  mu_run_test(test_pinned);
+
+  return 0;
+}
+
+#define BUFFER_ALIGN_SIZE   32
+
+int main(int argc, char **argv) {
+  int32_t *_src;
+  int result;
+  size_t i;
+
+  /* Initialize buffers */
+  src = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  dest = blosc_test_malloc(BUFFER_ALIGN_SIZE, size + 16);
+  dest2 = blosc_test_malloc(BUFFER_ALIGN_SIZE, size);
+  _src = (int32_t *)src;
+  for (i=0; i < (size/4); i++) {
+    _src[i] = (int32_t)i;
+  }
+
+  pool = blosc2_create_threadpool(POOL_NTHREADS);
+
+  /* Run all the suite */
+  result = blosc_test_run_suite(argv[0], all_tests);
+
+  blosc2_free_threadpool(pool);
+
+  blosc_test_free(src);
+  blosc_test_free(dest);
+  blosc_test_free(dest2);
+
+  return result;
+}